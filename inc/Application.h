@@ -7,7 +7,8 @@ class Application
 {
 public:
 
-	Application() : m_running(false) {}
+	Application() : m_window(nullptr), m_running(false), m_fixedTimeStep(0), m_maxUpdateSteps(5), m_frameTime(0),
+		m_headless(false), m_headlessFrames(1000), m_headlessDeltaTime(1 / 60.0f) {}
 	virtual ~Application() {}
 
 	bool	create(const char* a_name, int a_width, int a_height, int a_argc, char* a_argv[]);
@@ -16,13 +17,45 @@ public:
 
 	void	quit()	{ m_running = false; }
 
+	// updates at a fixed rate (in steps per second) rather than once per frame,
+	// running at most a_maxSteps updates per frame to catch up after a slow frame
+	// a rate of 0 restores the default variable-step loop
+	void	setFixedUpdateRate(float a_stepsPerSecond, unsigned int a_maxSteps = 5);
+
+	// limits the frame rate by sleeping away the remainder of each frame, 0 to disable
+	void	setFrameRateCap(float a_framesPerSecond);
+
+	// runs without a window or GL context, updating a_frameCount times with a fixed
+	// a_deltaTime then printing frame timing statistics; must be set before create()
+	// can also be enabled with the command-line arguments --headless [--frames=N] [--delta=S]
+	void	setHeadless(unsigned int a_frameCount = 1000, float a_deltaTime = 1 / 60.0f);
+	bool	isHeadless() const	{ return m_headless; }
+
 protected:
 
 	virtual bool	onCreate(int a_argc, char* a_argv[]) = 0;
 	virtual void	onUpdate(float a_deltaTime) = 0;
-	virtual void	onDraw() = 0;
+	virtual void	onDraw() {}
 	virtual void	onDestroy() = 0;
+
+	// override instead of onDraw() to receive how far (0 to 1) the frame is between the previous
+	// and the next fixed update, for interpolating state; always 1 for variable-step updates
+	virtual void	onDrawInterpolated(float a_alpha)	{ onDraw(); }
 	
 	GLFWwindow*		m_window;
 	bool			m_running;
+
+	// fixed-step loop settings
+	float			m_fixedTimeStep;
+	unsigned int	m_maxUpdateSteps;
+	float			m_frameTime;
+
+	// headless benchmark settings
+	bool			m_headless;
+	unsigned int	m_headlessFrames;
+	float			m_headlessDeltaTime;
+
+private:
+
+	void	runHeadless();
 };
\ No newline at end of file
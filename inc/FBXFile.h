@@ -8,6 +8,9 @@
 #include <string>
 #include <thread>
 #include <mutex>
+#include <atomic>
+#include <functional>
+#include <deque>
 
 struct ImportAssistor;
 
@@ -62,11 +65,23 @@ public:
 	unsigned int	index[4];
 };
 
+// Textures are decoded and given their mip chain on the loading threads; the chain is kept in
+// mipData, with data left null and format holding the GL format the levels are stored in.
+// Both are freed once the texture is uploaded.
 struct FBXTexture
 {
 	FBXTexture();
 	~FBXTexture();
 
+	// a level of the mip chain, offset and size are in bytes into mipData
+	struct Mip
+	{
+		int				width;
+		int				height;
+		unsigned int	offset;
+		unsigned int	size;
+	};
+
 	std::string		name;
 	std::string		path;
 	unsigned int	handle;
@@ -74,6 +89,13 @@ struct FBXTexture
 	int				width;
 	int				height;
 	int				format;
+
+	std::vector<Mip>			mips;
+	std::vector<unsigned char>	mipData;
+
+	// set when a material uses the texture as a normal map, which is compressed to two channels
+	// (shaders rebuild z from x and y) and has its mips renormalised
+	bool			normalMap;
 };
 
 // A simple FBX material that supports 8 texture channels
@@ -158,6 +180,51 @@ public:
 	std::vector<unsigned int>	m_indices;
 };
 
+// One attribute of a packed vertex stream, as passed to glVertexAttribPointer
+struct FBXVertexAttribute
+{
+	unsigned int	attribute;	// the FBXVertex::VertexAttributeFlags bit it holds
+	unsigned int	location;	// the flag's bit index, i.e. position 0, colour 1, normal 2, texcoord1 7
+	int				size;		// number of components
+	unsigned int	type;		// GL component type
+	bool			normalised;
+	bool			integer;	// read as integers (ivec/uvec) with glVertexAttribIPointer
+	unsigned int	offset;
+};
+
+// A tightly packed, interleaved copy of a mesh's vertices that holds only the attributes set in
+// its m_vertexAttributes, compressed as follows:
+//	position	3 floats
+//	colour		4 unorm8
+//	normal		2 snorm16, octahedral encoded
+//	tangent		4 snorm16, the octahedral tangent in xy and the bitangent sign in w
+//				the binormal isn't stored, rebuild it in the shader as cross(normal, tangent.xyz) * w
+//	indices		4 uint8, or 4 uint16 if the mesh uses bones past 255
+//	weights		4 unorm8, rounded so that they still sum to 1
+//	texcoords	2 unorm16 if every coordinate lies within [0,1], else 2 half floats
+// A skinned, normal mapped vertex shrinks from 136 bytes to 36. Octahedral vectors decode with:
+//	vec3 n = vec3(e.xy, 1 - abs(e.x) - abs(e.y));
+//	if (n.z < 0) n.xy = (1 - abs(n.yx)) * vec2(n.x >= 0 ? 1 : -1, n.y >= 0 ? 1 : -1);
+//	n = normalize(n);
+class FBXVertexStream
+{
+public:
+
+	FBXVertexStream() : m_stride(0), m_vertexCount(0) {}
+
+	// packs a mesh's vertices, replacing any previous contents
+	void		build(const FBXMeshNode* a_mesh);
+
+	// enables and points the attributes of the bound vertex array at the bound GL_ARRAY_BUFFER,
+	// with m_data uploaded a_bufferOffset bytes into it
+	void		bindAttributes(unsigned int a_bufferOffset = 0) const;
+
+	unsigned int					m_stride;
+	unsigned int					m_vertexCount;
+	std::vector<FBXVertexAttribute>	m_attributes;
+	std::vector<unsigned char>		m_data;
+};
+
 // A light node that can represent a point, directional, or spot light
 class FBXLightNode : public FBXNode
 {
@@ -242,11 +309,126 @@ public:
 	unsigned int	totalFrames() const;
 	float			totalTime(float a_fps = 24.0f) const;
 
+	// copies the tracks' keyframes into a stream per component, which FBXSkeleton::evaluate() reads
+	// the loaders and clone() build them, call it again after changing m_tracks by hand
+	void			buildKeyStreams();
+
+	// a number no animation, compressed or not, has had before, so that poses can tell a different
+	// animation from one freed and reallocated at the same address
+	static unsigned int	newGeneration();
+
 	std::string		m_name;
 	unsigned int	m_startFrame;
 	unsigned int	m_endFrame;
 	unsigned int	m_trackCount;
 	FBXTrack*		m_tracks;
+
+	// renewed whenever the key streams are built
+	unsigned int	m_generation;
+
+	// track i's keys are [m_keyStart[i], m_keyStart[i + 1]) in each stream
+	std::vector<unsigned int>	m_keyStart;
+	std::vector<float>			m_keyFrames;
+	std::vector<glm::quat>		m_keyRotations;
+	std::vector<glm::vec4>		m_keyTranslations;	// padded to four floats so they load straight into SSE registers
+	std::vector<glm::vec4>		m_keyScales;
+};
+
+// An animation compressed for memory, built from an FBXAnimation at import time
+// Each track's rotation, translation and scale are separate channels, and keys that the channel
+// can interpolate to within a tolerance are removed from each. Rotations are stored as their
+// smallest three components in 48 bits, translations and scales as 16 bits per component across
+// the track's range, and scale channels that stay at 1 are dropped.
+class FBXCompressedAnimation
+{
+public:
+
+	FBXCompressedAnimation();
+	~FBXCompressedAnimation();
+
+	// tolerances are the most a removed key may differ from the interpolated value, in radians for
+	// rotations and in scene units for translations; fails if the animation is over 65535 frames long
+	bool			compress(const FBXAnimation* a_animation, float a_rotationTolerance = 0.001f,
+							 float a_translationTolerance = 0.001f, float a_scaleTolerance = 0.001f);
+
+	unsigned int	totalFrames() const;
+	float			totalTime(float a_fps = 24.0f) const;
+
+	// the number of bytes the keys and tracks take up
+	size_t			memoryUsage() const;
+
+	// a run of keys, each a frame and three 16 bit values
+	struct Channel
+	{
+		unsigned int	firstKey;
+		unsigned int	keyCount;	// 0 for a scale that stays at 1
+	};
+
+	struct Track
+	{
+		unsigned int	boneIndex;
+		Channel			rotation;
+		Channel			translation;
+		Channel			scale;
+
+		// the ranges translations and scales are quantised across
+		glm::vec3		translationMin;
+		glm::vec3		translationExtent;
+		glm::vec3		scaleMin;
+		glm::vec3		scaleExtent;
+	};
+
+	std::string					m_name;
+	unsigned int				m_startFrame;
+	unsigned int				m_endFrame;
+	std::vector<Track>			m_tracks;
+
+	// from FBXAnimation::newGeneration(), renewed by compress()
+	unsigned int				m_generation;
+
+	// key i is at frame m_startFrame + m_keyFrames[i], with its values at m_keyValues[i * 3]
+	std::vector<unsigned short>	m_keyFrames;
+	std::vector<unsigned short>	m_keyValues;
+};
+
+class FBXSkeleton;
+class TaskGraph;
+
+// The local rotation, translation and scale of each bone of a skeleton
+// Animations are sampled into poses, which can be blended and layered before the skeleton turns
+// them into bones, so that many characters can share one skeleton with a pose each.
+class FBXPose
+{
+public:
+
+	FBXPose();
+
+	// resizing resets every bone to the identity
+	void			resize(unsigned int a_boneCount);
+
+	// takes the transforms of the skeleton's nodes
+	void			reset(const FBXSkeleton* a_skeleton);
+
+	// sets the animated bones to the animation at a_time, leaving the rest as they were
+	void			sample(const FBXAnimation* a_animation, float a_time, bool a_loop = true, float a_fps = 24.0f);
+	void			sample(const FBXCompressedAnimation* a_animation, float a_time, bool a_loop = true, float a_fps = 24.0f);
+
+	// moves each bone a_weight of the way towards a_other's, scaled by a_mask's entry for the bone
+	void			blend(const FBXPose& a_other, float a_weight, const float* a_mask = nullptr);
+
+	// layers on the difference between a_additive and a_reference (e.g. its first frame)
+	void			add(const FBXPose& a_additive, const FBXPose& a_reference, float a_weight, const float* a_mask = nullptr);
+
+	unsigned int				m_boneCount;
+	std::vector<glm::quat>		m_rotations;
+	std::vector<glm::vec4>		m_translations;	// w unused, padded to load as one register
+	std::vector<glm::vec4>		m_scales;
+
+	// the key each track (or for compressed animations, each channel) was last sampled at, so
+	// that playing forward only has to step from it rather than search; reset when a different
+	// animation is sampled, which is told apart by its generation rather than its address
+	unsigned int				m_cursorGeneration;
+	std::vector<unsigned int>	m_keyCursors;
 };
 
 // A hierarchy of bones that can be animated
@@ -257,9 +439,28 @@ public:
 	FBXSkeleton();
 	~FBXSkeleton();
 
+	// sets the local transform of each animated bone, interpolating between the keys either side of
+	// a_time; tracks are evaluated four at a time with SSE where it's available
 	void			evaluate(const FBXAnimation* a_animation, float a_time, bool a_loop = true, float a_fps = 24.0f);
+	void			evaluate(const FBXCompressedAnimation* a_animation, float a_time, bool a_loop = true, float a_fps = 24.0f);
 	void			updateBones();
 
+	// fills m_bones from a pose rather than from the nodes
+	void			updateBones(const FBXPose& a_pose);
+
+	// fills a_bones (m_boneCount of them, bind pose combined) from a pose without touching the
+	// skeleton, so a skeleton can be shared by any number of posed instances
+	void			computeBones(const FBXPose& a_pose, glm::mat4* a_bones) const;
+
+	// computeBones() for a batch of poses, spread across a_tasks, returning once all are done
+	void			computeBones(const FBXPose* const* a_poses, glm::mat4* const* a_bones, unsigned int a_count, TaskGraph& a_tasks) const;
+
+	// the index of the bone whose node has this name, or -1
+	int				findBone(const char* a_name) const;
+
+	// a mask for blending that is a_weight for a_bone and every bone below it, 0 elsewhere
+	void			buildMask(unsigned int a_bone, std::vector<float>& a_mask, float a_weight = 1) const;
+
 	unsigned int	m_boneCount;
 	FBXNode**		m_nodes;
 	int*			m_parentIndex;
@@ -268,16 +469,162 @@ public:
 	glm::mat4*		m_bindPoses;
 
 	void*			m_userData;
+
+	// the pose evaluate() samples into before writing to the nodes
+	FBXPose			m_pose;
+};
+
+// One character of a crowd, posed and skinned from a skeleton it shares with the others
+// The skeleton, its nodes and the animations are only ever read, so any number of instances can
+// animate from one loaded FBXFile; each owns just its pose and its bones.
+class FBXSkeletonInstance
+{
+public:
+
+	// starts in the pose the skeleton's nodes are in
+	FBXSkeletonInstance(const FBXSkeleton* a_skeleton);
+
+	// samples into m_pose, which can then be blended or layered before updateBones()
+	void			evaluate(const FBXAnimation* a_animation, float a_time, bool a_loop = true, float a_fps = 24.0f);
+	void			evaluate(const FBXCompressedAnimation* a_animation, float a_time, bool a_loop = true, float a_fps = 24.0f);
+	void			updateBones();
+
+	// updateBones() for many instances, spread across a_tasks, returning once all are done
+	static void		updateBones(FBXSkeletonInstance* const* a_instances, unsigned int a_count, TaskGraph& a_tasks);
+
+	const FBXSkeleton*		m_skeleton;
+	FBXPose					m_pose;
+	std::vector<glm::mat4>	m_bones;		// ready for use in skinning! (bind pose combined)
+	glm::mat4				m_transform;	// where the instance is, stored ahead of its bones in an FBXBonePalette
+
+	void*					m_userData;
+};
+
+// The bones of many skeleton instances in one GL texture buffer, so that they can all be skinned
+// by a single instanced draw. Each instance stores its m_transform followed by its bones, every
+// matrix as four RGBA32F texels holding its columns. The instance transform is kept apart so that
+// it can be applied after the mesh's global transform:
+//	uniform samplerBuffer bones;
+//	uniform int boneCount;
+//	mat4 palette(int i)
+//	{
+//		int texel = (gl_InstanceID * (boneCount + 1) + i) * 4;
+//		return mat4(texelFetch(bones, texel), texelFetch(bones, texel + 1),
+//					texelFetch(bones, texel + 2), texelFetch(bones, texel + 3));
+//	}
+//	mat4 bone(int b) { return palette(b + 1); }
+//	...
+//	gl_Position = projectionView * palette(0) * global * skinnedPosition;
+class FBXBonePalette
+{
+public:
+
+	FBXBonePalette();
+	~FBXBonePalette();
+
+	// replaces the contents with each instance's bones in order, growing the buffer as needed;
+	// every instance takes the space of the one with the most bones
+	void			upload(const FBXSkeletonInstance* const* a_instances, unsigned int a_count);
+
+	// binds the buffer's texture to a texture unit for the samplerBuffer
+	void			bind(unsigned int a_textureUnit) const;
+
+	void			destroy();
+
+	unsigned int	m_buffer;
+	unsigned int	m_texture;
+	unsigned int	m_capacity;			// in matrices
+	unsigned int	m_boneCount;		// per instance, for the shader's boneCount
+	unsigned int	m_instanceCount;
+
+private:
+
+	// disallow copying, it owns GL objects
+	FBXBonePalette(const FBXBonePalette&);
+	FBXBonePalette& operator = (const FBXBonePalette&);
+};
+
+class FBXFile;
+
+// The progress of a scene loading in the background, returned by FBXFile::loadAsync()
+// Call update() once per frame on the GL thread. It hands over each mesh, material and texture as
+// it becomes ready through the callbacks, creating GL textures on the way, until the frame's time
+// budget is spent. Meshes arrive with their global transforms set and their material assigned.
+// Until the state is READY the FBXFile itself mustn't be touched, only the items passed to callbacks.
+class FBXLoadHandle
+{
+public:
+
+	enum LOAD_STATE
+	{
+		LOADING,
+		READY,
+		FAILED,
+	};
+
+	LOAD_STATE		getState() const	{	return m_state;	}
+
+	// returns true once the scene is ready
+	bool			update(float a_budgetSeconds = 0.004f);
+
+	// set these straight after loadAsync(), they're only called from update()
+	std::function<void(FBXMeshNode*)>	m_onMeshReady;
+	std::function<void(FBXMaterial*)>	m_onMaterialReady;
+	std::function<void(FBXTexture*)>	m_onTextureReady;
+
+private:
+
+	friend class FBXFile;
+
+	FBXLoadHandle(FBXFile* a_file);
+	~FBXLoadHandle();
+
+	// disallow copying
+	FBXLoadHandle(const FBXLoadHandle&);
+	FBXLoadHandle& operator = (const FBXLoadHandle&);
+
+	enum ITEM_TYPE
+	{
+		ITEM_MESH,
+		ITEM_MATERIAL,
+		ITEM_TEXTURE,
+	};
+
+	struct Item
+	{
+		ITEM_TYPE	type;
+		void*		object;
+	};
+
+	// called by the loading thread and its tasks
+	void			publish(ITEM_TYPE a_type, void* a_object);
+
+	FBXFile*			m_file;
+	std::thread*		m_thread;
+	LOAD_STATE			m_state;
+
+	std::atomic<bool>	m_hierarchyReady;	// node transforms are final, so meshes can be handed over
+	std::atomic<bool>	m_finished;			// the loading thread is done
+	bool				m_succeeded;
+
+	std::mutex			m_mutex;
+	std::vector<Item>	m_published;
+
+	// only touched by update()
+	std::deque<Item>	m_queue;
+	std::vector<Item>	m_waitingMeshes;
 };
 
 // An FBX scene representing the contents on an FBX file.
 // Stores individual items within maps, with names as the key.
 // Also has a pointer to the root of the scene's node tree.
+// Scenes can be saved to a baked binary file that loads without the FBX SDK;
+// define FBXFILE_NO_SDK to build without the SDK, when only baked files can be loaded.
 class FBXFile
 {
 public:
 
-	FBXFile() : m_root(nullptr), m_importAssistor(nullptr) {}
+	FBXFile() : m_root(nullptr), m_importAssistor(nullptr), m_weldEpsilon(0), m_importTangents(false), m_compressTextures(false), m_loadHandle(nullptr) {}
 	~FBXFile() 
 	{
 		unload();
@@ -301,7 +648,43 @@ public:
 	bool			loadAnimationsOnly(const char* a_filename, UNIT_SCALE a_scale = FBXFile::UNITS_METER );
 	void			unload();
 
-	// goes through all loaded textures and creates their GL versions
+	// starts loading on a background thread, returning a handle to track it with
+	// the handle belongs to the scene and is deleted by unload()
+	FBXLoadHandle*	loadAsync(const char* a_filename, UNIT_SCALE a_scale = FBXFile::UNITS_METER, bool a_loadTextures = true, bool a_loadAnimations = true, bool a_flipTextureY = true);
+
+	// writes the loaded scene to a baked file, which loadBaked() can read back in a fraction of the time
+	// textures are stored by filename and are loaded from the baked file's folder, as with an FBX file
+	bool			save(const char* a_filename) const;
+	bool			loadBaked(const char* a_filename, bool a_loadTextures = true);
+
+	// vertices are welded on load when all their used attributes match; with an epsilon above 0
+	// attributes are snapped to a grid of that size first, so near-identical vertices weld too
+	void			setWeldEpsilon(float a_epsilon)	{	m_weldEpsilon = a_epsilon;	}
+	float			getWeldEpsilon() const			{	return m_weldEpsilon;		}
+
+	// with importing on, meshes keep the tangents and binormals stored in the FBX file rather than
+	// having them generated, as long as the file has both; generated tangents follow MikkTSpace
+	void			setImportTangents(bool a_import)	{	m_importTangents = a_import;	}
+	bool			getImportTangents() const			{	return m_importTangents;		}
+
+	// with compression on, textures are block compressed as they load: normal maps to BC5, textures
+	// with alpha to BC3 and the rest to BC1. the result is cached next to each image as <image>.ctex
+	// and reused until the image changes. BC5 only keeps red and green, so shaders sampling a
+	// compressed normal map must rebuild blue as sqrt(1 - dot(n.xy, n.xy)) after remapping to -1..1
+	void			setTextureCompression(bool a_compress)	{	m_compressTextures = a_compress;	}
+	bool			getTextureCompression() const			{	return m_compressTextures;			}
+
+	// reorders each mesh's triangles for the GPU's post-transform vertex cache, then its vertices into
+	// the order they're first used; with a_overdraw, clusters of triangles are also sorted to draw the
+	// outermost first. meshes are reordered in parallel, and with a_report each mesh's average cache
+	// miss ratio (ACMR) is printed before and after. call it before save() to bake the new order
+	void			optimiseMeshOrder(bool a_overdraw = false, bool a_report = false);
+
+	// builds a compressed copy of each animation, in parallel, see FBXCompressedAnimation
+	// the copies are found by the same name or index as the animation they came from
+	void			compressAnimations(float a_rotationTolerance = 0.001f, float a_translationTolerance = 0.001f, float a_scaleTolerance = 0.001f);
+
+	// goes through all loaded textures and creates their GL versions, freeing their CPU copies
 	void			initialiseOpenGLTextures();
 
 	// the folder path of the FBX file
@@ -320,6 +703,7 @@ public:
 	unsigned int	getMaterialCount() const	{	return m_materials.size();	}
 	unsigned int	getSkeletonCount() const	{	return m_skeletons.size();	}
 	unsigned int	getAnimationCount() const	{	return m_animations.size();	}
+	unsigned int	getCompressedAnimationCount() const	{	return m_compressedAnimations.size();	}
 	unsigned int	getTextureCount() const		{	return m_textures.size();	}
 
 	FBXMeshNode*	getMeshByName(const char* a_name);
@@ -327,6 +711,7 @@ public:
 	FBXCameraNode*	getCameraByName(const char* a_name);
 	FBXMaterial*	getMaterialByName(const char* a_name);
 	FBXAnimation*	getAnimationByName(const char* a_name);
+	FBXCompressedAnimation*	getCompressedAnimationByName(const char* a_name);
 	FBXTexture*		getTextureByName(const char* a_name);
 
 	// these methods are slow as the items are stored in a map
@@ -336,13 +721,16 @@ public:
 	FBXMaterial*	getMaterialByIndex(unsigned int a_index);
 	FBXSkeleton*	getSkeletonByIndex(unsigned int a_index)	{	return m_skeletons[a_index];	}
 	FBXAnimation*	getAnimationByIndex(unsigned int a_index);
+	FBXCompressedAnimation*	getCompressedAnimationByIndex(unsigned int a_index);
 	FBXTexture*		getTextureByIndex(unsigned int a_index);
 
 private:
 
+	friend class FBXLoadHandle;
+
 	void	extractObject(FBXNode* a_parent, void* a_object);
 
-	void	extractMeshes(void* a_object, void* a_aieNode);
+	void	extractMeshes(void* a_object, void* a_aieNode, std::vector<FBXMeshNode*>& a_meshes);
 	void	extractLight(FBXLightNode* a_light, void* a_object);
 	void	extractCamera(FBXCameraNode* a_camera, void* a_object);
 
@@ -354,11 +742,23 @@ private:
 		
 	FBXMaterial*	extractMaterial(void* a_mesh, int a_materialIndex);
 
-	static void		optimiseMesh(FBXMeshNode* a_mesh);
-	static void		calculateTangentsBinormals(std::vector<FBXVertex>& a_vertices, const std::vector<unsigned int>& a_indices);
+	static void		weldVertices(FBXMeshNode* a_mesh, float a_epsilon);
+	// generates MikkTSpace tangents and binormals for meshes with texture coordinates that don't
+	// already have them, splitting vertices shared by mirrored and unmirrored triangles; the second
+	// spreads a large mesh across a_tasks, calling a_onFinished from the last of them
+	static void		calculateTangentsBinormals(FBXMeshNode* a_mesh);
+	static void		calculateTangentsBinormals(FBXMeshNode* a_mesh, TaskGraph& a_tasks, const std::function<void()>& a_onFinished);
 
 	unsigned int	nodeCount(FBXNode* a_node);
 
+	// loads the images of all textures, decoding them in parallel
+	void			loadTextureData();
+
+	// decodes a texture and builds its mip chain, or reads it from the cache when compressing
+	static void		loadTexture(FBXTexture* a_texture, bool a_compress);
+
+	static void		initialiseOpenGLTexture(FBXTexture* a_texture);
+
 private:
 
 	FBXNode*								m_root;
@@ -374,16 +774,19 @@ private:
 
 	std::vector<FBXSkeleton*>				m_skeletons;
 	std::map<std::string,FBXAnimation*>		m_animations;
+	std::map<std::string,FBXCompressedAnimation*>	m_compressedAnimations;
 
 	ImportAssistor*							m_importAssistor;
 
-	// threads used during loading
-	std::vector<std::thread*>				m_threads;
-	std::mutex								m_textureMutex;
+	float									m_weldEpsilon;
+	bool									m_importTangents;
+	bool									m_compressTextures;
+
+	// guards the material and texture maps while meshes are extracted in parallel
 	std::mutex								m_materialMutex;
-	std::mutex								m_meshesMutex;
 
-	std::mutex m_testMutex;
+	// set while loading asynchronously
+	FBXLoadHandle*							m_loadHandle;
 };
 
 //////////////////////////////////////////////////////////////////////////
@@ -421,7 +824,8 @@ inline FBXTexture::FBXTexture()
 	handle(0),
 	width(0),
 	height(0),
-	format(0)
+	format(0),
+	normalMap(false)
 {
 
 }
@@ -522,7 +926,8 @@ inline FBXAnimation::FBXAnimation()
 	: m_startFrame(0xffffffff), 
 	m_endFrame(0),
 	m_trackCount(0),
-	m_tracks(nullptr)
+	m_tracks(nullptr),
+	m_generation(newGeneration())
 {
 
 }
@@ -542,6 +947,36 @@ inline float FBXAnimation::totalTime(float a_fps /* = 24.0f */) const
 	return (m_endFrame - m_startFrame) / a_fps;
 }
 
+inline FBXCompressedAnimation::FBXCompressedAnimation()
+	: m_startFrame(0),
+	m_endFrame(0),
+	m_generation(FBXAnimation::newGeneration())
+{
+
+}
+
+inline FBXCompressedAnimation::~FBXCompressedAnimation()
+{
+
+}
+
+inline unsigned int FBXCompressedAnimation::totalFrames() const
+{	
+	return m_endFrame - m_startFrame;	
+}
+
+inline float FBXCompressedAnimation::totalTime(float a_fps /* = 24.0f */) const
+{
+	return (m_endFrame - m_startFrame) / a_fps;
+}
+
+inline FBXPose::FBXPose()
+	: m_boneCount(0),
+	m_cursorGeneration(0)
+{
+
+}
+
 inline FBXSkeleton::FBXSkeleton() 
 	: m_boneCount(0), 
 	m_nodes(nullptr), 
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+
+// a read-only view of a file's contents
+// regular files are memory-mapped so their contents are never copied, anything that can't be
+// mapped (pipes, devices) is streamed into memory instead
+// the view is unmapped when closed or destroyed
+// the data isn't null-terminated, use size() when passing it on, i.e. to glShaderSource
+class FileView
+{
+public:
+
+	FileView();
+	explicit FileView(const char* a_filename);
+	FileView(FileView&& a_other);
+	~FileView();
+
+	FileView& operator = (FileView&& a_other);
+
+	// prints an error and returns false if the file can't be opened
+	bool					open(const char* a_filename);
+	void					close();
+
+	bool					isOpen() const		{ return m_data != nullptr;	}
+	bool					isMapped() const	{ return m_mapped;			}
+
+	const unsigned char*	data() const		{ return m_data;			}
+	size_t					size() const		{ return m_size;			}
+
+	const unsigned char*	begin() const		{ return m_data;			}
+	const unsigned char*	end() const			{ return m_data + m_size;	}
+
+private:
+
+	// views can be moved but not copied
+	FileView(const FileView&);
+	FileView& operator = (const FileView&);
+
+	void					swap(FileView& a_other);
+
+	const unsigned char*		m_data;
+	size_t						m_size;
+	bool						m_mapped;
+
+	// storage for streamed files
+	std::vector<unsigned char>	m_buffer;
+};
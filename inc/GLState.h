@@ -0,0 +1,27 @@
+#pragma once
+
+// a cache of the GL state that the framework changes while drawing, so that it can be set and
+// restored without glGet queries, which stall the pipeline waiting for the driver
+// the cache is filled on first use, with one query per state, then kept up to date by these calls
+// state changed by calling GL directly isn't seen by the cache, so call invalidate() after doing so
+// Application::create() invalidates the cache once onCreate() has set up its state, and
+// Application::run() invalidates it again before each onDraw()
+class GLState
+{
+public:
+
+	// forgets all cached state, it is queried again the next time it is needed
+	static void		invalidate();
+
+	// GL_BLEND, GL_DEPTH_TEST and GL_CULL_FACE are cached, other capabilities are passed straight to GL
+	static void		enable(unsigned int a_capability)	{ setEnabled(a_capability, true);	}
+	static void		disable(unsigned int a_capability)	{ setEnabled(a_capability, false);	}
+	static void		setEnabled(unsigned int a_capability, bool a_enabled);
+	static bool		isEnabled(unsigned int a_capability);
+
+	static void		blendFunc(unsigned int a_source, unsigned int a_destination);
+	static void		getBlendFunc(unsigned int& a_source, unsigned int& a_destination);
+
+	static void		depthMask(bool a_write);
+	static bool		getDepthMask();
+};
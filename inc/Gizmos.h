@@ -1,7 +1,17 @@
 #pragma once
 
 #include <glm/glm.hpp>
-
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// gizmos can be added from any thread; the thread that calls create() writes straight into
+// GPU buffers, while other threads fill their own buffers which draw() merges in
+// the create() sizes are only the initial capacities, the buffers grow as needed
+// spheres, boxes, cylinders and disks are recorded as instances of cached unit meshes rather
+// than tessellated, when the context supports instancing
 class Gizmos
 {
 public:
@@ -13,6 +23,17 @@ public:
 	// removes all Gizmos
 	static void		clear();
 
+	// how transparent triangles are ordered when they're drawn
+	enum TransparencyMode
+	{
+		eUnsortedTransparency = 0,	// in the order they were added
+		eSortedTransparency,		// back to front, sorted by depth in each draw()
+	};
+
+	// sorting costs a radix sort of the transparent triangles each draw(), split across threads when there are
+	// many of them; instanced transparent gizmos are still drawn after the triangles, in the order they were added
+	static void		setTransparencyMode(TransparencyMode a_mode);
+
 	// draws current Gizmo buffers, either using a combined (projection * view) matrix, or separate matrices
 	static void		draw(const glm::mat4& a_projectionView);
 	static void		draw(const glm::mat4& a_projection, const glm::mat4& a_view);
@@ -20,6 +41,17 @@ public:
 	// the projection matrix here should ideally be orthographic with a near of -1 and far of 1
 	static void		draw2D(const glm::mat4& a_projection);
 
+	// retained layers keep gizmos that rarely change in their own buffers, so they aren't added and uploaded
+	// every frame; visible layers are drawn by every draw() and draw2D(), and aren't affected by clear()
+	// gizmos added by the GL thread between beginLayer() and endLayer() replace the layer's contents,
+	// which are uploaded once by the next draw; gizmos from other threads still go to the per-frame buffers
+	static void		beginLayer(const char* a_name);
+	static void		endLayer();
+	static bool		hasLayer(const char* a_name);
+	static void		destroyLayer(const char* a_name);
+	static void		setLayerVisible(const char* a_name, bool a_visible);
+	static bool		isLayerVisible(const char* a_name);
+
 	// Adds a single debug line
 	static void		addLine(const glm::vec3& a_rv0,  const glm::vec3& a_rv1, 
 							const glm::vec4& a_colour);
@@ -31,6 +63,12 @@ public:
 	// Adds a triangle.
 	static void		addTri(const glm::vec3& a_rv0, const glm::vec3& a_rv1, const glm::vec3& a_rv2, const glm::vec4& a_colour);
 
+	// Adds a_count lines, from each a_starts[i] to a_ends[i], all the same colour
+	static void		addLines(const glm::vec3* a_starts, const glm::vec3* a_ends, unsigned int a_count, const glm::vec4& a_colour);
+
+	// Adds a_count triangles from consecutive triples of vertices, all the same colour
+	static void		addTris(const glm::vec3* a_vertices, unsigned int a_count, const glm::vec4& a_colour);
+
 	// Adds 3 unit-length lines (red,green,blue) representing the 3 axis of a transform, 
 	// at the transform's translation. Optional scale available.
 	static void		addTransform(const glm::mat4& a_transform, float a_fScale = 1.0f);
@@ -101,66 +139,210 @@ private:
 		   unsigned int a_max2DLines, unsigned int a_max2DTris);
 	~Gizmos();
 
+	// 16 bytes, with the colour packed as normalized RGBA8
 	struct GizmoVertex
 	{
-		glm::vec4 position;
-		glm::vec4 colour;
+		glm::vec3		position;
+		unsigned int	colour;
 	};
 
-	struct GizmoLine
+	static unsigned int	packColour(const glm::vec4& a_colour);
+
+	// sets up the vertex attributes of the bound vertex array for the bound buffer
+	static void		setVertexLayout();
+
+	// writes positions to every a_stride'th vertex, all with the same colour
+	static void		copyPositions(GizmoVertex* a_vertices, unsigned int a_stride, const glm::vec3* a_positions,
+								  unsigned int a_count, unsigned int a_colour);
+
+	// a stream of vertices written by the add* calls and drawn by draw()
+	// with ARB_buffer_storage the buffer is mapped persistently as a ring of three regions, each
+	// fenced after it is drawn, so add* calls write straight into memory the GPU isn't reading
+	// without it the buffer is orphaned and mapped again for each frame
+	struct GizmoStream
 	{
-		GizmoVertex v0;
-		GizmoVertex v1;
+		unsigned int	vao;
+		unsigned int	vbo;
+
+		unsigned int	capacity;	// vertices per region
+		unsigned int	count;		// vertices written since the last clear()
+		unsigned int	region;
+
+		GizmoVertex*	mapping;	// the whole persistent mapping, or the current orphaned buffer
+		GizmoVertex*	write;		// the current region, nullptr if not mapped
+		bool			orphan;		// the next map should orphan the buffer
+		void*			fences[3];
 	};
 
-	struct GizmoTri
+	void			createStream(GizmoStream& a_stream, unsigned int a_vertices);
+	void			destroyStream(GizmoStream& a_stream);
+	void			resetStream(GizmoStream& a_stream);
+
+	// returns space for a_vertices vertices, or nullptr if the stream is full
+	GizmoVertex*	reserve(GizmoStream& a_stream, unsigned int a_vertices);
+
+	// reallocates a stream with room for at least a_vertices, keeping its current vertices
+	void			growStream(GizmoStream& a_stream, unsigned int a_vertices);
+
+	// draws the stream's vertices and fences its region
+	void			drawStream(GizmoStream& a_stream, unsigned int a_mode);
+
+	// moves transparent triangles from the thread buffers, then sorts and uploads them back to front
+	void			sortTransparentTris(const glm::mat4& a_projectionView);
+
+	// unit meshes for instanced gizmos, with the triangles and lines stored back to back
+	enum MeshShape
 	{
-		GizmoVertex v0;
-		GizmoVertex v1;
-		GizmoVertex v2;
+		eSphereMesh = 0,
+		eBoxMesh,
+		eCylinderMesh,
+		eDiskMesh,
+		eRingMesh,
 	};
 
-	unsigned int	m_shader;
+	struct GizmoMesh
+	{
+		unsigned int	triFirst;
+		unsigned int	triCount;
+		unsigned int	lineFirst;
+		unsigned int	lineCount;
+	};
 
-	// line data
-	unsigned int	m_maxLines;
-	unsigned int	m_lineCount;
-	GizmoLine*		m_lines;
+	struct GizmoInstance
+	{
+		glm::mat4		transform;
+		glm::vec4		colour;
+	};
 
-	unsigned int	m_lineVAO;
-	unsigned int 	m_lineVBO;
+	// instances sort by transparency, then mesh, then whether they draw the mesh's lines or triangles
+	struct InstanceRecord
+	{
+		unsigned long long	key;
+		GizmoInstance		instance;
+	};
 
-	// triangle data
-	unsigned int	m_maxTris;
-	unsigned int	m_triCount;
-	GizmoTri*		m_tris;
+	struct InstanceRun
+	{
+		unsigned long long	key;
+		unsigned int		first;
+		unsigned int		count;
+	};
 
-	unsigned int	m_triVAO;
-	unsigned int 	m_triVBO;
-	
-	unsigned int	m_transparentTriCount;
-	GizmoTri*		m_transparentTris;
+	static unsigned int	meshKey(MeshShape a_shape, unsigned int a_a, unsigned int a_b = 0);
+	static glm::mat4	instanceTransform(const glm::vec3& a_center, const glm::vec3& a_scale, const glm::mat4* a_transform);
+	static void			addInstance(unsigned int a_mesh, bool a_lines, const glm::mat4& a_transform, const glm::vec4& a_colour);
 
-	unsigned int	m_transparentTriVAO;
-	unsigned int 	m_transparentTriVBO;
-	
-	// 2D line data
-	unsigned int	m_max2DLines;
-	unsigned int	m_2DlineCount;
-	GizmoLine*		m_2Dlines;
+	// builds a unit mesh the first time it is used
+	const GizmoMesh&	mesh(unsigned int a_key);
+
+	// merges, sorts and uploads any new instances
+	void			prepareInstances();
+	void			drawInstances(bool a_transparent);
+
+	enum Streams
+	{
+		eLines = 0,
+		eTris,
+		eTransparentTris,
+		e2DLines,
+		e2DTris,
+
+		eStreamCount
+	};
 
-	unsigned int	m_2DlineVAO;
-	unsigned int 	m_2DlineVBO;
+	// vertices added by threads other than the GL thread, or by the GL thread once a stream is full
+	// blocks come from a pool shared by all threads and are returned to it when merged or cleared
+	struct Block;
+	struct ThreadBuffer
+	{
+		std::mutex			mutex;
+		std::vector<Block*>	blocks[eStreamCount];
+		std::vector<InstanceRecord>	instances;
+	};
+
+	// space for a primitive's vertices, holding the thread buffer's lock until it goes out of scope
+	class Reservation
+	{
+	public:
+		Reservation(unsigned int a_stream, unsigned int a_vertices);
+		~Reservation();
 
-	// 2D triangle data
-	unsigned int	m_max2DTris;
-	unsigned int	m_2DtriCount;
-	GizmoTri*		m_2Dtris;
+		GizmoVertex*	vertices;
 
-	unsigned int	m_2DtriVAO;
-	unsigned int 	m_2DtriVBO;
+	private:
+		ThreadBuffer*	m_buffer;
+	};
 
-	static Gizmos*	sm_singleton;
+	// a retained layer, with all its streams in one buffer
+	// the vertices are only kept in memory until they're uploaded
+	struct GizmoLayer
+	{
+		std::string					name;
+		bool						visible;
+		bool						dirty;
+		std::vector<GizmoVertex>	vertices[eStreamCount];
+		unsigned int				first[eStreamCount];
+		unsigned int				count[eStreamCount];
+		unsigned int				vao;
+		unsigned int				vbo;
+	};
+
+	GizmoLayer*		findLayer(const char* a_name);
+	void			uploadLayers();
+	bool			layersHave(unsigned int a_stream);
+	void			drawLayers(unsigned int a_stream, unsigned int a_mode);
+
+	ThreadBuffer*	threadBuffer();
+	void			gatherTransparentTris();
+	GizmoVertex*	reserve(ThreadBuffer& a_buffer, unsigned int a_stream, unsigned int a_vertices);
+	void			releaseBlocks(ThreadBuffer& a_buffer, unsigned int a_stream);
+	void			mergeThreadBuffers(unsigned int a_stream);
+
+	unsigned int	m_shader;
+	unsigned int	m_projectionViewUniform;
+	bool			m_persistent;
+
+	GizmoStream		m_streams[eStreamCount];
+
+	std::vector<GizmoLayer*>	m_layers;
+	GizmoLayer*					m_recording;
+
+	// with sorting, transparent triangles are kept in memory until clear() rather than written to a stream
+	TransparencyMode			m_transparency;
+	std::vector<GizmoVertex>	m_transparentTris;
+	std::vector<GizmoVertex>	m_sortedTris;
+	std::vector<unsigned int>	m_sortKeys;
+	std::vector<unsigned int>	m_sortIndices;
+	unsigned int				m_sortedVAO;
+	unsigned int				m_sortedVBO;
+
+	// instancing needs GL 3.3 or ARB_instanced_arrays, otherwise every gizmo is tessellated
+	bool			m_instancing;
+	unsigned int	m_instanceShader;
+	unsigned int	m_instanceProjectionViewUniform;
+	unsigned int	m_meshVAO;
+	unsigned int	m_meshVBO;
+	unsigned int	m_instanceVBO;
+	unsigned int	m_instanceCapacity;
+
+	std::map<unsigned int, GizmoMesh>	m_meshes;
+	std::vector<glm::vec4>				m_meshVertices;
+	bool								m_meshesChanged;
+
+	// every instance added since the last clear(), sorted into runs when new ones arrive
+	std::vector<InstanceRecord>	m_instances;
+	std::vector<GizmoInstance>	m_instanceData;
+	std::vector<InstanceRun>	m_instanceRuns;
+	bool						m_instancesChanged;
+
+	std::thread::id				m_glThread;
+	std::mutex					m_threadMutex;
+	std::vector<ThreadBuffer*>	m_threadBuffers;
+	std::mutex					m_poolMutex;
+	std::vector<Block*>			m_freeBlocks;
+
+	static Gizmos*		sm_singleton;
+	static unsigned int	sm_generation;
 };
 
 inline void Gizmos::draw(const glm::mat4& a_projection, const glm::mat4& a_view)
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+#include <mutex>
+
+// a lightweight per-frame CPU/GPU profiler
+// Application::run() marks frames and times onUpdate/onDraw automatically once
+// the profiler has been created; projects can add their own zones with PROFILE_SCOPE
+// zone names must be string literals (or otherwise outlive the profiler)
+class Profiler
+{
+public:
+
+	// a_historyFrames is how many frames are kept in the ring-buffer
+	// GPU timing requires a GL context that supports GL_TIME_ELAPSED queries, so
+	// destroy the profiler in onDestroy() while that context still exists
+	static void		create(unsigned int a_historyFrames = 128, bool a_gpuTiming = true);
+	static void		destroy();
+
+	// frame boundaries, called by Application::run()
+	static void		beginFrame();
+	static void		endFrame();
+
+	// CPU zones, can be nested and used from any thread
+	static void		pushZone(const char* a_name);
+	static void		popZone();
+
+	// GPU zones, timed with GL_TIME_ELAPSED queries on the GL thread
+	// results are read back two frames later so the CPU never waits on the GPU
+	// GPU zones can't overlap, so nested GPU zones are ignored
+	static void		beginGPUZone(const char* a_name);
+	static void		endGPUZone();
+
+	// adds 2D gizmos drawing the frame history as bars, one per frame, with the main
+	// thread's top-level zones stacked in different colours and the GPU time as a white mark
+	static void		addGizmos(const glm::vec2& a_position, const glm::vec2& a_size, float a_maxMilliseconds = 33.3f);
+
+	// writes the frame history in the Chrome trace event format (view in chrome://tracing)
+	static bool		exportChromeTrace(const char* a_filename);
+
+private:
+
+	Profiler(unsigned int a_historyFrames, bool a_gpuTiming);
+	~Profiler();
+
+	struct Zone
+	{
+		const char*		name;
+		unsigned int	thread;
+		unsigned int	depth;
+		double			start;	// microseconds since the profiler was created
+		double			end;
+	};
+
+	struct FrameRecord
+	{
+		unsigned int		frame;
+		double				start;
+		double				end;
+		std::vector<Zone>	zones;
+		std::vector<Zone>	gpuZones;
+	};
+
+	struct ThreadState
+	{
+		unsigned int		index;
+		std::vector<Zone>	stack;
+
+		// zones completed since the end of the last frame
+		std::mutex			mutex;
+		std::vector<Zone>	completed;
+	};
+
+	struct GPUQuery
+	{
+		const char*		name;
+		unsigned int	query;
+		unsigned int	frame;
+		double			start;
+	};
+
+	static double	now();
+	ThreadState*	threadState();
+	void			readGPUQueries(std::vector<GPUQuery>& a_queries);
+
+	unsigned int				m_frame;
+	std::vector<FrameRecord>	m_history;
+
+	std::mutex					m_threadMutex;
+	std::vector<ThreadState*>	m_threads;
+
+	// GPU queries are double-buffered by frame
+	bool						m_gpuTiming;
+	unsigned int				m_gpuDepth;
+	std::vector<GPUQuery>		m_gpuQueries[2];
+	std::vector<unsigned int>	m_freeQueries;
+
+	static Profiler*	sm_singleton;
+	static unsigned int	sm_generation;
+};
+
+// times a CPU zone until the end of the enclosing scope
+class ProfileScope
+{
+public:
+
+	ProfileScope(const char* a_name)	{ Profiler::pushZone(a_name);	}
+	~ProfileScope()						{ Profiler::popZone();			}
+};
+
+// times a GPU zone until the end of the enclosing scope
+class ProfileGPUScope
+{
+public:
+
+	ProfileGPUScope(const char* a_name)	{ Profiler::beginGPUZone(a_name);	}
+	~ProfileGPUScope()					{ Profiler::endGPUZone();			}
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope_, __LINE__)(name)
+#define PROFILE_GPU_SCOPE(name) ProfileGPUScope PROFILE_CONCAT(profileGPUScope_, __LINE__)(name)
\ No newline at end of file
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "Utilities.h"
+#include <string>
+#include <vector>
+
+// a linked shader program whose active uniforms and uniform blocks are reflected once into
+// hash tables, so that lookups during a frame don't need to go through glGetUniformLocation
+// with hot-reloading enabled the source files are watched (inotify on Linux, polling elsewhere)
+// and the program is rebuilt in the background, then swapped in once it has linked
+// locations can change when a program reloads, so look them up each frame rather than storing them
+class ShaderProgram
+{
+public:
+
+	ShaderProgram();
+	~ShaderProgram();
+
+	// builds the program, the description's strings are copied
+	bool			load(const ProgramDesc& a_desc, bool a_hotReload = false);
+	void			unload();
+
+	unsigned int	getHandle() const	{ return m_handle;	}
+	void			bind() const;
+
+	// returns the location of an active uniform, or -1
+	// array elements can be looked up by their full name, i.e. "lights[2].color"
+	// hashes from hashName() can be computed once up front to avoid hashing strings each frame
+	int				getUniform(const char* a_name) const	{ return getUniform(hashName(a_name));	}
+	int				getUniform(unsigned int a_hash) const;
+
+	// returns the index of an active uniform block, or -1
+	int				getUniformBlock(const char* a_name) const;
+
+	// binds a uniform block to a binding point, the binding is kept across reloads
+	void			setUniformBlockBinding(const char* a_name, unsigned int a_binding);
+
+	static unsigned int	hashName(const char* a_name);
+
+	// finishes any pending reloads, called once per frame by Application::run()
+	static void		updateHotReload();
+
+private:
+
+	// disallow copying, the watcher thread holds pointers to programs
+	ShaderProgram(const ShaderProgram&);
+	ShaderProgram& operator = (const ShaderProgram&);
+
+	struct TableEntry
+	{
+		unsigned int	hash;	// 0 marks an empty slot
+		int				location;
+	};
+
+	struct Uniform
+	{
+		std::string		name;
+		unsigned int	type;
+		int				location;
+	};
+
+	struct WatchedFile
+	{
+		std::string		path;
+		std::string		directory;
+		std::string		name;
+		long long		modified;
+	};
+
+	// returns false if the hash is already in the table, i.e. two names hash the same
+	static bool		insert(std::vector<TableEntry>& a_table, unsigned int a_hash, int a_location);
+	static int		find(const std::vector<TableEntry>& a_table, unsigned int a_hash);
+
+	void			reflect();
+	void			beginReload();
+	bool			finishReload();
+
+	static void		watch(ShaderProgram* a_program);
+	static void		unwatch(ShaderProgram* a_program);
+	static void		watchThread();
+
+	unsigned int				m_handle;
+
+	std::vector<Uniform>		m_uniforms;
+	std::vector<TableEntry>		m_uniformTable;
+	std::vector<TableEntry>		m_blockTable;
+	std::vector< std::pair<std::string, unsigned int> >	m_blockBindings;
+
+	// description used for reloading
+	std::string					m_stages[5];
+	std::vector<std::string>	m_inputs;
+	std::vector<std::string>	m_outputs;
+
+	// hot-reload state, shared with the watcher thread
+	bool						m_hotReload;
+	std::vector<WatchedFile>	m_files;
+	double						m_changeTime;
+	bool						m_sourcesReady;
+	std::string					m_sources[5];
+
+	// a rebuild that has been issued but not yet checked
+	unsigned int				m_pendingHandle;
+	unsigned int				m_pendingShaders[5];
+	unsigned int				m_pendingFrames;
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// runs tasks on a bounded pool of worker threads, each task starting once all of the tasks it
+// depends on have finished
+// tasks can be added from any thread, including from inside other tasks
+// wait() lends the calling thread to the pool until every task has finished, after which the graph
+// is empty and can be reused; handles returned before the wait are no longer valid
+class TaskGraph
+{
+public:
+
+	typedef unsigned int Task;
+
+	// a worker count of 0 uses one worker per hardware thread, less the thread that waits
+	TaskGraph(unsigned int a_workerCount = 0);
+	~TaskGraph();
+
+	Task			add(const std::function<void()>& a_work);
+	Task			add(const std::function<void()>& a_work, Task a_dependency);
+	Task			add(const std::function<void()>& a_work, const Task* a_dependencies, unsigned int a_dependencyCount);
+
+	// only one thread should wait at a time
+	void			wait();
+
+	unsigned int	getWorkerCount() const	{ return (unsigned int)m_workers.size();	}
+
+private:
+
+	// disallow copying, the workers hold a pointer to the graph
+	TaskGraph(const TaskGraph&);
+	TaskGraph& operator = (const TaskGraph&);
+
+	struct Node
+	{
+		std::function<void()>	work;
+		unsigned int			waitingOn;
+		bool					finished;
+		std::vector<Task>		dependents;
+	};
+
+	// runs a ready task, if there is one, unlocking while it runs
+	bool			runReadyTask(std::unique_lock<std::mutex>& a_lock);
+
+	void			workerThread();
+
+	// nodes are only touched while the mutex is held
+	std::deque<Node>			m_nodes;
+	std::vector<Task>			m_ready;
+	unsigned int				m_unfinished;
+	bool						m_quit;
+
+	std::mutex					m_mutex;
+	std::condition_variable		m_signal;
+
+	std::vector<std::thread*>	m_workers;
+};
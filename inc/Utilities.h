@@ -16,6 +16,24 @@ struct GLData
 	unsigned int	vao, vbo, ibo;
 };
 
+// describes a shader program for Utility::buildPrograms
+// stage filenames that are nullptr are skipped; handle is filled in (0 on failure)
+struct ProgramDesc
+{
+	const char*		vertexShader;
+	const char*		controlShader;
+	const char*		evaluationShader;
+	const char*		geometryShader;
+	const char*		fragmentShader;
+
+	unsigned int	inputAttributeCount;
+	const char**	inputAttributes;
+	unsigned int	outputAttributeCount;
+	const char**	outputAttributes;
+
+	unsigned int	handle;
+};
+
 // a utility class with static helper methods
 class Utility
 {
@@ -24,6 +42,7 @@ public:
 	// utilities for timing
 	static void		resetTimer();
 	static float	tickTimer();
+	static float	stepTimer(float a_deltaTime);	// advances by a fixed amount rather than the real elapsed time
 	static float	getDeltaTime()	{ return sm_deltaTime;	}
 	static float	getTotalTime()	{ return sm_totalTime;	}
 
@@ -45,7 +64,16 @@ public:
 									  unsigned int a_inputAttributeCount = 0, const char** a_inputAttributes = nullptr,
 									  unsigned int a_outputAttributeCount = 0, const char** a_outputAttributes = nullptr);
 
-	// helper function for loading shader code into memory
+	// loads and builds several shader programs at once, issuing every compile and link before
+	// checking any of them so the driver can work in parallel (GL_KHR_parallel_shader_compile)
+	// if a cache folder is given, linked program binaries are stored there keyed by a hash of
+	// the sources and the GL driver, and later builds load the binary instead of compiling;
+	// the folder is created if it doesn't exist, but not its parents
+	// returns false if any of the programs failed to build
+	static bool		buildPrograms(unsigned int a_count, ProgramDesc* a_programs, const char* a_cacheFolder = nullptr);
+
+	// helper function for loading shader code into memory, returns a null-terminated copy that
+	// must be deleted with delete[]; use a FileView to read files without copying them
 	static unsigned char*	fileToBuffer(const char* a_filename);
 
 	// builds a textured plane out of 2 triangles and fills in the vertex array object, vertex buffer object, and index buffer object
@@ -272,6 +272,7 @@ public:
 };
 
 AIAssessment::AIAssessment()
+	: m_navMeshKeyDown(false)
 {
 
 }
@@ -321,6 +322,35 @@ bool AIAssessment::onCreate(int a_argc, char* a_argv[])
 	// create NavMesh
 	GenerateNavMesh();
 
+	// the grid, obstacles and NavMesh never change, so record them once into retained layers
+	Gizmos::beginLayer("world");
+
+	// add an identity matrix gizmo
+	Gizmos::addTransform( glm::mat4(1,0,0,0,0,1,0,0,0,0,1,0,0,0,0,1) );
+
+	// add a 20x20 grid on the XZ-plane
+	for ( int i = 0 ; i < 21 ; ++i )
+	{
+		Gizmos::addLine( glm::vec3(-10 + i, 10, 0), glm::vec3(-10 + i, -10, 0), 
+						 i == 10 ? glm::vec4(1,1,1,1) : glm::vec4(0,0,0,1) );
+		
+		Gizmos::addLine( glm::vec3(10, -10 + i, 0), glm::vec3(-10, -10 + i, 0), 
+						 i == 10 ? glm::vec4(1,1,1,1) : glm::vec4(0,0,0,1) );
+	}
+
+	// add obstacles
+	for each (auto obstacle in m_obstacles)
+	{
+		Gizmos::addAABBFilled(glm::vec3(obstacle.center(), 0.5),
+							  glm::vec3(obstacle.extents(), 0.5),
+							  glm::vec4(0.5f, 0.5f, 0.5f, 1));
+	}
+	Gizmos::endLayer();
+
+	Gizmos::beginLayer("navmesh");
+	m_mesh.addGizmos();
+	Gizmos::endLayer();
+
 	// lambda function for getting the squared distance between the agents
 	auto range = [&] { return glm::distance2(m_pathAgent.getPosition(), m_patrolAgent.getPosition()); };
 
@@ -410,27 +440,6 @@ void AIAssessment::onUpdate(float a_deltaTime)
 	// clear all gizmos from last frame
 	Gizmos::clear();
 	
-	// add an identity matrix gizmo
-	Gizmos::addTransform( glm::mat4(1,0,0,0,0,1,0,0,0,0,1,0,0,0,0,1) );
-
-	// add a 20x20 grid on the XZ-plane
-	for ( int i = 0 ; i < 21 ; ++i )
-	{
-		Gizmos::addLine( glm::vec3(-10 + i, 10, 0), glm::vec3(-10 + i, -10, 0), 
-						 i == 10 ? glm::vec4(1,1,1,1) : glm::vec4(0,0,0,1) );
-		
-		Gizmos::addLine( glm::vec3(10, -10 + i, 0), glm::vec3(-10, -10 + i, 0), 
-						 i == 10 ? glm::vec4(1,1,1,1) : glm::vec4(0,0,0,1) );
-	}
-
-	// add obstacles
-	for each (auto obstacle in m_obstacles)
-	{
-		Gizmos::addAABBFilled(glm::vec3(obstacle.center(), 0.5),
-							  glm::vec3(obstacle.extents(), 0.5),
-							  glm::vec4(0.5f, 0.5f, 0.5f, 1));
-	}
-
 	// add agents
 	m_patrolAgent.update(a_deltaTime);
 	Gizmos::addCylinderFilled(m_patrolAgent.getPosition(), 0.5, 0.25, 8,
@@ -471,8 +480,11 @@ void AIAssessment::onUpdate(float a_deltaTime)
 						glm::vec4(1, 0, (i > m_pathIndex ? 1 : 0), 1));
 	}
 
-	// add NavMesh
-	m_mesh.addGizmos();
+	// toggle the NavMesh layer with N
+	bool navMeshKeyDown = glfwGetKey(m_window,GLFW_KEY_N) == GLFW_PRESS;
+	if (navMeshKeyDown && !m_navMeshKeyDown)
+		Gizmos::setLayerVisible("navmesh", !Gizmos::isLayerVisible("navmesh"));
+	m_navMeshKeyDown = navMeshKeyDown;
 
 	// quit our application when escape is pressed
 	if (glfwGetKey(m_window,GLFW_KEY_ESCAPE) == GLFW_PRESS)
@@ -39,4 +39,5 @@ protected:
 	Agent m_pathAgent;
 
 	NavMesh	m_mesh;
+	bool	m_navMeshKeyDown;
 };
\ No newline at end of file
@@ -60,29 +60,41 @@ float PathNode::pathCostFrom(const PathNode* const a_node) const
 
 void NavMesh::addGizmos() const
 {
+	// batch the tiles, and their edges by whether or not they're shared
+	std::vector<glm::vec3> tris;
+	std::vector<glm::vec3> starts[2];
+	std::vector<glm::vec3> ends[2];
+	tris.reserve(size() * 6);
+
 	for each (auto tile in *this)
 	{
 		if (nullptr == tile) continue;
-		Gizmos::addTri(glm::vec3(tile->rect.bottomLeft, 0.1f),
-					   glm::vec3(tile->rect.bottomRight(), 0.1f),
-					   glm::vec3(tile->rect.topRight, 0.1f),
-					   glm::vec4(0, 1, 0, 0.25f));
-		Gizmos::addTri(glm::vec3(tile->rect.topRight, 0.1f),
-					   glm::vec3(tile->rect.topLeft(), 0.1f),
-					   glm::vec3(tile->rect.bottomLeft, 0.1f),
-					   glm::vec4(0, 1, 0, 0.25f));
-		Gizmos::addLine(glm::vec3(tile->rect.topRight, 0.1f),
-						glm::vec3(tile->rect.bottomRight(), 0.1f),
-						glm::vec4((nullptr == tile->neighbors[Rectangle::RIGHT] ? 1 : 0), 1, 0, 1));
-		Gizmos::addLine(glm::vec3(tile->rect.bottomRight(), 0.1f),
-						glm::vec3(tile->rect.bottomLeft, 0.1f),
-						glm::vec4((nullptr == tile->neighbors[Rectangle::BOTTOM] ? 1 : 0), 1, 0, 1));
-		Gizmos::addLine(glm::vec3(tile->rect.bottomLeft, 0.1f),
-						glm::vec3(tile->rect.topLeft(), 0.1f),
-						glm::vec4((nullptr == tile->neighbors[Rectangle::LEFT] ? 1 : 0), 1, 0, 1));
-		Gizmos::addLine(glm::vec3(tile->rect.topLeft(), 0.1f),
-						glm::vec3(tile->rect.topRight, 0.1f),
-						glm::vec4((nullptr == tile->neighbors[Rectangle::TOP] ? 1 : 0), 1, 0, 1));
+		glm::vec3 corners[4] = { glm::vec3(tile->rect.topRight, 0.1f),
+								 glm::vec3(tile->rect.bottomRight(), 0.1f),
+								 glm::vec3(tile->rect.bottomLeft, 0.1f),
+								 glm::vec3(tile->rect.topLeft(), 0.1f) };
+		tris.push_back(corners[2]);
+		tris.push_back(corners[1]);
+		tris.push_back(corners[0]);
+		tris.push_back(corners[0]);
+		tris.push_back(corners[3]);
+		tris.push_back(corners[2]);
+
+		// corners are in edge order, so edge i runs from corner i to the next
+		for (unsigned int i = 0; i < Rectangle::EDGE_COUNT; ++i)
+		{
+			unsigned int open = (nullptr == tile->neighbors[i] ? 1 : 0);
+			starts[open].push_back(corners[i]);
+			ends[open].push_back(corners[(i + 1) % 4]);
+		}
+	}
+
+	if (!tris.empty())
+		Gizmos::addTris(tris.data(), (unsigned int)(tris.size() / 3), glm::vec4(0, 1, 0, 0.25f));
+	for (unsigned int open = 0; open < 2; ++open)
+	{
+		if (!starts[open].empty())
+			Gizmos::addLines(starts[open].data(), ends[open].data(), (unsigned int)starts[open].size(), glm::vec4((float)open, 1, 0, 1));
 	}
 }
 
@@ -1,6 +1,7 @@
 #include "AnimationTutorial.h"
 #include "Gizmos.h"
 #include "Utilities.h"
+#include "TaskGraph.h"
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include <glm/ext.hpp>
@@ -8,6 +9,10 @@
 #define DEFAULT_SCREENWIDTH 1280
 #define DEFAULT_SCREENHEIGHT 720
 
+// the crowd is a square of this many characters a side
+#define CROWD_WIDTH 10
+#define CROWD_SPACING 2.0f
+
 AnimationTutorial::AnimationTutorial()
 {
 
@@ -57,6 +62,18 @@ bool AnimationTutorial::onCreate(int a_argc, char* a_argv[])
 	m_fbx->initialiseOpenGLTextures();
 	InitFBXSceneResource(m_fbx);
 
+	// every character poses the same skeleton, each standing in its own spot
+	FBXSkeleton* skeleton = m_fbx->getSkeletonByIndex(0);
+	for ( int i = 0 ; i < CROWD_WIDTH * CROWD_WIDTH ; ++i )
+	{
+		FBXSkeletonInstance* instance = new FBXSkeletonInstance(skeleton);
+		instance->m_transform[3] = glm::vec4((i % CROWD_WIDTH - CROWD_WIDTH / 2) * CROWD_SPACING, 0,
+											 (i / CROWD_WIDTH - CROWD_WIDTH / 2) * CROWD_SPACING, 1);
+		m_crowd.push_back(instance);
+	}
+
+	m_tasks = new TaskGraph();
+
 	return true;
 }
 
@@ -114,6 +131,13 @@ void AnimationTutorial::onDestroy()
 
 	glDeleteShader(m_shader);
 
+	for (auto instance : m_crowd)
+		delete instance;
+	m_crowd.clear();
+	m_palette.destroy();
+	delete m_tasks;
+	m_tasks = NULL;
+
 	DestroyFBXSceneResource(m_fbx);
 	m_fbx->unload();
 	delete m_fbx;
@@ -174,12 +198,15 @@ void AnimationTutorial::UpdateFBXSceneResource(FBXFile *a_pScene)
 {
 	a_pScene->getRoot()->updateGlobalTransform();
 
-	// grab the skeleton and animation we want to use
-	FBXSkeleton* skeleton = m_fbx->getSkeletonByIndex(0);
+	// grab the animation we want to use
 	FBXAnimation* animation = m_fbx->getAnimationByIndex(0);
 
-	// evaluate the animation to update bones
-	skeleton->evaluate(animation, Utility::getTotalTime());
+	// evaluate the animation for each character, staggered so they aren't all in step
+	for ( unsigned int i = 0 ; i < m_crowd.size() ; ++i )
+		m_crowd[i]->evaluate(animation, Utility::getTotalTime() + i * 0.37f);
+
+	// update the bones to include the bind pose, so that the offset is local
+	FBXSkeletonInstance::updateBones(m_crowd.data(), (unsigned int)m_crowd.size(), *m_tasks);
 }
 
 void AnimationTutorial::RenderFBXSceneResource(FBXFile *a_pScene, glm::mat4 a_view, glm::mat4 a_projection)
@@ -194,14 +221,13 @@ void AnimationTutorial::RenderFBXSceneResource(FBXFile *a_pScene, glm::mat4 a_vi
 	GLint uGlobal = glGetUniformLocation(m_shader, "global");
 	GLint uProjectionView = glGetUniformLocation(m_shader, "projectionView");
 	GLint uBones = glGetUniformLocation(m_shader, "bones");
-	
-	// update the bones to include the bind pose
-	// so that the offset is local
-	FBXSkeleton* skeleton = m_fbx->getSkeletonByIndex(0);
-	skeleton->updateBones();
+	GLint uBoneCount = glGetUniformLocation(m_shader, "boneCount");
 
-	// bind the array of bones
-	glUniformMatrix4fv(uBones, skeleton->m_boneCount, GL_FALSE, (float*)skeleton->m_bones);
+	// send every character's transform and bones in one buffer, and bind it to texture unit 2
+	m_palette.upload(m_crowd.data(), (unsigned int)m_crowd.size());
+	m_palette.bind(2);
+	glUniform1i(uBones, 2);
+	glUniform1i(uBoneCount, m_palette.m_boneCount);
 
 	// for each mesh in the model...
 	for (unsigned int i = 0; i<a_pScene->getMeshCount(); ++i)
@@ -233,8 +259,9 @@ void AnimationTutorial::RenderFBXSceneResource(FBXFile *a_pScene, glm::mat4 a_vi
 		// remember in the initialise function, we bound the VAO and IBO to the VAO
 		// so when we bind the VAO, openGL knows what what vertices,
 		// indices and vertex attributes to send to the shader
+		// the whole crowd is drawn at once, each instance reading its own bones
 		glBindVertexArray(ro->VAO);
-		glDrawElements(GL_TRIANGLES, mesh->m_indices.size(), GL_UNSIGNED_INT, 0);
+		glDrawElementsInstanced(GL_TRIANGLES, mesh->m_indices.size(), GL_UNSIGNED_INT, 0, m_palette.m_instanceCount);
 
 	}
 
@@ -3,6 +3,9 @@
 #include "Application.h"
 #include "FBXFile.h"
 #include <glm/glm.hpp>
+#include <vector>
+
+class TaskGraph;
 
 struct OGL_FBXRenderData
 {
@@ -36,4 +39,9 @@ protected:
 
 	unsigned int m_shader;
 	FBXFile *m_fbx;
+
+	// a crowd of characters sharing the one file's skeleton and animation
+	std::vector<FBXSkeletonInstance*> m_crowd;
+	FBXBonePalette m_palette;
+	TaskGraph *m_tasks;
 };
\ No newline at end of file
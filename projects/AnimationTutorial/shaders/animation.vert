@@ -10,9 +10,22 @@ out vec2 TexCoord;
 uniform mat4 projectionView;
 uniform mat4 global;
 
-// we need to give our bone array a limit
-const int MAX_BONES = 128;
-uniform mat4 bones[MAX_BONES];
+// every instance's transform followed by its bones, boneCount of them each,
+// stored as 4 texels per matrix
+uniform samplerBuffer bones;
+uniform int boneCount;
+
+mat4 palette(int i)
+{
+	int texel = (gl_InstanceID * (boneCount + 1) + i) * 4;
+	return mat4(texelFetch(bones, texel), texelFetch(bones, texel + 1),
+				texelFetch(bones, texel + 2), texelFetch(bones, texel + 3));
+}
+
+mat4 bone(int b)
+{
+	return palette(b + 1);
+}
 
 void main()
 {
@@ -20,11 +33,12 @@ void main()
 	ivec4 index = ivec4(indices);
 	
 	// sample bones and blend up to 4
-	vec4 P = bones[ index.x ] * position * weights.x;
-	P += bones[ index.y ] * position * weights.y;
-	P += bones[ index.z ] * position * weights.z;
-	P += bones[ index.w ] * position * weights.w;
+	vec4 P = bone( index.x ) * position * weights.x;
+	P += bone( index.y ) * position * weights.y;
+	P += bone( index.z ) * position * weights.z;
+	P += bone( index.w ) * position * weights.w;
 	
 	TexCoord = texCoord;
-	gl_Position = projectionView * global * P;
+	// place the skinned mesh, then move it to where the instance is
+	gl_Position = projectionView * palette(0) * global * P;
 }
@@ -21,30 +21,61 @@ NavMesh::~NavMesh()
 
 bool NavMesh::onCreate(int a_argc, char* a_argv[]) 
 {
-	// initialise the Gizmos helper class
-	Gizmos::create();
+	// sponza is only drawn, so a headless benchmark skips it along with the window and GL
+	m_sponza = nullptr;
+	m_sponzaLoad = nullptr;
+	m_shader = 0;
 
-	// create a world-space matrix for a camera
-	m_cameraMatrix = glm::inverse( glm::lookAt(glm::vec3(10,10,0),glm::vec3(0,0,0), glm::vec3(0,1,0)) );
-	
-	// create a perspective projection matrix with a 90 degree field-of-view and widescreen aspect ratio
-	m_projectionMatrix = glm::perspective(glm::pi<float>() * 0.25f, DEFAULT_SCREENWIDTH/(float)DEFAULT_SCREENHEIGHT, 0.1f, 1000.0f);
+	if (isHeadless() == false)
+	{
+		// initialise the Gizmos helper class
+		Gizmos::create();
+
+		// create a world-space matrix for a camera
+		m_cameraMatrix = glm::inverse( glm::lookAt(glm::vec3(10,10,0),glm::vec3(0,0,0), glm::vec3(0,1,0)) );
+		
+		// create a perspective projection matrix with a 90 degree field-of-view and widescreen aspect ratio
+		m_projectionMatrix = glm::perspective(glm::pi<float>() * 0.25f, DEFAULT_SCREENWIDTH/(float)DEFAULT_SCREENHEIGHT, 0.1f, 1000.0f);
 
-	// set the clear colour and enable depth testing and backface culling
-	glClearColor(0.25f,0.25f,0.25f,1);
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_CULL_FACE);
+		// set the clear colour and enable depth testing and backface culling
+		glClearColor(0.25f,0.25f,0.25f,1);
+		glEnable(GL_DEPTH_TEST);
+		glEnable(GL_CULL_FACE);
 
-	m_sponza = new FBXFile();
-	m_sponza->load("models/SponzaSimple.fbx", FBXFile::UNITS_CENTIMETER);
-	createOpenGLBuffers(m_sponza);
+		m_sponza = new FBXFile();
+		m_sponzaLoad = m_sponza->loadAsync("models/SponzaSimple.fbx", FBXFile::UNITS_CENTIMETER);
+		m_sponzaLoad->m_onMeshReady = [this](FBXMeshNode* a_mesh)
+		{
+			createOpenGLBuffers(a_mesh);
+			m_sponzaMeshes.push_back(a_mesh);
+		};
+
+		unsigned int vs = Utility::loadShader("shaders/sponza.vert", GL_VERTEX_SHADER);
+		unsigned int fs = Utility::loadShader("shaders/sponza.frag", GL_FRAGMENT_SHADER);
+		m_shader = Utility::createProgram(vs,0,0,0,fs);
+		glDeleteShader(vs);
+		glDeleteShader(fs);
+	}
+	else
+	{
+		// the same paths every run so that headless benchmarks are repeatable
+		srand(1);
+	}
 
+	// only the nav mesh's triangles are used, and textures would need GL to clean up
 	m_navMesh = new FBXFile();
-	m_navMesh->load("models/SponzaSimpleNavMesh.fbx", FBXFile::UNITS_CENTIMETER);
+	m_navMesh->load("models/SponzaSimpleNavMesh.fbx", FBXFile::UNITS_CENTIMETER, false);
 //	createOpenGLBuffers(m_navMesh);
 
 	buildNavMesh(m_navMesh->getMeshByIndex(0), m_graph);
 
+	findRandomPath(true);
+
+	return true;
+}
+
+bool NavMesh::findRandomPath(bool a_print)
+{
 	NavNodeTri* start = nullptr;
 	NavNodeTri* end = nullptr;
 	start = m_graph[rand() % m_graph.size()];
@@ -52,26 +83,35 @@ bool NavMesh::onCreate(int a_argc, char* a_argv[])
 	{
 		end = m_graph[rand() % m_graph.size()];
 	} while (end == start || end == start->edgeTarget[0] || end == start->edgeTarget[1] || end == start->edgeTarget[2]);
-	printf(findPath(start, end, m_graph, m_path)
-			? "path found from (%f, %f, %f) to (%f, %f, %f)\n"
-			: "path not found from (%f, %f, %f) to (%f, %f, %f)\n",
-		   start->position.x, start->position.y, start->position.z,
-		   end->position.x, end->position.y, end->position.z);
-
-	unsigned int vs = Utility::loadShader("shaders/sponza.vert", GL_VERTEX_SHADER);
-	unsigned int fs = Utility::loadShader("shaders/sponza.frag", GL_FRAGMENT_SHADER);
-	m_shader = Utility::createProgram(vs,0,0,0,fs);
-	glDeleteShader(vs);
-	glDeleteShader(fs);
 
-	return true;
+	m_path.clear();
+	bool found = findPath(start, end, m_graph, m_path);
+	if (a_print)
+	{
+		printf(found
+				? "path found from (%f, %f, %f) to (%f, %f, %f)\n"
+				: "path not found from (%f, %f, %f) to (%f, %f, %f)\n",
+			   start->position.x, start->position.y, start->position.z,
+			   end->position.x, end->position.y, end->position.z);
+	}
+	return found;
 }
 
 void NavMesh::onUpdate(float a_deltaTime) 
 {
+	// a headless benchmark finds a new path each frame, and has nothing to draw
+	if (isHeadless())
+	{
+		findRandomPath(false);
+		return;
+	}
+
 	// update our camera matrix using the keyboard/mouse
 	Utility::freeMovement( m_cameraMatrix, a_deltaTime, 10 );
 
+	// take on whatever has finished loading, spending up to 4ms of the frame
+	m_sponzaLoad->update(0.004f);
+
 	// clear all gizmos from last frame
 	Gizmos::clear();
 	
@@ -161,11 +201,8 @@ void NavMesh::onDraw()
 	int location = glGetUniformLocation(m_shader, "projectionView");
 	glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr( m_projectionMatrix * viewMatrix ));
 
-	unsigned int count = m_sponza->getMeshCount();
-	for (unsigned int i = 0 ; i < count ; ++i )
+	for (auto mesh : m_sponzaMeshes)
 	{
-		FBXMeshNode* mesh = m_sponza->getMeshByIndex(i);
-
 		GLData* data = (GLData*)mesh->m_userData;
 
 		location = glGetUniformLocation(m_shader, "model");
@@ -184,13 +221,14 @@ void NavMesh::onDraw()
 
 void NavMesh::onDestroy()
 {
-	cleanupOpenGLBuffers(m_sponza);
-	//cleanupOpenGLBuffers(m_navMesh);
+	for (auto mesh : m_sponzaMeshes)
+		cleanupOpenGLBuffers(mesh);
 
 	delete m_navMesh;
 	delete m_sponza;
 
-	glDeleteProgram(m_shader);
+	if (m_shader != 0)
+		glDeleteProgram(m_shader);
 
 	// clean up anything we created
 	Gizmos::destroy();
@@ -211,56 +249,44 @@ int main(int argc, char* argv[])
 	return 0;
 }
 
-void NavMesh::createOpenGLBuffers(FBXFile* a_fbx)
+void NavMesh::createOpenGLBuffers(FBXMeshNode* a_mesh)
 {
-	// create the GL VAO/VBO/IBO data for meshes
-	for ( unsigned int i = 0 ; i < a_fbx->getMeshCount() ; ++i )
-	{
-		FBXMeshNode* mesh = a_fbx->getMeshByIndex(i);
-
-		// storage for the opengl data in 3 unsigned int
-		GLData* glData = new GLData();
+	// storage for the opengl data in 3 unsigned int
+	GLData* glData = new GLData();
 
-		glGenVertexArrays(1, &glData->vao);
-		glBindVertexArray(glData->vao);
+	glGenVertexArrays(1, &glData->vao);
+	glBindVertexArray(glData->vao);
 
-		glGenBuffers(1, &glData->vbo);
-		glGenBuffers(1, &glData->ibo);
+	glGenBuffers(1, &glData->vbo);
+	glGenBuffers(1, &glData->ibo);
 
-		glBindBuffer(GL_ARRAY_BUFFER, glData->vbo);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, glData->ibo);
+	glBindBuffer(GL_ARRAY_BUFFER, glData->vbo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, glData->ibo);
 
-		glBufferData(GL_ARRAY_BUFFER, mesh->m_vertices.size() * sizeof(FBXVertex), mesh->m_vertices.data(), GL_STATIC_DRAW);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh->m_indices.size() * sizeof(unsigned int), mesh->m_indices.data(), GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, a_mesh->m_vertices.size() * sizeof(FBXVertex), a_mesh->m_vertices.data(), GL_STATIC_DRAW);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, a_mesh->m_indices.size() * sizeof(unsigned int), a_mesh->m_indices.data(), GL_STATIC_DRAW);
 
-		glEnableVertexAttribArray(0); // position
-		glEnableVertexAttribArray(1); // normal
-		glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(FBXVertex), (char*)FBXVertex::PositionOffset );
-		glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(FBXVertex), (char*)FBXVertex::NormalOffset );
+	glEnableVertexAttribArray(0); // position
+	glEnableVertexAttribArray(1); // normal
+	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(FBXVertex), (char*)FBXVertex::PositionOffset );
+	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(FBXVertex), (char*)FBXVertex::NormalOffset );
 
-		glBindVertexArray(0);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
-		mesh->m_userData = glData;
-	}
+	a_mesh->m_userData = glData;
 }
 
-void NavMesh::cleanupOpenGLBuffers(FBXFile* a_fbx)
+void NavMesh::cleanupOpenGLBuffers(FBXMeshNode* a_mesh)
 {
-	// bind our vertex array object and draw the mesh
-	for ( unsigned int i = 0 ; i < a_fbx->getMeshCount() ; ++i )
-	{
-		FBXMeshNode* mesh = a_fbx->getMeshByIndex(i);
-
-		GLData* glData = (GLData*)mesh->m_userData;
+	GLData* glData = (GLData*)a_mesh->m_userData;
 
-		glDeleteVertexArrays(1, &glData->vao);
-		glDeleteBuffers(1, &glData->vbo);
-		glDeleteBuffers(1, &glData->ibo);
+	glDeleteVertexArrays(1, &glData->vao);
+	glDeleteBuffers(1, &glData->vbo);
+	glDeleteBuffers(1, &glData->ibo);
 
-		delete[] glData;
-	}
+	delete glData;
 }
 
 void NavMesh::buildNavMesh(FBXMeshNode* a_mesh, std::vector<NavNodeTri*>& a_graph)
@@ -84,8 +84,11 @@ protected:
 							  std::unordered_map<NavNodeTri*, PathNode>& a_nodes);
 	void	smoothPath(std::vector<PathNode>& a_path);
 
-	void	createOpenGLBuffers(FBXFile* a_fbx);
-	void	cleanupOpenGLBuffers(FBXFile* a_fbx);
+	// finds a path between two random nodes that aren't neighbours, optionally printing the result
+	bool	findRandomPath(bool a_print);
+
+	void	createOpenGLBuffers(FBXMeshNode* a_mesh);
+	void	cleanupOpenGLBuffers(FBXMeshNode* a_mesh);
 
 	struct GLData
 	{
@@ -95,6 +98,10 @@ protected:
 	FBXFile*	m_sponza;
 	FBXFile*	m_navMesh;
 
+	// sponza streams in, its meshes are drawn as they arrive
+	FBXLoadHandle*				m_sponzaLoad;
+	std::vector<FBXMeshNode*>	m_sponzaMeshes;
+
 	unsigned int	m_shader;
 
 	glm::mat4	m_cameraMatrix;
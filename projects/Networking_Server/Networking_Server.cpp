@@ -11,6 +11,10 @@
 #define DEFAULT_SCREENWIDTH 1280
 #define DEFAULT_SCREENHEIGHT 720
 
+// server ticks per second, and how many players a headless benchmark simulates
+#define SERVER_TICK_RATE 30
+#define HEADLESS_PLAYERS 64
+
 Networking_Server::Networking_Server()
 {
 
@@ -23,23 +27,33 @@ Networking_Server::~Networking_Server()
 
 bool Networking_Server::onCreate(int a_argc, char* a_argv[]) 
 {
-	// initialise the Gizmos helper class
-	Gizmos::create();
+	// the server simulates at a fixed tick, however fast it draws
+	setFixedUpdateRate(SERVER_TICK_RATE);
 
-	// create a world-space matrix for a camera
-	m_cameraMatrix = glm::inverse( glm::lookAt(glm::vec3(10,10,10),glm::vec3(0,0,0), glm::vec3(0,1,0)) );
+	if (isHeadless() == false)
+	{
+		// initialise the Gizmos helper class
+		Gizmos::create();
 
-	// get window dimensions to calculate aspect ratio
-	int width = 0, height = 0;
-	glfwGetWindowSize(m_window, &width, &height);
+		// create a world-space matrix for a camera
+		m_cameraMatrix = glm::inverse( glm::lookAt(glm::vec3(10,10,10),glm::vec3(0,0,0), glm::vec3(0,1,0)) );
+
+		// get window dimensions to calculate aspect ratio
+		int width = 0, height = 0;
+		glfwGetWindowSize(m_window, &width, &height);
 
-	// create a perspective projection matrix with a 90 degree field-of-view and widescreen aspect ratio
-	m_projectionMatrix = glm::perspective(glm::pi<float>() * 0.25f, width / (float)height, 0.1f, 1000.0f);
+		// create a perspective projection matrix with a 90 degree field-of-view and widescreen aspect ratio
+		m_projectionMatrix = glm::perspective(glm::pi<float>() * 0.25f, width / (float)height, 0.1f, 1000.0f);
 
-	// set the clear colour and enable depth testing and backface culling
-	glClearColor(0.25f,0.25f,0.25f,1);
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_CULL_FACE);
+		// set the clear colour and enable depth testing and backface culling
+		glClearColor(0.25f,0.25f,0.25f,1);
+		glEnable(GL_DEPTH_TEST);
+		glEnable(GL_CULL_FACE);
+	}
+	else
+	{
+		addSimulatedPlayers(HEADLESS_PLAYERS);
+	}
 
 	m_pInterface = RakNet::RakPeerInterface::GetInstance();
 
@@ -52,23 +66,28 @@ bool Networking_Server::onCreate(int a_argc, char* a_argv[])
 
 void Networking_Server::onUpdate(float a_deltaTime) 
 {
-	// update our camera matrix using the keyboard/mouse
-	Utility::freeMovement( m_cameraMatrix, a_deltaTime, 10 );
-
-	// clear all gizmos from last frame
-	Gizmos::clear();
-	
-	// add an identity matrix gizmo
-	Gizmos::addTransform( glm::mat4(1,0,0,0,0,1,0,0,0,0,1,0,0,0,0,1) );
+	bool headless = isHeadless();
 
-	// add a 20x20 grid on the XZ-plane
-	for ( int i = 0 ; i < 21 ; ++i )
+	if (headless == false)
 	{
-		Gizmos::addLine( glm::vec3(-10 + i, 0, 10), glm::vec3(-10 + i, 0, -10), 
-						 i == 10 ? glm::vec4(1,1,1,1) : glm::vec4(0,0,0,1) );
+		// update our camera matrix using the keyboard/mouse
+		Utility::freeMovement( m_cameraMatrix, a_deltaTime, 10 );
+
+		// clear all gizmos from last frame
+		Gizmos::clear();
 		
-		Gizmos::addLine( glm::vec3(10, 0, -10 + i), glm::vec3(-10, 0, -10 + i), 
-						 i == 10 ? glm::vec4(1,1,1,1) : glm::vec4(0,0,0,1) );
+		// add an identity matrix gizmo
+		Gizmos::addTransform( glm::mat4(1,0,0,0,0,1,0,0,0,0,1,0,0,0,0,1) );
+
+		// add a 20x20 grid on the XZ-plane
+		for ( int i = 0 ; i < 21 ; ++i )
+		{
+			Gizmos::addLine( glm::vec3(-10 + i, 0, 10), glm::vec3(-10 + i, 0, -10), 
+							 i == 10 ? glm::vec4(1,1,1,1) : glm::vec4(0,0,0,1) );
+			
+			Gizmos::addLine( glm::vec3(10, 0, -10 + i), glm::vec3(-10, 0, -10 + i), 
+							 i == 10 ? glm::vec4(1,1,1,1) : glm::vec4(0,0,0,1) );
+		}
 	}
 
 	ProcessMessages();
@@ -77,6 +96,21 @@ void Networking_Server::onUpdate(float a_deltaTime)
 	RakNet::Time time = RakNet::GetTime();
 	for (auto player : m_players)
 	{
+		if (player == nullptr)
+			continue;
+
+		// simulated players step by the synthetic frame time, and bounce so they keep moving
+		if (headless)
+		{
+			player->position += player->velocity * a_deltaTime;
+			if (glm::abs(player->position.x) > 10)
+				player->velocity.x = -player->velocity.x;
+			if (glm::abs(player->position.y) > 10)
+				player->velocity.y = -player->velocity.y;
+			player->position = glm::clamp(player->position, glm::vec2(-10), glm::vec2(10));
+			continue;
+		}
+
 		float delta = (float)(time - player->timeStamp) / 1000;
 		player->position += player->velocity * delta;
 		player->position = glm::clamp(player->position, glm::vec2(-10), glm::vec2(10));
@@ -86,21 +120,35 @@ void Networking_Server::onUpdate(float a_deltaTime)
 	}
 
 	// if it's been long enough since the last update, send out the user list
-	if ((float)(time - m_lastUserListTimestamp) / 1000 >= UPDATE_INTERVAL)
+	m_userListTimer += a_deltaTime;
+	if (m_userListTimer >= UPDATE_INTERVAL)
 	{
 		UserList list(m_players);
 		RakNet::BitStream outputStream;
 		list.Encode(outputStream);
 		m_pInterface->Send(&outputStream, HIGH_PRIORITY, RELIABLE_ORDERED, 0, RakNet::UNASSIGNED_SYSTEM_ADDRESS, true);
 		printf("Updated user list broadcast.\n");
-		m_lastUserListTimestamp = time;
+		m_userListTimer = 0;
 	}
 
 	// quit our application when escape is pressed
-	if (glfwGetKey(m_window,GLFW_KEY_ESCAPE) == GLFW_PRESS)
+	if (headless == false &&
+		glfwGetKey(m_window,GLFW_KEY_ESCAPE) == GLFW_PRESS)
 		quit();
 }
 
+void Networking_Server::addSimulatedPlayers(unsigned int a_count)
+{
+	// the same players every run so that headless benchmarks are repeatable
+	srand(1);
+	for (unsigned int i = 0; i < a_count; ++i)
+	{
+		auto id = newId();
+		m_players[id]->position = glm::vec2(rand() % 21 - 10, rand() % 21 - 10);
+		m_players[id]->velocity = glm::vec2(rand() % 9 - 4, rand() % 9 - 4);
+	}
+}
+
 void Networking_Server::ProcessMessages()
 {
 	RakNet::Packet* pPacket = nullptr;
@@ -27,11 +27,14 @@ protected:
 
 	RakNet::uint24_t newId();
 
+	// adds simulated players for headless benchmarks, in place of connected clients
+	void	addSimulatedPlayers(unsigned int a_count);
+
 	glm::mat4	m_cameraMatrix;
 	glm::mat4	m_projectionMatrix;
 
 	RakNet::RakPeerInterface* m_pInterface;
 
 	std::vector<ServerUpdate*> m_players;
-	RakNet::Time m_lastUserListTimestamp = 0;
+	float m_userListTimer = 0;
 };
\ No newline at end of file
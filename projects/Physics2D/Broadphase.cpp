@@ -0,0 +1,401 @@
+#include "Broadphase.h"
+#include <algorithm>
+
+void Broadphase::Add(Actor* a_actor)
+{
+	if (nullptr == a_actor)
+		return;
+	if (IsUnbounded(a_actor))
+	{
+		m_unbounded.push_back(a_actor);
+	}
+	else
+	{
+		m_bounded.push_back(a_actor);
+		AddBounded(a_actor);
+	}
+}
+void Broadphase::Remove(Actor* a_actor)
+{
+	if (nullptr == a_actor)
+		return;
+	std::vector<Actor*>& list = IsUnbounded(a_actor) ? m_unbounded : m_bounded;
+	auto found = std::find(list.begin(), list.end(), a_actor);
+	if (list.end() == found)
+		return;
+	*found = list.back();
+	list.pop_back();
+	if (&list == &m_bounded)
+		RemoveBounded(a_actor);
+}
+void Broadphase::Clear()
+{
+	m_bounded.clear();
+	m_unbounded.clear();
+	ClearBounded();
+}
+
+void Broadphase::FindPairs(std::vector<Pair>& a_pairs)
+{
+	a_pairs.clear();
+	FindBoundedPairs(a_pairs);
+
+	// planes could be touching anything
+	for (unsigned int i = 0; i < m_unbounded.size(); ++i)
+	{
+		Actor* plane = m_unbounded[i];
+		for (auto actor : m_bounded)
+		{
+			if (CanCollide(plane, actor))
+				a_pairs.push_back(Pair(plane, actor));
+		}
+		for (unsigned int j = i + 1; j < m_unbounded.size(); ++j)
+		{
+			if (CanCollide(plane, m_unbounded[j]))
+				a_pairs.push_back(Pair(plane, m_unbounded[j]));
+		}
+	}
+}
+
+void Broadphase::Bounds(const Actor* a_actor, glm::vec3& a_min, glm::vec3& a_max)
+{
+	glm::vec3 extents = a_actor->GetGeometry().AxisAlignedExtents();
+	a_min = a_actor->GetPosition() - extents;
+	a_max = a_actor->GetPosition() + extents;
+}
+
+//
+// Sweep and prune
+//
+
+void SweepAndPrune::AddBounded(Actor* a_actor)
+{
+	// it's sorted into place with the rest on the next FindPairs()
+	Proxy proxy;
+	proxy.actor = a_actor;
+	Bounds(a_actor, proxy.min, proxy.max);
+	m_proxies.push_back(proxy);
+}
+void SweepAndPrune::RemoveBounded(Actor* a_actor)
+{
+	// erasing rather than swapping with the last keeps the rest in order
+	for (auto proxy = m_proxies.begin(); proxy != m_proxies.end(); ++proxy)
+	{
+		if (a_actor == proxy->actor)
+		{
+			m_proxies.erase(proxy);
+			return;
+		}
+	}
+}
+
+void SweepAndPrune::FindBoundedPairs(std::vector<Pair>& a_pairs)
+{
+	for (auto& proxy : m_proxies)
+		Bounds(proxy.actor, proxy.min, proxy.max);
+
+	// insertion sort, which is close to linear when little has moved since the last step
+	unsigned int axis = m_axis;
+	for (unsigned int i = 1; i < m_proxies.size(); ++i)
+	{
+		if (m_proxies[i - 1].min[axis] <= m_proxies[i].min[axis])
+			continue;
+		Proxy proxy = m_proxies[i];
+		unsigned int j = i;
+		for (; 0 < j && proxy.min[axis] < m_proxies[j - 1].min[axis]; --j)
+			m_proxies[j] = m_proxies[j - 1];
+		m_proxies[j] = proxy;
+	}
+
+	// each box can only overlap those after it that start before it ends
+	for (unsigned int i = 0; i < m_proxies.size(); ++i)
+	{
+		const Proxy& proxy1 = m_proxies[i];
+		for (unsigned int j = i + 1; j < m_proxies.size() && m_proxies[j].min[axis] <= proxy1.max[axis]; ++j)
+		{
+			const Proxy& proxy2 = m_proxies[j];
+			if (CanCollide(proxy1.actor, proxy2.actor) &&
+				Overlap(proxy1.min, proxy1.max, proxy2.min, proxy2.max))
+				a_pairs.push_back(Pair(proxy1.actor, proxy2.actor));
+		}
+	}
+}
+
+//
+// Dynamic AABB tree
+//
+
+// the cost of a node when inserting, proportional to the chance of a ray or box hitting it
+static float SurfaceArea(const glm::vec3& a_min, const glm::vec3& a_max)
+{
+	glm::vec3 size = a_max - a_min;
+	return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+void AABBTree::AddBounded(Actor* a_actor)
+{
+	int leaf = AllocateNode();
+	Node& node = m_nodes[leaf];
+	node.actor = a_actor;
+	node.height = 0;
+	Bounds(a_actor, node.min, node.max);
+	node.min -= glm::vec3(m_margin);
+	node.max += glm::vec3(m_margin);
+
+	m_leaves[a_actor] = leaf;
+	InsertLeaf(leaf);
+}
+void AABBTree::RemoveBounded(Actor* a_actor)
+{
+	auto found = m_leaves.find(a_actor);
+	if (m_leaves.end() == found)
+		return;
+	RemoveLeaf(found->second);
+	FreeNode(found->second);
+	m_leaves.erase(found);
+}
+void AABBTree::ClearBounded()
+{
+	m_nodes.clear();
+	m_leaves.clear();
+	m_root = NULL_NODE;
+	m_free = NULL_NODE;
+}
+
+void AABBTree::FindBoundedPairs(std::vector<Pair>& a_pairs)
+{
+	// move the leaves whose actors have left their fattened boxes
+	glm::vec3 min, max;
+	for (unsigned int i = 0; i < m_nodes.size(); ++i)
+	{
+		if (0 != m_nodes[i].height)
+			continue;
+		Bounds(m_nodes[i].actor, min, max);
+		if (glm::all(glm::greaterThanEqual(min, m_nodes[i].min)) &&
+			glm::all(glm::lessThanEqual(max, m_nodes[i].max)))
+			continue;
+
+		RemoveLeaf(i);
+		m_nodes[i].min = min - glm::vec3(m_margin);
+		m_nodes[i].max = max + glm::vec3(m_margin);
+		InsertLeaf(i);
+	}
+
+	// query the tree with each leaf, keeping each pair from the lower numbered leaf only
+	for (unsigned int i = 0; i < m_nodes.size(); ++i)
+	{
+		if (0 != m_nodes[i].height)
+			continue;
+		const Node& leaf = m_nodes[i];
+
+		m_stack.clear();
+		m_stack.push_back(m_root);
+		while (!m_stack.empty())
+		{
+			int index = m_stack.back();
+			m_stack.pop_back();
+			const Node& node = m_nodes[index];
+			if (!Overlap(leaf.min, leaf.max, node.min, node.max))
+				continue;
+
+			if (node.IsLeaf())
+			{
+				if ((int)i < index &&
+					CanCollide(leaf.actor, node.actor))
+					a_pairs.push_back(Pair(leaf.actor, node.actor));
+			}
+			else
+			{
+				m_stack.push_back(node.children[0]);
+				m_stack.push_back(node.children[1]);
+			}
+		}
+	}
+}
+
+int AABBTree::AllocateNode()
+{
+	int index;
+	if (NULL_NODE != m_free)
+	{
+		index = m_free;
+		m_free = m_nodes[index].parent;
+	}
+	else
+	{
+		index = (int)m_nodes.size();
+		m_nodes.push_back(Node());
+	}
+
+	Node& node = m_nodes[index];
+	node.parent = NULL_NODE;
+	node.children[0] = NULL_NODE;
+	node.children[1] = NULL_NODE;
+	node.height = 0;
+	node.actor = nullptr;
+	return index;
+}
+void AABBTree::FreeNode(int a_node)
+{
+	m_nodes[a_node].parent = m_free;
+	m_nodes[a_node].height = -1;
+	m_nodes[a_node].actor = nullptr;
+	m_free = a_node;
+}
+
+void AABBTree::InsertLeaf(int a_leaf)
+{
+	if (NULL_NODE == m_root)
+	{
+		m_root = a_leaf;
+		m_nodes[a_leaf].parent = NULL_NODE;
+		return;
+	}
+
+	// find the best sibling, descending while that's cheaper than pairing with the whole subtree
+	glm::vec3 leafMin = m_nodes[a_leaf].min;
+	glm::vec3 leafMax = m_nodes[a_leaf].max;
+	int sibling = m_root;
+	while (!m_nodes[sibling].IsLeaf())
+	{
+		const Node& node = m_nodes[sibling];
+		float area = SurfaceArea(node.min, node.max);
+		float combinedArea = SurfaceArea(glm::min(node.min, leafMin), glm::max(node.max, leafMax));
+
+		// pairing here makes a new parent, and every ancestor grows to hold the leaf either way
+		float cost = 2.0f * combinedArea;
+		float inheritedCost = 2.0f * (combinedArea - area);
+
+		float childCosts[2];
+		for (int i = 0; i < 2; ++i)
+		{
+			const Node& child = m_nodes[ node.children[i] ];
+			float childArea = SurfaceArea(glm::min(child.min, leafMin), glm::max(child.max, leafMax));
+			childCosts[i] = child.IsLeaf() ? childArea + inheritedCost
+										   : childArea - SurfaceArea(child.min, child.max) + inheritedCost;
+		}
+
+		if (cost < childCosts[0] && cost < childCosts[1])
+			break;
+		sibling = childCosts[0] < childCosts[1] ? node.children[0] : node.children[1];
+	}
+
+	// pair the leaf and sibling under a new parent
+	int oldParent = m_nodes[sibling].parent;
+	int newParent = AllocateNode();
+	Node& parent = m_nodes[newParent];
+	parent.parent = oldParent;
+	parent.min = glm::min(m_nodes[sibling].min, leafMin);
+	parent.max = glm::max(m_nodes[sibling].max, leafMax);
+	parent.height = m_nodes[sibling].height + 1;
+	parent.children[0] = sibling;
+	parent.children[1] = a_leaf;
+	m_nodes[sibling].parent = newParent;
+	m_nodes[a_leaf].parent = newParent;
+
+	if (NULL_NODE == oldParent)
+		m_root = newParent;
+	else if (sibling == m_nodes[oldParent].children[0])
+		m_nodes[oldParent].children[0] = newParent;
+	else
+		m_nodes[oldParent].children[1] = newParent;
+
+	Refit(oldParent);
+}
+
+void AABBTree::RemoveLeaf(int a_leaf)
+{
+	if (a_leaf == m_root)
+	{
+		m_root = NULL_NODE;
+		return;
+	}
+
+	// the sibling takes the parent's place
+	int parent = m_nodes[a_leaf].parent;
+	int grandParent = m_nodes[parent].parent;
+	int sibling = a_leaf == m_nodes[parent].children[0] ? m_nodes[parent].children[1] : m_nodes[parent].children[0];
+
+	m_nodes[sibling].parent = grandParent;
+	if (NULL_NODE == grandParent)
+		m_root = sibling;
+	else if (parent == m_nodes[grandParent].children[0])
+		m_nodes[grandParent].children[0] = sibling;
+	else
+		m_nodes[grandParent].children[1] = sibling;
+
+	FreeNode(parent);
+	m_nodes[a_leaf].parent = NULL_NODE;
+
+	Refit(grandParent);
+}
+
+// rebalances and refits each node from a_node up to the root
+void AABBTree::Refit(int a_node)
+{
+	while (NULL_NODE != a_node)
+	{
+		a_node = Balance(a_node);
+
+		Node& node = m_nodes[a_node];
+		const Node& child1 = m_nodes[ node.children[0] ];
+		const Node& child2 = m_nodes[ node.children[1] ];
+		node.min = glm::min(child1.min, child2.min);
+		node.max = glm::max(child1.max, child2.max);
+		node.height = 1 + std::max(child1.height, child2.height);
+
+		a_node = node.parent;
+	}
+}
+
+// if one child of a_node is more than one level taller than the other, rotates the taller child
+// up into a_node's place, returning the index of the node now in that place
+int AABBTree::Balance(int a_node)
+{
+	Node& a = m_nodes[a_node];
+	if (a.IsLeaf() || 2 > a.height)
+		return a_node;
+
+	int b = a.children[0];
+	int c = a.children[1];
+	int balance = m_nodes[c].height - m_nodes[b].height;
+	if (-1 <= balance && balance <= 1)
+		return a_node;
+
+	// rotate the taller child up, with a_node taking its shorter grandchild
+	int up = 0 < balance ? c : b;
+	int other = 0 < balance ? b : c;
+	Node& upNode = m_nodes[up];
+	int f = upNode.children[0];
+	int g = upNode.children[1];
+
+	upNode.children[0] = a_node;
+	upNode.parent = a.parent;
+	a.parent = up;
+	if (NULL_NODE == upNode.parent)
+		m_root = up;
+	else if (a_node == m_nodes[upNode.parent].children[0])
+		m_nodes[upNode.parent].children[0] = up;
+	else
+		m_nodes[upNode.parent].children[1] = up;
+
+	int taller = m_nodes[f].height > m_nodes[g].height ? f : g;
+	int shorter = taller == f ? g : f;
+	upNode.children[1] = taller;
+	a.children[0] = other;
+	a.children[1] = shorter;
+	m_nodes[shorter].parent = a_node;
+
+	const Node& otherNode = m_nodes[other];
+	const Node& shorterNode = m_nodes[shorter];
+	a.min = glm::min(otherNode.min, shorterNode.min);
+	a.max = glm::max(otherNode.max, shorterNode.max);
+	a.height = 1 + std::max(otherNode.height, shorterNode.height);
+
+	const Node& tallerNode = m_nodes[taller];
+	upNode.min = glm::min(a.min, tallerNode.min);
+	upNode.max = glm::max(a.max, tallerNode.max);
+	upNode.height = 1 + std::max(a.height, tallerNode.height);
+
+	return up;
+}
@@ -0,0 +1,128 @@
+#pragma once
+#include "Actor.h"
+#include <glm/glm.hpp>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Finds the pairs of actors whose bounding boxes overlap, so that only those need checking for
+// collisions. Planes have no finite bounds, so they're kept in a list of their own and paired with
+// every other actor. Pairs where neither actor is dynamic are never reported.
+class Broadphase
+{
+public:
+
+	typedef std::pair<Actor*, Actor*> Pair;
+
+	virtual ~Broadphase() {}
+
+	void Add(Actor* a_actor);
+	void Remove(Actor* a_actor);
+	void Clear();
+
+	// refreshes the bounds of every actor, then replaces the contents of a_pairs with the pairs
+	// that might be colliding
+	void FindPairs(std::vector<Pair>& a_pairs);
+
+	static bool IsUnbounded(const Actor* a_actor)
+	{
+		return Geometry::PLANE == a_actor->GetGeometry().GetShape();
+	}
+	static void Bounds(const Actor* a_actor, glm::vec3& a_min, glm::vec3& a_max);
+
+protected:
+
+	virtual void AddBounded(Actor* a_actor) = 0;
+	virtual void RemoveBounded(Actor* a_actor) = 0;
+	virtual void ClearBounded() = 0;
+	virtual void FindBoundedPairs(std::vector<Pair>& a_pairs) = 0;
+
+	static bool Overlap(const glm::vec3& a_min1, const glm::vec3& a_max1,
+						const glm::vec3& a_min2, const glm::vec3& a_max2)
+	{
+		return a_min1.x <= a_max2.x && a_min2.x <= a_max1.x &&
+			   a_min1.y <= a_max2.y && a_min2.y <= a_max1.y &&
+			   a_min1.z <= a_max2.z && a_min2.z <= a_max1.z;
+	}
+	static bool CanCollide(const Actor* a_actor1, const Actor* a_actor2)
+	{
+		return a_actor1->IsDynamic() || a_actor2->IsDynamic();
+	}
+
+	std::vector<Actor*> m_bounded;
+	std::vector<Actor*> m_unbounded;
+};
+
+// Keeps every actor's box sorted along one axis from step to step. Since bodies only move a little
+// each step, an insertion sort puts them back in order in close to linear time, and a sweep along
+// the sorted boxes only has to test those that overlap on that axis.
+// Best when bodies are spread out along the chosen axis.
+class SweepAndPrune : public Broadphase
+{
+public:
+
+	SweepAndPrune(unsigned int a_axis = 0) : m_axis(a_axis % 3) {}
+
+protected:
+
+	struct Proxy
+	{
+		Actor* actor;
+		glm::vec3 min;
+		glm::vec3 max;
+	};
+
+	virtual void AddBounded(Actor* a_actor);
+	virtual void RemoveBounded(Actor* a_actor);
+	virtual void ClearBounded() { m_proxies.clear(); }
+	virtual void FindBoundedPairs(std::vector<Pair>& a_pairs);
+
+	unsigned int m_axis;
+	std::vector<Proxy> m_proxies;	// sorted by min along m_axis as of the last FindPairs()
+};
+
+// A bounding volume hierarchy that's updated as bodies move rather than rebuilt. Each actor's box is
+// fattened by a margin so that it only has to be moved in the tree once it leaves it, and the tree
+// is kept balanced with rotations as leaves are inserted and removed.
+// Best for scenes spread in every direction, or where many bodies are asleep.
+class AABBTree : public Broadphase
+{
+public:
+
+	AABBTree(float a_margin = 0.1f) : m_margin(a_margin), m_root(NULL_NODE), m_free(NULL_NODE) {}
+
+protected:
+
+	static const int NULL_NODE = -1;
+
+	struct Node
+	{
+		glm::vec3 min;
+		glm::vec3 max;
+		int parent;		// or the next free node
+		int children[2];
+		int height;		// 0 for leaves, -1 for free nodes
+		Actor* actor;
+
+		bool IsLeaf() const { return NULL_NODE == children[0]; }
+	};
+
+	virtual void AddBounded(Actor* a_actor);
+	virtual void RemoveBounded(Actor* a_actor);
+	virtual void ClearBounded();
+	virtual void FindBoundedPairs(std::vector<Pair>& a_pairs);
+
+	int AllocateNode();
+	void FreeNode(int a_node);
+	void InsertLeaf(int a_leaf);
+	void RemoveLeaf(int a_leaf);
+	int Balance(int a_node);
+	void Refit(int a_node);
+
+	float m_margin;
+	std::vector<Node> m_nodes;
+	int m_root;
+	int m_free;
+	std::unordered_map<Actor*, int> m_leaves;
+	std::vector<int> m_stack;
+};
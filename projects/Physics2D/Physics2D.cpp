@@ -20,23 +20,27 @@ Physics2D::~Physics2D()
 
 bool Physics2D::onCreate(int a_argc, char* a_argv[]) 
 {
-	// initialise the Gizmos helper class
-	Gizmos::create();
-
 	// create a world-space matrix for a camera
 	m_cameraMatrix = glm::inverse( glm::lookAt(glm::vec3(20,20,20),glm::vec3(0,0,0), glm::vec3(0,1,0)) );
 
-	// get window dimensions to calculate aspect ratio
-	int width = 0, height = 0;
-	glfwGetWindowSize(m_window, &width, &height);
+	// no window or GL when running as a headless benchmark
+	if (isHeadless() == false)
+	{
+		// initialise the Gizmos helper class
+		Gizmos::create();
 
-	// create a perspective projection matrix with a 90 degree field-of-view and widescreen aspect ratio
-	m_projectionMatrix = glm::perspective(glm::pi<float>() * 0.25f, width / (float)height, 0.1f, 1000.0f);
+		// get window dimensions to calculate aspect ratio
+		int width = 0, height = 0;
+		glfwGetWindowSize(m_window, &width, &height);
+
+		// create a perspective projection matrix with a 90 degree field-of-view and widescreen aspect ratio
+		m_projectionMatrix = glm::perspective(glm::pi<float>() * 0.25f, width / (float)height, 0.1f, 1000.0f);
 
-	// set the clear colour and enable depth testing and backface culling
-	glClearColor(0.25f,0.25f,0.25f,1);
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_CULL_FACE);
+		// set the clear colour and enable depth testing and backface culling
+		glClearColor(0.25f,0.25f,0.25f,1);
+		glEnable(GL_DEPTH_TEST);
+		glEnable(GL_CULL_FACE);
+	}
 
 	m_scene = new Scene();
 
@@ -166,7 +170,15 @@ void Physics2D::onUpdate(float a_deltaTime)
 	}/**/
 	m_scene->Update();
 	m_scene->Render();
-	if (!m_cued)
+	if (!m_cued && isHeadless())
+	{
+		// take the same break shot every run so that headless benchmarks are repeatable
+		glm::vec3 cue = m_cueBall->GetPosition() + glm::vec3(0, 0, 10);
+		m_cueBall->ApplyImpulse((m_cueBall->GetPosition() - cue) * 2.0f * m_cueBall->GetMass(),
+								m_cueBall->GetGeometry().ClosestSurfacePointTo(cue));
+		m_cued = true;
+	}
+	else if (!m_cued)
 	{
 		GLFWwindow* window = glfwGetCurrentContext();
 		// get window dimensions to calculate aspect ratio
@@ -245,7 +257,7 @@ void Physics2D::onUpdate(float a_deltaTime)
 	}/**/
 
 	// quit our application when escape is pressed
-	if (glfwGetKey(m_window,GLFW_KEY_ESCAPE) == GLFW_PRESS)
+	if (!isHeadless() && glfwGetKey(m_window,GLFW_KEY_ESCAPE) == GLFW_PRESS)
 		quit();
 }
 
@@ -2,11 +2,12 @@
 
 void Scene::AddActor(Actor* a_actor)
 {
-	if (nullptr != a_actor)
-		m_actors.insert(a_actor);
+	if (nullptr != a_actor && m_actors.insert(a_actor).second)
+		m_broadphase->Add(a_actor);
 }
 void Scene::ClearActors()
 {
+	m_broadphase->Clear();
 	while (!m_actors.empty())
 	{
 		Actor* actor = *m_actors.begin();
@@ -20,9 +21,20 @@ bool Scene::DestroyActor(Actor* a_actor)	// returns false if actor not in scene
 	if (nullptr == a_actor || 0 == m_actors.count(a_actor))
 		return false;
 	m_actors.erase(a_actor);
+	m_broadphase->Remove(a_actor);
 	delete a_actor;
 	return true;
 }
+void Scene::SetBroadphase(Broadphase* a_broadphase)
+{
+	if (nullptr == a_broadphase || m_broadphase == a_broadphase)
+		return;
+	delete m_broadphase;
+	m_broadphase = a_broadphase;
+	m_broadphase->Clear();
+	for (auto actor : m_actors)
+		m_broadphase->Add(actor);
+}
 
 void Scene::Update()
 {
@@ -34,15 +46,10 @@ void Scene::Update()
 		for (auto actor : m_actors)
 			actor->Update(m_timeStep, m_gravity);
 
-		// collision resolution
-		std::set<Actor*> unchecked(m_actors);
-		while (1 < unchecked.size())
-		{
-			Actor* actor1 = *unchecked.begin();
-			unchecked.erase(actor1);
-			for (auto actor2 : unchecked)
-				Actor::ResolveCollision(actor1, actor2);
-		}
+		// collision resolution, only for the pairs whose bounds overlap
+		m_broadphase->FindPairs(m_pairs);
+		for (auto& pair : m_pairs)
+			Actor::ResolveCollision(pair.first, pair.second);
 	}
 }
 
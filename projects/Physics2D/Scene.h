@@ -1,7 +1,9 @@
 #pragma once
 #include "Actor.h"
+#include "Broadphase.h"
 #include "Utilities.h"
 #include <set>
+#include <vector>
 
 class Scene
 {
@@ -10,8 +12,8 @@ public:
 	Scene(const glm::vec3& a_gravity = glm::vec3(0.0f, -9.81f, 0.0f),
 		  float a_timeStep = 0.01f)
 		: m_gravity(a_gravity), m_timeStep(a_timeStep),
-		  m_lastUpdate(Utility::getTotalTime()) {}
-	~Scene() { ClearActors(); }
+		  m_lastUpdate(Utility::getTotalTime()), m_broadphase(new SweepAndPrune()) {}
+	~Scene() { ClearActors(); delete m_broadphase; }
 
 	void AddActor(Actor* a_actor);
 	void ClearActors();
@@ -19,6 +21,10 @@ public:
 	const std::set<Actor*>& GetActors() const { return m_actors; }
 	bool HasActor(Actor* a_actor) const { return nullptr != a_actor && 0 != m_actors.count(a_actor); }
 
+	// the scene takes ownership of the broadphase, moving its actors into it
+	void SetBroadphase(Broadphase* a_broadphase);
+	const Broadphase& GetBroadphase() const { return *m_broadphase; }
+
 	void Update();
 	void Render() const;
 
@@ -31,4 +37,13 @@ protected:
 
 	std::set<Actor*> m_actors;
 
-};
+	Broadphase* m_broadphase;
+	std::vector<Broadphase::Pair> m_pairs;
+
+private:
+
+	// disallow copying, the scene owns its actors and broadphase
+	Scene(const Scene&);
+	Scene& operator=(const Scene&);
+
+};
\ No newline at end of file
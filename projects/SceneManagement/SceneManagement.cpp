@@ -39,11 +39,22 @@ bool SceneManagement::onCreate(int a_argc, char* a_argv[])
 	glEnable(GL_DEPTH_TEST);
 	glEnable(GL_CULL_FACE);
 
-	// load shaders and link shader program
-	m_vertShader = Utility::loadShader("shaders/lit.vert", GL_VERTEX_SHADER);
-	m_fragShader = Utility::loadShader("shaders/lit.frag", GL_FRAGMENT_SHADER);
+	// load shaders and link shader program, rebuilding it whenever the shader files change
 	const char* inputs[] = { "Position", "Normal" };
-	m_shader = Utility::createProgram(m_vertShader, 0, 0, 0, m_fragShader, 2, inputs);
+	ProgramDesc program = { "shaders/lit.vert", nullptr, nullptr, nullptr, "shaders/lit.frag", 2, inputs, 0, nullptr, 0 };
+	m_shader.load(program, true);
+
+	// hash the light uniform names once rather than building strings every frame
+	const char* lightMembers[LIGHT_UNIFORMS] = { "color", "direction", "position", "power", "attenuation", "angle", "blur" };
+	char buffer[50];
+	for (int i = 0; i < MAX_LIGHTS; ++i)
+	{
+		for (int j = 0; j < LIGHT_UNIFORMS; ++j)
+		{
+			std::sprintf(buffer, "lights[%d].%s", i, lightMembers[j]);
+			m_lightUniforms[i][j] = ShaderProgram::hashName(buffer);
+		}
+	}
 
 	m_lightAmbient = glm::vec3(0.0625, 0, 0.125);
 
@@ -117,48 +128,33 @@ void SceneManagement::onDraw()
 	getFrustrumPlanes(m_projectionMatrix, planes);
 
 	// bind shader to the GPU
-	glUseProgram(m_shader);
+	m_shader.bind();
 
 	// fetch locations of the view and projection matrices and bind them
-	unsigned int location = glGetUniformLocation(m_shader, "view");
+	int location = m_shader.getUniform("view");
 	glUniformMatrix4fv(location, 1, false, glm::value_ptr(viewMatrix));
 
-	location = glGetUniformLocation(m_shader, "projection");
+	location = m_shader.getUniform("projection");
 	glUniformMatrix4fv(location, 1, false, glm::value_ptr(m_projectionMatrix));
 
 	// light attributes
-	location = glGetUniformLocation(m_shader, "lightAmbient");
+	location = m_shader.getUniform("lightAmbient");
 	glUniform3fv(location, 1, &m_lightAmbient[0]);
-	char buffer[50];
 	for (int i = 0; i < m_lightCount; ++i)
 	{
-		std::sprintf(buffer, "lights[%d].color", i);
-		location = glGetUniformLocation(m_shader, buffer);
-		glUniform3fv(location, 1, &(m_lights[i].color[0]));
-		std::sprintf(buffer, "lights[%d].direction", i);
-		location = glGetUniformLocation(m_shader, buffer);
-		glUniform3fv(location, 1, &(m_lights[i].direction[0]));
-		std::sprintf(buffer, "lights[%d].position", i);
-		location = glGetUniformLocation(m_shader, buffer);
-		glUniform3fv(location, 1, &(m_lights[i].position[0]));
-		std::sprintf(buffer, "lights[%d].power", i);
-		location = glGetUniformLocation(m_shader, buffer);
-		glUniform1f(location, m_lights[i].power);
-		std::sprintf(buffer, "lights[%d].attenuation", i);
-		location = glGetUniformLocation(m_shader, buffer);
-		glUniform1f(location, m_lights[i].attenuation);
-		std::sprintf(buffer, "lights[%d].angle", i);
-		location = glGetUniformLocation(m_shader, buffer);
-		glUniform1f(location, m_lights[i].angle);
-		std::sprintf(buffer, "lights[%d].blur", i);
-		location = glGetUniformLocation(m_shader, buffer);
-		glUniform1f(location, m_lights[i].blur);
+		glUniform3fv(m_shader.getUniform(m_lightUniforms[i][0]), 1, &(m_lights[i].color[0]));
+		glUniform3fv(m_shader.getUniform(m_lightUniforms[i][1]), 1, &(m_lights[i].direction[0]));
+		glUniform3fv(m_shader.getUniform(m_lightUniforms[i][2]), 1, &(m_lights[i].position[0]));
+		glUniform1f(m_shader.getUniform(m_lightUniforms[i][3]), m_lights[i].power);
+		glUniform1f(m_shader.getUniform(m_lightUniforms[i][4]), m_lights[i].attenuation);
+		glUniform1f(m_shader.getUniform(m_lightUniforms[i][5]), m_lights[i].angle);
+		glUniform1f(m_shader.getUniform(m_lightUniforms[i][6]), m_lights[i].blur);
 	}
-	location = glGetUniformLocation(m_shader, "lightCount");
+	location = m_shader.getUniform("lightCount");
 	glUniform1i(location, m_lightCount);
 
 	// send camera position
-	location = glGetUniformLocation(m_shader, "cameraPosition");
+	location = m_shader.getUniform("cameraPosition");
 	glUniform3fv(location, 1, glm::value_ptr(m_cameraMatrix[3]));
 
 	// bind our vertex array object and draw the mesh
@@ -192,15 +188,15 @@ void SceneManagement::onDraw()
 					//printf("visible\n");
 
 					FBXMaterial* material = mesh->m_material;
-					location = glGetUniformLocation(m_shader, "hasMaterial");
+					location = m_shader.getUniform("hasMaterial");
 					glUniform1i(location, nullptr != material ? GL_TRUE : GL_FALSE);
 					if (nullptr != material)
 					{
-						location = glGetUniformLocation(m_shader, "materialAmbient");
+						location = m_shader.getUniform("materialAmbient");
 						glUniform4fv(location, 1, &(material->ambient[0]));
-						location = glGetUniformLocation(m_shader, "materialDiffuse");
+						location = m_shader.getUniform("materialDiffuse");
 						glUniform4fv(location, 1, &(material->diffuse[0]));
-						location = glGetUniformLocation(m_shader, "materialSpecular");
+						location = m_shader.getUniform("materialSpecular");
 						glUniform4fv(location, 1, &(material->specular[0]));
 					}
 
@@ -226,6 +222,7 @@ void SceneManagement::onDestroy()
 	Gizmos::destroy();
 
 	cleanupOpenGLBuffers(m_fbx);
+	m_shader.unload();
 	m_lightCount = 0;
 }
 
@@ -2,6 +2,7 @@
 
 #include "Application.h"
 #include "FBXFile.h"
+#include "ShaderProgram.h"
 #include <glm/glm.hpp>
 
 // struct describing a light source
@@ -59,9 +60,7 @@ protected:
 	glm::mat4	m_cameraMatrix;
 	glm::mat4	m_projectionMatrix;
 
-	unsigned int m_vertShader;
-	unsigned int m_fragShader;
-	unsigned int m_shader;
+	ShaderProgram m_shader;
 
 	glm::vec3	m_lightAmbient;
 
@@ -69,5 +68,9 @@ protected:
 	Light m_lights[MAX_LIGHTS];
 	int m_lightCount = 0;
 
+	// hashed names of each light's uniforms, in the order of the Light members
+	static const int LIGHT_UNIFORMS = 7;
+	unsigned int m_lightUniforms[MAX_LIGHTS][LIGHT_UNIFORMS];
+
 	FBXFile* m_fbx;
 };
\ No newline at end of file
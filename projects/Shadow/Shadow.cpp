@@ -38,30 +38,24 @@ bool Shadow::onCreate(int a_argc, char* a_argv[])
 	glEnable(GL_DEPTH_TEST);
 	//glEnable(GL_CULL_FACE);
 
-	// load shaders and link shader programs
-	unsigned int vs = Utility::loadShader("shaders/shadow.vert", GL_VERTEX_SHADER);
-	unsigned int fs = Utility::loadShader("shaders/shadow.frag", GL_FRAGMENT_SHADER);
+	// load shaders and link shader programs, all three are compiled together
+	// and linked binaries are cached in shaders/cache
 	const char* inputs1[] = { "Position" };
 	const char* outputs1[] = { "depth" };
-	m_shadowShader = Utility::createProgram(vs, 0, 0, 0, fs, 1, inputs1, 1, outputs1);
-	glDeleteShader(vs);
-	glDeleteShader(fs);
-
-	vs = Utility::loadShader("shaders/displayMap.vert", GL_VERTEX_SHADER);
-	fs = Utility::loadShader("shaders/displayMap.frag", GL_FRAGMENT_SHADER);
 	const char* inputs2[] = { "Position", "TexCoord" };
 	const char* outputs2[] = { "FragColor" };
-	m_2dprogram = Utility::createProgram(vs, 0, 0, 0, fs, 2, inputs2, 1, outputs2);
-	glDeleteShader(vs);
-	glDeleteShader(fs);
-
-	vs = Utility::loadShader("shaders/scene.vert", GL_VERTEX_SHADER);
-	fs = Utility::loadShader("shaders/scene.frag", GL_FRAGMENT_SHADER);
 	const char* inputs3[] = { "Position", "Normals", "TexCoord" };
 	const char* outputs3[] = { "FragColor" };
-	m_program = Utility::createProgram(vs, 0, 0, 0, fs, 3, inputs3, 1, outputs3);
-	glDeleteShader(vs);
-	glDeleteShader(fs);
+
+	ProgramDesc programs[3] = {
+		{ "shaders/shadow.vert", nullptr, nullptr, nullptr, "shaders/shadow.frag", 1, inputs1, 1, outputs1, 0 },
+		{ "shaders/displayMap.vert", nullptr, nullptr, nullptr, "shaders/displayMap.frag", 2, inputs2, 1, outputs2, 0 },
+		{ "shaders/scene.vert", nullptr, nullptr, nullptr, "shaders/scene.frag", 3, inputs3, 1, outputs3, 0 },
+	};
+	Utility::buildPrograms(3, programs, "shaders/cache");
+	m_shadowShader = programs[0].handle;
+	m_2dprogram = programs[1].handle;
+	m_program = programs[2].handle;
 
 	createShadowBuffer();
 	setUpLightAndShadowMatrix(1.0);
@@ -129,9 +123,9 @@ void Shadow::onDestroy()
 	// clean up anything we created
 	Gizmos::destroy();
 
-	glDeleteShader(m_2dprogram);
-	glDeleteShader(m_shadowShader);
-	glDeleteShader(m_program);
+	glDeleteProgram(m_2dprogram);
+	glDeleteProgram(m_shadowShader);
+	glDeleteProgram(m_program);
 
 	DestroyFBXSceneResource(m_fbx);
 	m_fbx->unload();
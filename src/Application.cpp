@@ -1,13 +1,41 @@
 #include "Application.h"
+#include "GLState.h"
 #include "Utilities.h"
+#include "Profiler.h"
+#include "ShaderProgram.h"
 #include <string>
 #include <vector>
 #include <sstream>
+#include <thread>
+#include <chrono>
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <algorithm>
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
 bool Application::create(const char* a_name, int a_width, int a_height, int a_argc, char* a_argv[])
 {
+	// check for headless benchmark arguments
+	for (int i = 1; i < a_argc; ++i)
+	{
+		if (strcmp(a_argv[i], "--headless") == 0)
+			m_headless = true;
+		else if (strncmp(a_argv[i], "--frames=", 9) == 0)
+			m_headlessFrames = (unsigned int)atoi(a_argv[i] + 9);
+		else if (strncmp(a_argv[i], "--delta=", 8) == 0)
+			m_headlessDeltaTime = (float)atof(a_argv[i] + 8);
+	}
+
+	// no window, GL context or input when headless
+	if (m_headless == true)
+	{
+		m_window = nullptr;
+		return onCreate(a_argc,a_argv);
+	}
+
 	// initialise glfw systems
 	if (glfwInit() != GL_TRUE)
 		return false;
@@ -51,27 +79,167 @@ bool Application::create(const char* a_name, int a_width, int a_height, int a_ar
 	{
 		glfwTerminate();
 	}
+
+	// onCreate() sets up state with direct GL calls
+	GLState::invalidate();
 	return result;
 }
 
+void Application::setFixedUpdateRate(float a_stepsPerSecond, unsigned int a_maxSteps /* = 5 */)
+{
+	m_fixedTimeStep = a_stepsPerSecond > 0 ? 1.0f / a_stepsPerSecond : 0;
+	m_maxUpdateSteps = a_maxSteps > 0 ? a_maxSteps : 1;
+}
+
+void Application::setFrameRateCap(float a_framesPerSecond)
+{
+	m_frameTime = a_framesPerSecond > 0 ? 1.0f / a_framesPerSecond : 0;
+}
+
+void Application::setHeadless(unsigned int a_frameCount /* = 1000 */, float a_deltaTime /* = 1 / 60.0f */)
+{
+	m_headless = true;
+	m_headlessFrames = a_frameCount;
+	m_headlessDeltaTime = a_deltaTime;
+}
+
 void Application::run()
 {
+	if (m_headless == true)
+	{
+		runHeadless();
+		return;
+	}
+
 	Utility::resetTimer();
 	m_running = true;
+
+	// time not yet consumed by fixed updates
+	float accumulator = 0;
+
 	do
 	{
+		Profiler::beginFrame();
+
+		double frameStart = glfwGetTime();
 		float deltaTime = Utility::tickTimer();
 
-		onUpdate( deltaTime );
+		// swap in any shader programs that have been rebuilt after their files changed
+		ShaderProgram::updateHotReload();
+
+		// how far the frame is between fixed updates, always 1 for variable-step updates
+		float alpha = 1.0f;
+
+		if (m_fixedTimeStep > 0)
+		{
+			accumulator += deltaTime;
+
+			unsigned int steps = 0;
+			while (accumulator >= m_fixedTimeStep &&
+				steps < m_maxUpdateSteps &&
+				m_running == true)
+			{
+				PROFILE_SCOPE("onUpdate");
+				onUpdate( m_fixedTimeStep );
+				accumulator -= m_fixedTimeStep;
+				++steps;
+			}
+
+			// drop whatever we couldn't catch up on rather than spiralling
+			if (accumulator >= m_fixedTimeStep)
+				accumulator = fmodf(accumulator, m_fixedTimeStep);
 
-		onDraw();
+			alpha = accumulator / m_fixedTimeStep;
+		}
+		else
+		{
+			PROFILE_SCOPE("onUpdate");
+			onUpdate( deltaTime );
+		}
 
-		glfwSwapBuffers(m_window);
-		glfwPollEvents();
+		// projects change state with direct GL calls as well as through GLState,
+		// so start each frame's drawing with an empty cache
+		GLState::invalidate();
+
+		{
+			PROFILE_SCOPE("onDraw");
+			PROFILE_GPU_SCOPE("onDraw");
+			onDrawInterpolated( alpha );
+		}
+
+		{
+			PROFILE_SCOPE("swapBuffers");
+			glfwSwapBuffers(m_window);
+			glfwPollEvents();
+		}
+
+		// sleep away the rest of the frame if capped
+		if (m_frameTime > 0)
+		{
+			double remaining = m_frameTime - (glfwGetTime() - frameStart);
+			if (remaining > 0)
+				std::this_thread::sleep_for( std::chrono::microseconds( (long long)(remaining * 1000000.0) ) );
+		}
+
+		Profiler::endFrame();
 
 	} while (m_running == true && glfwWindowShouldClose(m_window) == 0);
 
 	onDestroy();
 
 	glfwTerminate();
+}
+
+void Application::runHeadless()
+{
+	std::vector<double> frameTimes;
+	frameTimes.reserve(m_headlessFrames);
+
+	m_running = true;
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	for (unsigned int frame = 0; frame < m_headlessFrames && m_running == true; ++frame)
+	{
+		auto frameStart = std::chrono::high_resolution_clock::now();
+
+		Profiler::beginFrame();
+
+		// synthetic time so that runs are deterministic
+		Utility::stepTimer( m_headlessDeltaTime );
+
+		{
+			PROFILE_SCOPE("onUpdate");
+			onUpdate( m_headlessDeltaTime );
+		}
+
+		Profiler::endFrame();
+
+		frameTimes.push_back( std::chrono::duration<double,std::milli>(std::chrono::high_resolution_clock::now() - frameStart).count() );
+	}
+
+	double totalTime = std::chrono::duration<double,std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	onDestroy();
+
+	// report frame timing statistics (in milliseconds)
+	if (frameTimes.empty() == false)
+	{
+		double sum = 0, sumSquared = 0;
+		for (auto t : frameTimes)
+		{
+			sum += t;
+			sumSquared += t * t;
+		}
+		double mean = sum / frameTimes.size();
+		double variance = sumSquared / frameTimes.size() - mean * mean;
+
+		std::sort(frameTimes.begin(), frameTimes.end());
+		auto percentile = [&frameTimes](double p) { return frameTimes[ (size_t)(p * (frameTimes.size() - 1) + 0.5) ]; };
+
+		printf("Headless run: %u frames, %.3fms total\n", (unsigned int)frameTimes.size(), totalTime);
+		printf("  mean %.4fms, stddev %.4fms\n", mean, sqrt(variance > 0 ? variance : 0));
+		printf("  min %.4fms, median %.4fms, p95 %.4fms, p99 %.4fms, max %.4fms\n",
+			frameTimes.front(), percentile(0.5), percentile(0.95), percentile(0.99), frameTimes.back());
+	}
 }
\ No newline at end of file
@@ -1,7 +1,12 @@
 #include "FBXFile.h"
+#include "FileView.h"
+#include "TaskGraph.h"
+#if !defined(FBXFILE_NO_SDK)
 #include <fbxsdk.h>
+#endif
 #include <algorithm>
 #include <set>
+#include <deque>
 
 // only needed for texture cleanup
 #define GLEW_NO_GLU
@@ -15,11 +20,20 @@
 #include <glm/gtx/transform.hpp>
 #include <glm/gtx/norm.hpp>
 
+#if !defined(FBXFILE_NO_SDK)
+
 struct ImportAssistor
 {
-	ImportAssistor() : evaluator(nullptr), loadAnimationOnly(false) {}
+	ImportAssistor() : evaluator(nullptr), loadAnimationOnly(false), tasks(nullptr) {}
 	~ImportAssistor() { evaluator = nullptr; }
 
+	// the meshes extracted from a mesh node, which are linked into the scene once every job is done
+	struct MeshExtraction
+	{
+		FBXNode*					node;
+		std::vector<FBXMeshNode*>	meshes;
+	};
+
 	FbxScene*				scene;
 	FbxAnimEvaluator*		evaluator;
 	FbxImporter*			importer;
@@ -32,10 +46,114 @@ struct ImportAssistor
 	bool					flipTextureY;
 
 	std::map<std::string,int> boneIndexList;
+
+	// paths of the textures any material uses as a normal map, found before textures start decoding
+	std::set<std::string>	normalMaps;
+
+	// mesh extraction, welding, tangent generation and texture decoding run as tasks
+	TaskGraph*					tasks;
+	std::deque<MeshExtraction>	meshExtractions;
+};
+
+// feeds the importer from a memory-mapped view of the file rather than letting the SDK read it
+class FileViewStream : public FbxStream
+{
+public:
+
+	FileViewStream(FbxManager* a_manager, const char* a_filename)
+		: m_file(a_filename), m_readerID(-1), m_position(0), m_state(eClosed)
+	{
+		if (m_file.isOpen())
+			a_manager->GetIOPluginRegistry()->DetectReaderFileFormat(a_filename, m_readerID);
+	}
+
+	bool			isValid() const		{ return m_file.isOpen() && m_readerID >= 0;	}
+
+	virtual EState	GetState()			{ return m_state;	}
+	virtual bool	Open(void*)			{ m_state = eOpen; m_position = 0; return true;	}
+	virtual bool	Close()				{ m_state = eClosed; return true;	}
+	virtual bool	Flush()				{ return true;	}
+	virtual int		Write(const void*, int)	{ return 0;	}
+
+	virtual int		Read(void* a_data, int a_size) const
+	{
+		size_t count = m_file.size() - m_position;
+		if (a_size < 0)
+			count = 0;
+		else if ((size_t)a_size < count)
+			count = (size_t)a_size;
+		memcpy(a_data, m_file.data() + m_position, count);
+		m_position += count;
+		return (int)count;
+	}
+
+	virtual char*	ReadString(char* a_buffer, int a_maxSize, bool a_stopAtFirstWhiteSpace = false)
+	{
+		if (m_position >= m_file.size() ||
+			a_maxSize <= 0)
+			return nullptr;
+
+		// like fgets, keeps the terminating newline
+		int length = 0;
+		while (length < a_maxSize - 1 &&
+			   m_position < m_file.size())
+		{
+			char c = (char)m_file.data()[m_position++];
+			a_buffer[length++] = c;
+			if (c == '\n' ||
+				(a_stopAtFirstWhiteSpace && (c == ' ' || c == '\t' || c == '\r')))
+				break;
+		}
+		a_buffer[length] = 0;
+		return a_buffer;
+	}
+
+	virtual int		GetReaderID() const	{ return m_readerID;	}
+	virtual int		GetWriterID() const	{ return -1;	}
+
+	virtual void	Seek(const FbxInt64& a_offset, const FbxFile::ESeekPos& a_seekPos)
+	{
+		FbxInt64 position = a_offset;
+		if (a_seekPos == FbxFile::eCurrent)
+			position += m_position;
+		else if (a_seekPos == FbxFile::eEnd)
+			position += m_file.size();
+		if (position < 0)
+			position = 0;
+		else if (position > (FbxInt64)m_file.size())
+			position = (FbxInt64)m_file.size();
+		m_position = (size_t)position;
+	}
+
+	virtual long	GetPosition() const	{ return (long)m_position;	}
+	virtual void	SetPosition(long a_position)	{ Seek(a_position, FbxFile::eBegin);	}
+	virtual int		GetError() const	{ return 0;	}
+	virtual void	ClearError()		{}
+
+private:
+
+	FileView		m_file;
+	int				m_readerID;
+	mutable size_t	m_position;
+	EState			m_state;
 };
 
+#endif
+
 void FBXFile::unload()
 {
+	// an asynchronous load has to finish before its scene can be freed
+	if (m_loadHandle != nullptr)
+	{
+		if (m_loadHandle->m_thread != nullptr)
+		{
+			m_loadHandle->m_thread->join();
+			delete m_loadHandle->m_thread;
+		}
+		delete m_loadHandle;
+		m_loadHandle = nullptr;
+	}
+
 	delete m_root;
 	m_root = nullptr;
 
@@ -45,6 +163,8 @@ void FBXFile::unload()
 		delete s;
 	for (auto a : m_animations)
 		delete a.second;
+	for (auto a : m_compressedAnimations)
+		delete a.second;
 	for (auto t : m_textures)
 		delete t.second;
 
@@ -54,9 +174,26 @@ void FBXFile::unload()
 	m_materials.clear();
 	m_skeletons.clear();
 	m_animations.clear();
+	m_compressedAnimations.clear();
 	m_textures.clear();
 }
 
+#if !defined(FBXFILE_NO_SDK)
+
+// the file name of a texture, without the folder it was exported from
+static const char* textureFilename(FbxFileTexture* a_texture)
+{
+	const char* szLastForward = strrchr(a_texture->GetFileName(),'/');
+	const char* szLastBackward = strrchr(a_texture->GetFileName(),'\\');
+	const char* szFilename = a_texture->GetFileName();
+
+	if (szLastForward != nullptr && szLastForward > szLastBackward)
+		szFilename = szLastForward + 1;
+	else if (szLastBackward != nullptr)
+		szFilename = szLastBackward + 1;
+	return szFilename;
+}
+
 bool FBXFile::load(const char* a_filename, UNIT_SCALE a_scale /* = FBXFile::UNITS_METER */, 
 	bool a_loadTextures /* = true */, bool a_loadAnimations /* = true */, bool a_flipTextureY /*= true*/)
 {
@@ -85,8 +222,11 @@ bool FBXFile::load(const char* a_filename, UNIT_SCALE a_scale /* = FBXFile::UNIT
 	// Create an importer.
 	FbxImporter* lImporter = FbxImporter::Create(lSdkManager,"");
 
-	// Initialize the importer by providing a filename.
-	bool lImportStatus = lImporter->Initialize(a_filename, -1, lSdkManager->GetIOSettings());
+	// Initialize the importer with a stream over the mapped file, or by filename if the format wasn't recognised.
+	FileViewStream lStream(lSdkManager, a_filename);
+	bool lImportStatus = lStream.isValid() ?
+		lImporter->Initialize(&lStream, nullptr, lStream.GetReaderID(), lSdkManager->GetIOSettings()) :
+		lImporter->Initialize(a_filename, -1, lSdkManager->GetIOSettings());
 
 	if ( !lImportStatus )
 	{
@@ -180,6 +320,9 @@ bool FBXFile::load(const char* a_filename, UNIT_SCALE a_scale /* = FBXFile::UNIT
 		m_importAssistor->unitScale = unitScale;
 		m_importAssistor->flipTextureY = a_flipTextureY;
 
+		TaskGraph tasks;
+		m_importAssistor->tasks = &tasks;
+
 		m_root = new FBXNode();
 		m_root->m_name = "root";
 		m_root->m_globalTransform = m_root->m_localTransform = glm::mat4(1,0,0,0,0,1,0,0,0,0,1,0,0,0,0,1);
@@ -199,55 +342,89 @@ bool FBXFile::load(const char* a_filename, UNIT_SCALE a_scale /* = FBXFile::UNIT
 			}
 		}
 
-		// extract scene (meshes, lights, cameras)
+		// normal maps are filtered and compressed differently, and a texture starts decoding as soon
+		// as the first material using it is found, so find every normal map before any of that
+		if (a_loadTextures == true)
+		{
+			const char* normalChannel = FbxLayerElement::sTextureChannelNames[ FbxLayerElement::eTextureNormalMap - FbxLayerElement::sTypeTextureStartIndex ];
+			for (int j = 0; j < lScene->GetMaterialCount(); ++j)
+			{
+				FbxProperty pProperty = lScene->GetMaterial(j)->FindProperty(normalChannel);
+				if (pProperty.IsValid() &&
+					pProperty.GetSrcObjectCount<FbxTexture>() > 0)
+				{
+					FbxFileTexture* fileTexture = FbxCast<FbxFileTexture>(pProperty.GetSrcObject<FbxTexture>(0));
+					if (fileTexture != nullptr)
+						m_importAssistor->normalMaps.insert(m_path + textureFilename(fileTexture));
+				}
+			}
+		}
+
+		// extract scene (meshes, lights, cameras), with meshes handed off to tasks as they're found
 		for (i = 0; i < (unsigned int)lNode->GetChildCount(); ++i)
 		{
 			extractObject(m_root, (void*)lNode->GetChild(i));
 		}
 
-		// ensure all threads are finished
-		for (auto t : m_threads)
-			t->join();
-		m_threads.clear();
+		// every node's transform is known now, so asynchronous loads can start handing over meshes
+		if (m_loadHandle != nullptr)
+			m_loadHandle->m_hierarchyReady = true;
 
 		// build skeleton and extract animation keyframes
+		// only the bones are needed, and they were all gathered above, so this runs alongside the meshes
 		if (a_loadAnimations == true &&
 			m_importAssistor->bones.size() > 0)
 		{
-			FBXSkeleton* skeleton = new FBXSkeleton();
-			skeleton->m_boneCount = (unsigned int)m_importAssistor->bones.size();
-			skeleton->m_nodes = new FBXNode * [ skeleton->m_boneCount ];
-			skeleton->m_bones = new glm::mat4[ skeleton->m_boneCount ];
-			skeleton->m_bindPoses = new glm::mat4[ skeleton->m_boneCount ];
+			tasks.add([this, lScene]{
+				FBXSkeleton* skeleton = new FBXSkeleton();
+				skeleton->m_boneCount = (unsigned int)m_importAssistor->bones.size();
+				skeleton->m_nodes = new FBXNode * [ skeleton->m_boneCount ];
+				skeleton->m_bones = new glm::mat4[ skeleton->m_boneCount ];
+				skeleton->m_bindPoses = new glm::mat4[ skeleton->m_boneCount ];
 
-			skeleton->m_parentIndex = new int[ skeleton->m_boneCount ];
+				skeleton->m_parentIndex = new int[ skeleton->m_boneCount ];
 
-			for ( i = 0 ; i < skeleton->m_boneCount ; ++i )
-			{
-				skeleton->m_nodes[ i ] = m_importAssistor->bones[ i ];
-				skeleton->m_bones[ i ] = skeleton->m_nodes[ i ]->m_localTransform;
-			}
-			for ( i = 0 ; i < skeleton->m_boneCount ; ++i )
-			{
-				skeleton->m_parentIndex[i] = -1;
-				for ( int j = 0 ; j < (int)skeleton->m_boneCount ; ++j )
+				for ( unsigned int i = 0 ; i < skeleton->m_boneCount ; ++i )
 				{
-					if (skeleton->m_nodes[i]->m_parent == skeleton->m_nodes[j])
+					skeleton->m_nodes[ i ] = m_importAssistor->bones[ i ];
+					skeleton->m_bones[ i ] = skeleton->m_nodes[ i ]->m_localTransform;
+				}
+				for ( unsigned int i = 0 ; i < skeleton->m_boneCount ; ++i )
+				{
+					skeleton->m_parentIndex[i] = -1;
+					for ( int j = 0 ; j < (int)skeleton->m_boneCount ; ++j )
 					{
-						skeleton->m_parentIndex[i] = j;
-						break;
+						if (skeleton->m_nodes[i]->m_parent == skeleton->m_nodes[j])
+						{
+							skeleton->m_parentIndex[i] = j;
+							break;
+						}
 					}
 				}
-			}
 
-			extractSkeleton(skeleton, lScene);
+				extractSkeleton(skeleton, lScene);
 
-			m_skeletons.push_back(skeleton);
+				m_skeletons.push_back(skeleton);
 
-			extractAnimation(lScene);
+				extractAnimation(lScene);
+			});
 		}
 
-		m_root->updateGlobalTransform();
+		tasks.wait();
+
+		// link the meshes into the scene, in the order their nodes were found
+		// meshes split by material go ahead of the node's other children
+		for (auto& extraction : m_importAssistor->meshExtractions)
+		{
+			if (extraction.node->m_nodeType != FBXNode::MESH)
+				extraction.node->m_children.insert(extraction.node->m_children.begin(), extraction.meshes.begin(), extraction.meshes.end());
+			m_meshes.insert(m_meshes.end(), extraction.meshes.begin(), extraction.meshes.end());
+		}
+
+		// meshes that have been handed over may be drawing, so asynchronous loads update the
+		// transforms on the GL thread instead
+		if (m_loadHandle == nullptr)
+			m_root->updateGlobalTransform();
 
 		delete m_importAssistor;
 		m_importAssistor = nullptr;
@@ -255,24 +432,6 @@ bool FBXFile::load(const char* a_filename, UNIT_SCALE a_scale /* = FBXFile::UNIT
 
 	lSdkManager->Destroy();
 
-	// load textures!
-	for (auto texture : m_textures)
-		m_threads.push_back( new std::thread( [](FBXTexture* t){
-
-		t->data = stbi_load(t->path.c_str(), &t->width, &t->height, &t->format, STBI_default);
-		//	t->data = SOIL_load_image(t->path.c_str(), &t->width, &t->height, &t->channels, SOIL_LOAD_AUTO);
-			if (t->data == nullptr)
-			{
-				printf("Failed to load texture: %s\n", t->path.c_str());
-			}
-	}, texture.second));
-
-	for (auto t : m_threads)
-		t->join();
-	m_threads.clear();
-
-
-
 	return true;
 }
 
@@ -303,8 +462,11 @@ bool FBXFile::loadAnimationsOnly(const char* a_filename, UNIT_SCALE a_scale /* =
 	// Create an importer.
 	FbxImporter* lImporter = FbxImporter::Create(lSdkManager,"");
 
-	// Initialize the importer by providing a filename.
-	bool lImportStatus = lImporter->Initialize(a_filename, -1, lSdkManager->GetIOSettings());
+	// Initialize the importer with a stream over the mapped file, or by filename if the format wasn't recognised.
+	FileViewStream lStream(lSdkManager, a_filename);
+	bool lImportStatus = lStream.isValid() ?
+		lImporter->Initialize(&lStream, nullptr, lStream.GetReaderID(), lSdkManager->GetIOSettings()) :
+		lImporter->Initialize(a_filename, -1, lSdkManager->GetIOSettings());
 
 	if ( !lImportStatus )
 	{
@@ -478,15 +640,18 @@ void FBXFile::extractObject(FBXNode* a_parent, void* a_object)
 				if (m_importAssistor->loadAnimationOnly == false)
 				{
 					if (fbxNode->GetMaterialCount() > 1)
-					{
 						node = new FBXNode();
-						extractMeshes(fbxNode,node);
-					}
 					else
-					{
 						node = new FBXMeshNode();
-						extractMeshes(fbxNode,node);
-					}
+
+					// the extraction runs as a task, and only touches the node's name and mesh data
+					// until load() links its meshes in
+					m_importAssistor->meshExtractions.push_back(ImportAssistor::MeshExtraction());
+					ImportAssistor::MeshExtraction* extraction = &m_importAssistor->meshExtractions.back();
+					extraction->node = node;
+					m_importAssistor->tasks->add([this, fbxNode, extraction]{
+						extractMeshes(fbxNode, extraction->node, extraction->meshes);
+					});
 				}
 			}
 			break;
@@ -557,7 +722,31 @@ void FBXFile::extractObject(FBXNode* a_parent, void* a_object)
 	}
 }
 
-void FBXFile::extractMeshes(void* a_object, void* a_aieNode)
+// reads a layer element's vector for a polygon vertex, whichever way the element is mapped
+template <typename ELEMENT>
+static bool readLayerElement(ELEMENT* a_element, int a_controlPointIndex, int a_vertexId, glm::vec4& a_value)
+{
+	int index = 0;
+	switch (a_element->GetMappingMode())
+	{
+	case FbxGeometryElement::eByControlPoint:	index = a_controlPointIndex;	break;
+	case FbxGeometryElement::eByPolygonVertex:	index = a_vertexId;				break;
+	default:	return false;
+	}
+
+	switch (a_element->GetReferenceMode())
+	{
+	case FbxGeometryElement::eDirect:			break;
+	case FbxGeometryElement::eIndexToDirect:	index = a_element->GetIndexArray().GetAt(index);	break;
+	default:	return false;
+	}
+
+	FbxVector4 value = a_element->GetDirectArray().GetAt(index);
+	a_value = glm::vec4((float)value[0], (float)value[1], (float)value[2], 0);
+	return true;
+}
+
+void FBXFile::extractMeshes(void* a_object, void* a_aieNode, std::vector<FBXMeshNode*>& a_meshes)
 {
 	FbxNode* fbxNode = (FbxNode*)a_object;
 	FbxMesh* fbxMesh = (FbxMesh*)fbxNode->GetNodeAttribute();
@@ -589,6 +778,8 @@ void FBXFile::extractMeshes(void* a_object, void* a_aieNode)
 	FbxGeometryElementUV* fbxTexCoord0 = fbxMesh->GetElementUV(0);
 	FbxGeometryElementUV* fbxTexCoord1 = fbxMesh->GetElementUV(1);
 	FbxGeometryElementNormal* fbxNormal = fbxMesh->GetElementNormal(0);
+	FbxGeometryElementTangent* fbxTangent = m_importTangents ? fbxMesh->GetElementTangent(0) : nullptr;
+	FbxGeometryElementBinormal* fbxBinormal = m_importTangents ? fbxMesh->GetElementBinormal(0) : nullptr;
 
 	// gather skinning info
 	FbxSkin* fbxSkin = (FbxSkin*)fbxMesh->GetDeformer(0, FbxDeformer::eSkin);
@@ -609,7 +800,9 @@ void FBXFile::extractMeshes(void* a_object, void* a_aieNode)
 			}
 			else
 			{
-				skinClusterBoneIndices[i] = m_importAssistor->boneIndexList[ skinClusters[i]->GetLink()->GetName() ];
+				// meshes are extracted in parallel so only read the map, links that aren't bones get no weight
+				auto bone = m_importAssistor->boneIndexList.find( skinClusters[i]->GetLink()->GetName() );
+				skinClusterBoneIndices[i] = bone != m_importAssistor->boneIndexList.end() ? bone->second : -1;
 			}
 		}
 	}
@@ -921,9 +1114,18 @@ void FBXFile::extractMeshes(void* a_object, void* a_aieNode)
 				}
 			}
 
+			// keep the file's own tangents rather than generating them, if it has both
+			if (fbxTangent != nullptr &&
+				fbxBinormal != nullptr &&
+				readLayerElement(fbxTangent, controlPointIndex, vertexId, vertex.tangent) &&
+				readLayerElement(fbxBinormal, controlPointIndex, vertexId, vertex.binormal))
+				meshes[material]->m_vertexAttributes |= FBXVertex::eTANGENT|FBXVertex::eBINORMAL;
+
 			// gather skinning data (slow but can't find any other way, yet!)
 			if (fbxSkin != nullptr)
 			{
+				meshes[material]->m_vertexAttributes |= FBXVertex::eINDICES|FBXVertex::eWEIGHTS;
+
 				for (k = 0; k != skinClusterCount; ++k)
 				{
 					if (skinClusterBoneIndices[k] == -1)
@@ -989,10 +1191,7 @@ void FBXFile::extractMeshes(void* a_object, void* a_aieNode)
 		}
 	}
 	
-	for (int i = 0 ; i < materialCount ; ++i )
-		m_threads.push_back( new std::thread( optimiseMesh, meshes[i] ) );
-	
-	// set mesh names, vertex attributes, extract material and add to mesh map
+	// set mesh names, extract material and hand back the meshes
 	for ( j = 0 ; j < materialCount ; ++j )
 	{
 		meshes[j]->m_name = fbxNode->GetName();
@@ -1002,19 +1201,35 @@ void FBXFile::extractMeshes(void* a_object, void* a_aieNode)
 			meshes[j]->m_name += fbxNode->GetMaterial(j)->GetName();	
 
 		meshes[j]->m_material = extractMaterial(fbxMesh,j);
-		m_meshes.push_back(meshes[j]);
+		a_meshes.push_back(meshes[j]);
 	}
-	
-	// if there is a single mesh return it, else make a new parent node and return that
+
+	// if there are several meshes the node becomes their parent, though load() only adds them to
+	// its children once every task is done
 	if (materialCount > 1)
 	{
 		FBXNode* node = (FBXNode*)a_aieNode;
 		node->m_name = fbxNode->GetName();
 		for ( j = 0 ; j < materialCount ; ++j )
-		{
-			node->m_children.push_back( meshes[j] );
 			meshes[j]->m_parent = node;
-		}
+	}
+
+	// weld each mesh, then generate its tangents once its vertices are final
+	for ( j = 0 ; j < materialCount ; ++j )
+	{
+		FBXMeshNode* mesh = meshes[j];
+		float weldEpsilon = m_weldEpsilon;
+
+		TaskGraph::Task weld = m_importAssistor->tasks->add([mesh, weldEpsilon]{
+			weldVertices(mesh, weldEpsilon);
+		});
+		TaskGraph* tasks = m_importAssistor->tasks;
+		tasks->add([this, mesh, tasks]{
+			calculateTangentsBinormals(mesh, *tasks, [this, mesh]{
+				if (m_loadHandle != nullptr)
+					m_loadHandle->publish(FBXLoadHandle::ITEM_MESH, mesh);
+			});
+		}, weld);
 	}
 
 	delete[] skinClusters;
@@ -1024,43 +1239,161 @@ void FBXFile::extractMeshes(void* a_object, void* a_aieNode)
 	delete[] nextIndex;
 }
 
-void FBXFile::optimiseMesh(FBXMeshNode* a_mesh)
+#else
+
+bool FBXFile::load(const char* a_filename, UNIT_SCALE a_scale /* = FBXFile::UNITS_METER */, 
+	bool a_loadTextures /* = true */, bool a_loadAnimations /* = true */, bool a_flipTextureY /*= true*/)
 {
-	//sort the vertex array so all common verts are adjacent in the array
-	std::sort(a_mesh->m_vertices.begin(), a_mesh->m_vertices.end());
+	printf("Error: Unable to load '%s', built without the FBX SDK! Use a baked file instead.\n", a_filename);
+	return false;
+}
 
-	unsigned int forward_iter = 1;
-	int j = 0;
+bool FBXFile::loadAnimationsOnly(const char* a_filename, UNIT_SCALE a_scale /* = FBXFile::UNITS_METER */)
+{
+	printf("Error: Unable to load '%s', built without the FBX SDK! Use a baked file instead.\n", a_filename);
+	return false;
+}
 
-	while ( forward_iter < a_mesh->m_vertices.size() )
+#endif
+
+// the most floats a vertex can have in its weld key
+static const unsigned int sc_maxWeldKeySize = 30;
+
+// turns a vertex attribute into an integer for welding
+// without a scale the bits are compared, with -0 and 0 treated as equal; with a scale the value
+// is snapped to a grid, clamped so that the conversion can't overflow
+static int weldComponent(float a_value, float a_scale)
+{
+	if (a_scale == 0)
 	{
-		if ( a_mesh->m_vertices[j] == a_mesh->m_vertices[forward_iter] )
+		int bits = 0;
+		if (a_value != 0)
+			memcpy(&bits, &a_value, sizeof(int));
+		return bits;
+	}
+
+	float cell = floorf(a_value * a_scale + 0.5f);
+	return (int)glm::clamp(cell, -1073741824.0f, 1073741824.0f);
+}
+
+// builds the key of the attributes the mesh uses, returning how many ints it holds
+static unsigned int weldKey(const FBXVertex& a_vertex, unsigned int a_attributes, float a_scale, int* a_key)
+{
+	unsigned int size = 0;
+
+	// position w, normal w and the like are constant, so only the components that vary are compared
+	if ((a_attributes & FBXVertex::ePOSITION) != 0)
+		for (int i = 0; i < 3; ++i)
+			a_key[size++] = weldComponent(a_vertex.position[i], a_scale);
+	if ((a_attributes & FBXVertex::eCOLOUR) != 0)
+		for (int i = 0; i < 4; ++i)
+			a_key[size++] = weldComponent(a_vertex.colour[i], a_scale);
+	if ((a_attributes & FBXVertex::eNORMAL) != 0)
+		for (int i = 0; i < 3; ++i)
+			a_key[size++] = weldComponent(a_vertex.normal[i], a_scale);
+	if ((a_attributes & FBXVertex::eTANGENT) != 0)
+		for (int i = 0; i < 4; ++i)
+			a_key[size++] = weldComponent(a_vertex.tangent[i], a_scale);
+	if ((a_attributes & FBXVertex::eBINORMAL) != 0)
+		for (int i = 0; i < 4; ++i)
+			a_key[size++] = weldComponent(a_vertex.binormal[i], a_scale);
+
+	// bone indices are never snapped, or nearby bones would merge
+	if ((a_attributes & FBXVertex::eINDICES) != 0)
+		for (int i = 0; i < 4; ++i)
+			a_key[size++] = weldComponent(a_vertex.indices[i], 0);
+	if ((a_attributes & FBXVertex::eWEIGHTS) != 0)
+		for (int i = 0; i < 4; ++i)
+			a_key[size++] = weldComponent(a_vertex.weights[i], a_scale);
+
+	if ((a_attributes & FBXVertex::eTEXCOORD1) != 0)
+		for (int i = 0; i < 2; ++i)
+			a_key[size++] = weldComponent(a_vertex.texCoord1[i], a_scale);
+	if ((a_attributes & FBXVertex::eTEXCOORD2) != 0)
+		for (int i = 0; i < 2; ++i)
+			a_key[size++] = weldComponent(a_vertex.texCoord2[i], a_scale);
+
+	return size;
+}
+
+static unsigned int weldHash(const int* a_key, unsigned int a_size)
+{
+	// FNV-1a over the key's ints, then mixed so that the low bits used for the bucket vary
+	unsigned int hash = 2166136261u;
+	for (unsigned int i = 0; i < a_size; ++i)
+		hash = (hash ^ (unsigned int)a_key[i]) * 16777619u;
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6b;
+	hash ^= hash >> 13;
+	return hash;
+}
+
+void FBXFile::weldVertices(FBXMeshNode* a_mesh, float a_epsilon)
+{
+	std::vector<FBXVertex>& vertices = a_mesh->m_vertices;
+	unsigned int vertexCount = (unsigned int)vertices.size();
+	if (vertexCount == 0)
+		return;
+
+	float scale = a_epsilon > 0 ? 1.0f / a_epsilon : 0.0f;
+
+	// every vertex has the same attributes, so the keys are a fixed size
+	int key[sc_maxWeldKeySize];
+	unsigned int keySize = weldKey(vertices[0], a_mesh->m_vertexAttributes, scale, key);
+	if (keySize == 0)
+		return;
+
+	// the keys and hashes of the unique vertices, and an open addressing table of them that is
+	// kept at most half full so that probes stay short
+	std::vector<int> keys(vertexCount * keySize);
+	std::vector<unsigned int> hashes(vertexCount);
+	std::vector<unsigned int> remap(vertexCount);
+
+	unsigned int tableSize = 16;
+	while (tableSize < vertexCount * 2)
+		tableSize <<= 1;
+	std::vector<unsigned int> table(tableSize, 0xffffffff);
+
+	unsigned int uniqueCount = 0;
+	for (unsigned int i = 0; i < vertexCount; ++i)
+	{
+		int* vertexKey = &keys[uniqueCount * keySize];
+		weldKey(vertices[i], a_mesh->m_vertexAttributes, scale, vertexKey);
+		unsigned int hash = weldHash(vertexKey, keySize);
+
+		unsigned int slot = hash & (tableSize - 1);
+		while (table[slot] != 0xffffffff)
+		{
+			unsigned int unique = table[slot];
+			if (hashes[unique] == hash &&
+				memcmp(&keys[unique * keySize], vertexKey, keySize * sizeof(int)) == 0)
+				break;
+			slot = (slot + 1) & (tableSize - 1);
+		}
+
+		if (table[slot] != 0xffffffff)
 		{
-			// if the adjacent verts are equal make all the duplicate vert's indicies point at the first one in the vector
-			a_mesh->m_indices[a_mesh->m_vertices[forward_iter].index[0]] = j;
-			++forward_iter;
+			remap[i] = table[slot];
 		}
 		else
 		{
-			// if they aren't duplicates, update the index to point at the vert's post sort position in the vector
-			a_mesh->m_indices[a_mesh->m_vertices[j].index[0]] = j;
-			++j;
-			// then push the current forward iterator back
-			// not sure if checking if j != forward pointer would be faster here.
-			a_mesh->m_vertices[j] = a_mesh->m_vertices[forward_iter];
-			a_mesh->m_indices[a_mesh->m_vertices[forward_iter].index[0]] = j;
-			++forward_iter;
+			// unique vertices are compacted in place, keeping the order they were first used in
+			table[slot] = uniqueCount;
+			hashes[uniqueCount] = hash;
+			remap[i] = uniqueCount;
+			if (uniqueCount != i)
+				vertices[uniqueCount] = vertices[i];
+			++uniqueCount;
 		}
 	}
-	a_mesh->m_vertices.resize(j+1);
 
-	if ((a_mesh->m_vertexAttributes & FBXVertex::eTEXCOORD1) != 0)
-	{
-		a_mesh->m_vertexAttributes |= FBXVertex::eTANGENT|FBXVertex::eBINORMAL;
-		calculateTangentsBinormals(a_mesh->m_vertices,a_mesh->m_indices);
-	}
+	for (auto& index : a_mesh->m_indices)
+		index = remap[index];
+	vertices.resize(uniqueCount);
 }
 
+#if !defined(FBXFILE_NO_SDK)
+
 void FBXFile::extractLight(FBXLightNode* a_light, void* a_object)
 {
 	FbxNode* fbxNode = (FbxNode*)a_object;
@@ -1274,9 +1607,7 @@ FBXMaterial* FBXFile::extractMaterial(void* a_mesh, int a_materialIndex)
 					FbxFileTexture* fileTexture = FbxCast<FbxFileTexture>(pProperty.GetSrcObject<FbxTexture>(0));
 					if (fileTexture != nullptr)
 					{
-						const char* szLastForward = strrchr(fileTexture->GetFileName(),'/');
-						const char* szLastBackward = strrchr(fileTexture->GetFileName(),'\\');
-						const char* szFilename = fileTexture->GetFileName();
+						const char* szFilename = textureFilename(fileTexture);
 
 						material->textureRotation[i] = (float)fileTexture->GetRotationW();
 						material->textureTiling[i].x = (float)fileTexture->GetScaleU();
@@ -1284,11 +1615,6 @@ FBXMaterial* FBXFile::extractMaterial(void* a_mesh, int a_materialIndex)
 						material->textureOffsets[i].x = (float)fileTexture->GetTranslationU();
 						material->textureOffsets[i].y = (float)fileTexture->GetTranslationV();
 						
-						if (szLastForward != nullptr && szLastForward > szLastBackward)
-							szFilename = szLastForward + 1;
-						else if (szLastBackward != nullptr)
-							szFilename = szLastBackward + 1;
-						
 						std::string fullPath = m_path + szFilename;
 
 						auto iter = m_textures.find(fullPath);
@@ -1301,8 +1627,16 @@ FBXMaterial* FBXFile::extractMaterial(void* a_mesh, int a_materialIndex)
 							FBXTexture* texture = new FBXTexture();
 							texture->name = szFilename;
 							texture->path = fullPath;
+							texture->normalMap = m_importAssistor->normalMaps.count(fullPath) > 0;
 							material->textures[i] = texture;
 							m_textures[ fullPath ] = texture;
+
+							bool compress = m_compressTextures;
+							m_importAssistor->tasks->add([this, texture, compress]{
+								loadTexture(texture, compress);
+								if (m_loadHandle != nullptr)
+									m_loadHandle->publish(FBXLoadHandle::ITEM_TEXTURE, texture);
+							});
 						}
 					}
 				}   
@@ -1311,6 +1645,9 @@ FBXMaterial* FBXFile::extractMaterial(void* a_mesh, int a_materialIndex)
 
 		m_materials[material->name] = material;
 		m_materialMutex.unlock();
+
+		if (m_loadHandle != nullptr)
+			m_loadHandle->publish(FBXLoadHandle::ITEM_MATERIAL, material);
 		return material;
 	}
 
@@ -1318,30 +1655,6 @@ FBXMaterial* FBXFile::extractMaterial(void* a_mesh, int a_materialIndex)
 	return nullptr;
 }
 
-void FBXFile::initialiseOpenGLTextures()
-{
-	for (auto texture : m_textures)
-	{
-	//	texture.second->handle = SOIL_create_OGL_texture(texture.second->data, texture.second->width, texture.second->height, texture.second->channels, 
-	//		SOIL_CREATE_NEW_ID, SOIL_FLAG_MIPMAPS | SOIL_FLAG_INVERT_Y | SOIL_FLAG_TEXTURE_REPEATS);
-		switch (texture.second->format)
-		{
-		case STBI_grey: texture.second->format = GL_LUMINANCE; break;
-		case STBI_grey_alpha: texture.second->format = GL_LUMINANCE_ALPHA; break;
-		case STBI_rgb: texture.second->format = GL_RGB; break;
-		case STBI_rgb_alpha: texture.second->format = GL_RGBA; break;
-		};
-
-		glGenTextures(1, &texture.second->handle);
-		glBindTexture(GL_TEXTURE_2D, texture.second->handle);
-		glTexImage2D(GL_TEXTURE_2D, 0, texture.second->format, texture.second->width, texture.second->height, 0, texture.second->format, GL_UNSIGNED_BYTE, texture.second->data);
-	//	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	//	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glGenerateMipmap(GL_TEXTURE_2D);
-		glBindTexture(GL_TEXTURE_2D, 0);
-	}
-}
-
 void FBXFile::extractAnimation(void* a_scene)
 {
 	FbxScene* fbxScene = (FbxScene*)a_scene;
@@ -1407,6 +1720,7 @@ void FBXFile::extractAnimation(void* a_scene)
 			}
 		}
 
+		anim->buildKeyStreams();
 		m_animations[ anim->m_name ] = anim;
 	}
 }
@@ -1617,73 +1931,7 @@ void FBXFile::extractSkeleton(FBXSkeleton* a_skeleton, void* a_scene)
 	}
 }
 
-void FBXSkeleton::evaluate(const FBXAnimation* a_animation, float a_time, bool a_loop, float a_FPS)
-{
-	if (a_animation != nullptr)
-	{
-		// determine frame we're on
-		int totalFrames = a_animation->m_endFrame - a_animation->m_startFrame;
-		float animDuration = totalFrames / a_FPS;
-
-		// get time through frame
-		float frameTime = 0;
-		if (a_loop)
-			frameTime = glm::max(glm::mod(a_time,animDuration),0.0f);
-		else
-			frameTime = glm::min(glm::max(a_time,0.0f),animDuration);
-				
-		const FBXTrack* track = nullptr;
-		const FBXKeyFrame* start = nullptr;
-		const FBXKeyFrame* end = nullptr;
-
-		for ( unsigned int i = 0 ; i < a_animation->m_trackCount ; ++i )
-		{
-			track = &(a_animation->m_tracks[i]);
-
-			start = nullptr;
-			end = nullptr;
-			float startTime, endTime;
-
-			// determine the two keyframes we're between
-			for ( unsigned int j = 0 ; j < track->m_keyframeCount - 1 ; ++j )
-			{
-				startTime = (track->m_keyframes[j].m_key - a_animation->m_startFrame) / a_FPS;
-				endTime = (track->m_keyframes[j + 1].m_key - a_animation->m_startFrame) / a_FPS;
-
-				if (startTime <= frameTime &&
-					endTime >= frameTime)
-				{
-					// found?
-					start = &(track->m_keyframes[j]);
-					end = &(track->m_keyframes[j+1]);
-					break;
-				}
-			}
-
-			// interpolate between them
-			if (start != nullptr &&
-				end != nullptr)
-			{
-				float fScale = glm::max(0.0f,glm::min(1.0f,(frameTime - startTime) / (endTime - startTime)));
-
-				// translation
-				glm::vec3 T = glm::mix(start->m_translation,end->m_translation,fScale);
-				
-				// scale
-				glm::vec3 S = glm::mix(start->m_scale,end->m_scale,fScale);
-				
-				// rotation (quaternion slerp)
-				glm::quat R = glm::normalize(glm::slerp(start->m_rotation,end->m_rotation,fScale));
-
-				// build matrix
-				glm::mat4 mRot = glm::mat4_cast( R );
-				glm::mat4 mScale = glm::scale( S );
-				glm::mat4 mTranslate = glm::translate( T );
-				m_nodes[ track->m_boneIndex ]->m_localTransform = mTranslate * mScale * mRot;
-			}
-		}
-	}
-}
+#endif
 
 void FBXSkeleton::updateBones()
 {
@@ -1702,74 +1950,6 @@ void FBXSkeleton::updateBones()
 	}
 }
 
-void FBXFile::calculateTangentsBinormals(std::vector<FBXVertex>& a_vertices, const std::vector<unsigned int>& a_indices)
-{
-	unsigned int vertexCount = (unsigned int)a_vertices.size();
-	glm::vec3* tan1 = new glm::vec3[vertexCount * 2];
-	glm::vec3* tan2 = tan1 + vertexCount;
-	memset(tan1, 0, vertexCount * sizeof(glm::vec3) * 2);
-
-	unsigned int indexCount = (unsigned int)a_indices.size();
-	for (unsigned int a = 0; a < indexCount; a += 3)
-	{
-		unsigned int i1 = a_indices[a];
-		unsigned int i2 = a_indices[a + 1];
-		unsigned int i3 = a_indices[a + 2];
-
-		const glm::vec4& v1 = a_vertices[i1].position;
-		const glm::vec4& v2 = a_vertices[i2].position;
-		const glm::vec4& v3 = a_vertices[i3].position;
-
-		const glm::vec2& w1 = a_vertices[i1].texCoord1;
-		const glm::vec2& w2 = a_vertices[i2].texCoord1;
-		const glm::vec2& w3 = a_vertices[i3].texCoord1;
-
-		float x1 = v2.x - v1.x;
-		float x2 = v3.x - v1.x;
-		float y1 = v2.y - v1.y;
-		float y2 = v3.y - v1.y;
-		float z1 = v2.z - v1.z;
-		float z2 = v3.z - v1.z;
-
-		float s1 = w2.x - w1.x;
-		float s2 = w3.x - w1.x;
-		float t1 = w2.y - w1.y;
-		float t2 = w3.y - w1.y;
-
-		float t = s1 * t2 - s2 * t1;
-		float r = t == 0 ? 0 : 1.0f / t;
-		glm::vec3 sdir((t2 * x1 - t1 * x2) * r, (t2 * y1 - t1 * y2) * r, (t2 * z1 - t1 * z2) * r);
-		glm::vec3 tdir((s1 * x2 - s2 * x1) * r, (s1 * y2 - s2 * y1) * r, (s1 * z2 - s2 * z1) * r);
-
-		tan1[i1] += sdir;
-		tan1[i2] += sdir;
-		tan1[i3] += sdir;
-
-		tan2[i1] += tdir;
-		tan2[i2] += tdir;
-		tan2[i3] += tdir;
-	}
-
-	for (unsigned int a = 0; a < vertexCount; a++)
-	{
-		const glm::vec3& n = a_vertices[a].normal.xyz();
-		const glm::vec3& t = tan1[a];
-
-		// Gram-Schmidt orthogonalise
-		glm::vec3 p = t - n * glm::dot(n, t);
-		if ( glm::length2(p) != 0 )
-		{
-			a_vertices[a].tangent = glm::vec4( glm::normalize( p ), 0.0f );
-
-			// calculate binormal
-			float sign = glm::dot(glm::cross(n.xyz(), t.xyz()), tan2[a].xyz()) < 0.0f ? -1.0f : 1.0f;
-			a_vertices[a].binormal = glm::vec4(glm::cross(a_vertices[a].normal.xyz(),a_vertices[a].tangent.xyz()) * sign, 0);
-		}
-	}
-
-	delete[] tan1;
-}
-
 unsigned int FBXFile::nodeCount(FBXNode* a_node)
 {
 	if (a_node == nullptr)
@@ -1830,6 +2010,14 @@ FBXAnimation* FBXFile::getAnimationByName(const char* a_name)
 	return nullptr;
 }
 
+FBXCompressedAnimation* FBXFile::getCompressedAnimationByName(const char* a_name)
+{
+	auto oIter = m_compressedAnimations.find(a_name);
+	if (oIter != m_compressedAnimations.end())
+		return oIter->second;
+	return nullptr;
+}
+
 FBXLightNode* FBXFile::getLightByIndex(unsigned int a_index)
 {
 	for (auto t : m_lights)
@@ -1874,6 +2062,17 @@ FBXAnimation* FBXFile::getAnimationByIndex(unsigned int a_index)
 	return nullptr;
 }
 
+FBXCompressedAnimation* FBXFile::getCompressedAnimationByIndex(unsigned int a_index)
+{
+	for (auto t : m_compressedAnimations)
+	{
+		if (a_index-- == 0)
+			return t.second;
+	}
+
+	return nullptr;
+}
+
 FBXTexture* FBXFile::getTextureByIndex(unsigned int a_index)
 {
 	for (auto t : m_textures)
@@ -1885,6 +2084,8 @@ FBXTexture* FBXFile::getTextureByIndex(unsigned int a_index)
 	return nullptr;
 }
 
+#if !defined(FBXFILE_NO_SDK)
+
 void FBXFile::gatherBones(void* a_object)
 {
 	FbxNode* fbxNode = (FbxNode*)a_object;
@@ -1902,6 +2103,8 @@ void FBXFile::gatherBones(void* a_object)
 	}
 }
 
+#endif
+
 void FBXNode::updateGlobalTransform()
 {
 	if (m_parent != nullptr)
@@ -1928,7 +2131,7 @@ void FBXCameraNode::updateGlobalTransform()
 
 FBXTexture::~FBXTexture()
 {
-	delete[] data;
+	stbi_image_free(data);
 	glDeleteTextures(1, &handle);
 }
 
@@ -1950,5 +2153,6 @@ FBXAnimation* FBXAnimation::clone() const
 		memcpy(copy->m_tracks[i].m_keyframes,m_tracks[i].m_keyframes,sizeof(FBXKeyFrame) * m_tracks[i].m_keyframeCount);
 	}
 
+	copy->buildKeyStreams();
 	return copy;
 }
@@ -0,0 +1,844 @@
+#include "FBXFile.h"
+#include "FBXFileInternal.h"
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+
+// how many keys a cursor steps forward before giving up and searching, enough for playback at
+// rates well above the animation's own
+static const unsigned int sc_cursorSteps = 4;
+
+// the three smallest components of a unit quaternion lie within +-1/sqrt(2)
+static const float sc_smallestThreeRange = 0.70710678f;
+
+// the last generation given to an animation, 0 is left for poses that haven't sampled one
+static std::atomic<unsigned int> s_lastGeneration(0);
+
+// a track ready to be interpolated, the keys either side of the time and how far between them it is
+struct TrackSample
+{
+	unsigned int	bone;
+	unsigned int	start;
+	unsigned int	end;
+	float			blend;
+};
+
+unsigned int FBXAnimation::newGeneration()
+{
+	return ++s_lastGeneration;
+}
+
+void FBXAnimation::buildKeyStreams()
+{
+	// cursors into the old streams are no use
+	m_generation = newGeneration();
+
+	unsigned int keyCount = 0;
+	for (unsigned int i = 0; i < m_trackCount; ++i)
+		keyCount += m_tracks[i].m_keyframeCount;
+
+	m_keyStart.resize(m_trackCount + 1);
+	m_keyFrames.resize(keyCount);
+	m_keyRotations.resize(keyCount);
+	m_keyTranslations.resize(keyCount);
+	m_keyScales.resize(keyCount);
+
+	unsigned int key = 0;
+	for (unsigned int i = 0; i < m_trackCount; ++i)
+	{
+		m_keyStart[i] = key;
+
+		for (unsigned int j = 0; j < m_tracks[i].m_keyframeCount; ++j, ++key)
+		{
+			const FBXKeyFrame& keyframe = m_tracks[i].m_keyframes[j];
+			m_keyFrames[key] = (float)keyframe.m_key;
+			m_keyRotations[key] = keyframe.m_rotation;
+			m_keyTranslations[key] = glm::vec4(keyframe.m_translation, 0);
+			m_keyScales[key] = glm::vec4(keyframe.m_scale, 1);
+		}
+	}
+	m_keyStart[m_trackCount] = key;
+}
+
+// the frame a_time is at, wrapped or clamped to the animation's length
+static float animationFrame(unsigned int a_startFrame, unsigned int a_endFrame, float a_time, bool a_loop, float a_FPS)
+{
+	// determine frame we're on
+	int totalFrames = a_endFrame - a_startFrame;
+	float animDuration = totalFrames / a_FPS;
+
+	// get time through frame
+	float frameTime = 0;
+	if (animDuration <= 0)
+		frameTime = 0;
+	else if (a_loop)
+		frameTime = glm::max(glm::mod(a_time,animDuration),0.0f);
+	else
+		frameTime = glm::min(glm::max(a_time,0.0f),animDuration);
+
+	return a_startFrame + frameTime * a_FPS;
+}
+
+// finds the key that starts the pair a_frame is between, clamped to the first and last pairs
+// steps forward from the cursor when it can, as during playback, otherwise binary searches
+template <typename T>
+static unsigned int findKey(const T* a_frames, unsigned int a_count, float a_frame, unsigned int a_cursor)
+{
+	unsigned int last = a_count - 2;
+	unsigned int key = glm::min(a_cursor, last);
+
+	if (a_frames[key] <= a_frame)
+	{
+		for (unsigned int i = 0; i < sc_cursorSteps; ++i, ++key)
+		{
+			if (key == last ||
+				a_frame < a_frames[key + 1])
+				return key;
+		}
+	}
+
+	const T* upper = std::upper_bound(a_frames, a_frames + a_count, a_frame);
+	if (upper == a_frames)
+		return 0;
+	return glm::min((unsigned int)(upper - a_frames) - 1, last);
+}
+
+// the same as glm::translate(T) * glm::scale(S) * glm::mat4_cast(R), without the matrix multiplies
+static void composeTransform(const glm::quat& a_rotation, const glm::vec3& a_translation, const glm::vec3& a_scale, glm::mat4& a_transform)
+{
+	float x = a_rotation.x, y = a_rotation.y, z = a_rotation.z, w = a_rotation.w;
+	float xx = x * x, yy = y * y, zz = z * z;
+	float xy = x * y, xz = x * z, yz = y * z;
+	float wx = w * x, wy = w * y, wz = w * z;
+
+	a_transform[0] = glm::vec4((1 - 2 * (yy + zz)) * a_scale.x, 2 * (xy + wz) * a_scale.y, 2 * (xz - wy) * a_scale.z, 0);
+	a_transform[1] = glm::vec4(2 * (xy - wz) * a_scale.x, (1 - 2 * (xx + zz)) * a_scale.y, 2 * (yz + wx) * a_scale.z, 0);
+	a_transform[2] = glm::vec4(2 * (xz + wy) * a_scale.x, 2 * (yz - wx) * a_scale.y, (1 - 2 * (xx + yy)) * a_scale.z, 0);
+	a_transform[3] = glm::vec4(a_translation, 1);
+}
+
+// normalised lerp, taking the shorter way round; keys are close enough together that it
+// follows slerp's path closely, and it's much cheaper
+static glm::quat nlerp(const glm::quat& a_start, glm::quat a_end, float a_blend)
+{
+	if (glm::dot(a_start, a_end) < 0)
+		a_end = -a_end;
+	return glm::normalize(a_start * (1 - a_blend) + a_end * a_blend);
+}
+
+// splits a transform built as composeTransform() does back into its parts
+static void decomposeTransform(const glm::mat4& a_transform, glm::quat& a_rotation, glm::vec4& a_translation, glm::vec4& a_scale)
+{
+	// the scale is applied after the rotation, so it's the length of each of the rotation's rows
+	glm::vec3 scale;
+	glm::mat3 rotation;
+	for (int row = 0; row < 3; ++row)
+	{
+		scale[row] = glm::length(glm::vec3(a_transform[0][row], a_transform[1][row], a_transform[2][row]));
+		for (int column = 0; column < 3; ++column)
+			rotation[column][row] = scale[row] > 0 ? a_transform[column][row] / scale[row] : 0;
+	}
+
+	a_rotation = glm::normalize(glm::quat_cast(rotation));
+	a_translation = glm::vec4(a_transform[3].x, a_transform[3].y, a_transform[3].z, 0);
+	a_scale = glm::vec4(scale, 1);
+}
+
+static void sampleTrack(const FBXAnimation* a_animation, const TrackSample& a_sample, FBXPose& a_pose)
+{
+	a_pose.m_rotations[a_sample.bone] = nlerp(a_animation->m_keyRotations[a_sample.start], a_animation->m_keyRotations[a_sample.end], a_sample.blend);
+	a_pose.m_translations[a_sample.bone] = glm::mix(a_animation->m_keyTranslations[a_sample.start], a_animation->m_keyTranslations[a_sample.end], a_sample.blend);
+	a_pose.m_scales[a_sample.bone] = glm::mix(a_animation->m_keyScales[a_sample.start], a_animation->m_keyScales[a_sample.end], a_sample.blend);
+}
+
+#if defined(FBXFILE_SSE)
+
+// loads four vectors, transposed so each register holds one element of all four
+static void loadTransposed(const float* a_first, const float* a_second, const float* a_third, const float* a_fourth, __m128* a_elements)
+{
+	a_elements[0] = _mm_loadu_ps(a_first);
+	a_elements[1] = _mm_loadu_ps(a_second);
+	a_elements[2] = _mm_loadu_ps(a_third);
+	a_elements[3] = _mm_loadu_ps(a_fourth);
+	_MM_TRANSPOSE4_PS(a_elements[0], a_elements[1], a_elements[2], a_elements[3]);
+}
+
+static __m128 lerp(__m128 a_start, __m128 a_end, __m128 a_blend)
+{
+	return _mm_add_ps(a_start, _mm_mul_ps(_mm_sub_ps(a_end, a_start), a_blend));
+}
+
+// sampleTrack() for four tracks at once
+static void sampleTracks(const FBXAnimation* a_animation, const TrackSample* a_samples, FBXPose& a_pose)
+{
+	__m128 blend = _mm_set_ps(a_samples[3].blend, a_samples[2].blend, a_samples[1].blend, a_samples[0].blend);
+	__m128 start[4], end[4];
+
+	// rotations, flipping the end keys that are on the other side of the hypersphere
+	const glm::quat* rotations = a_animation->m_keyRotations.data();
+	loadTransposed(&rotations[a_samples[0].start].x, &rotations[a_samples[1].start].x, &rotations[a_samples[2].start].x, &rotations[a_samples[3].start].x, start);
+	loadTransposed(&rotations[a_samples[0].end].x, &rotations[a_samples[1].end].x, &rotations[a_samples[2].end].x, &rotations[a_samples[3].end].x, end);
+
+	__m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(start[0], end[0]), _mm_mul_ps(start[1], end[1])),
+							_mm_add_ps(_mm_mul_ps(start[2], end[2]), _mm_mul_ps(start[3], end[3])));
+	__m128 flip = _mm_and_ps(_mm_cmplt_ps(dot, _mm_setzero_ps()), _mm_set1_ps(-0.0f));
+
+	__m128 x = lerp(start[0], _mm_xor_ps(end[0], flip), blend);
+	__m128 y = lerp(start[1], _mm_xor_ps(end[1], flip), blend);
+	__m128 z = lerp(start[2], _mm_xor_ps(end[2], flip), blend);
+	__m128 w = lerp(start[3], _mm_xor_ps(end[3], flip), blend);
+
+	__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)),
+										   _mm_add_ps(_mm_mul_ps(z, z), _mm_mul_ps(w, w))));
+	__m128 inverseLength = _mm_div_ps(_mm_set1_ps(1), length);
+	x = _mm_mul_ps(x, inverseLength);
+	y = _mm_mul_ps(y, inverseLength);
+	z = _mm_mul_ps(z, inverseLength);
+	w = _mm_mul_ps(w, inverseLength);
+
+	// transpose back so each register holds one track's rotation
+	_MM_TRANSPOSE4_PS(x, y, z, w);
+	_mm_storeu_ps(&a_pose.m_rotations[a_samples[0].bone].x, x);
+	_mm_storeu_ps(&a_pose.m_rotations[a_samples[1].bone].x, y);
+	_mm_storeu_ps(&a_pose.m_rotations[a_samples[2].bone].x, z);
+	_mm_storeu_ps(&a_pose.m_rotations[a_samples[3].bone].x, w);
+
+	// translations and scales interpolate component by component, so they don't need transposing
+	for (int i = 0; i < 4; ++i)
+	{
+		const TrackSample& sample = a_samples[i];
+		__m128 trackBlend = _mm_set1_ps(sample.blend);
+
+		_mm_storeu_ps(&a_pose.m_translations[sample.bone].x, lerp(_mm_loadu_ps(&a_animation->m_keyTranslations[sample.start].x),
+																   _mm_loadu_ps(&a_animation->m_keyTranslations[sample.end].x), trackBlend));
+		_mm_storeu_ps(&a_pose.m_scales[sample.bone].x, lerp(_mm_loadu_ps(&a_animation->m_keyScales[sample.start].x),
+															 _mm_loadu_ps(&a_animation->m_keyScales[sample.end].x), trackBlend));
+	}
+}
+
+// composeTransform() for four consecutive bones
+static void composeTransforms(const glm::quat* a_rotations, const glm::vec4* a_translations, const glm::vec4* a_scales, glm::mat4* a_transforms)
+{
+	__m128 rotation[4], translation[4], scale[4];
+	loadTransposed(&a_rotations[0].x, &a_rotations[1].x, &a_rotations[2].x, &a_rotations[3].x, rotation);
+	loadTransposed(&a_translations[0].x, &a_translations[1].x, &a_translations[2].x, &a_translations[3].x, translation);
+	loadTransposed(&a_scales[0].x, &a_scales[1].x, &a_scales[2].x, &a_scales[3].x, scale);
+
+	__m128 x = rotation[0], y = rotation[1], z = rotation[2], w = rotation[3];
+	__m128 one = _mm_set1_ps(1);
+	__m128 two = _mm_set1_ps(2);
+	__m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+	__m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+	__m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+	__m128 column0[4] = {
+		_mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), scale[0]),
+		_mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), scale[1]),
+		_mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), scale[2]),
+		_mm_setzero_ps() };
+	__m128 column1[4] = {
+		_mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), scale[0]),
+		_mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), scale[1]),
+		_mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), scale[2]),
+		_mm_setzero_ps() };
+	__m128 column2[4] = {
+		_mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), scale[0]),
+		_mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), scale[1]),
+		_mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), scale[2]),
+		_mm_setzero_ps() };
+	__m128 column3[4] = { translation[0], translation[1], translation[2], one };
+
+	// transpose back so each register holds a column of one bone's matrix
+	_MM_TRANSPOSE4_PS(column0[0], column0[1], column0[2], column0[3]);
+	_MM_TRANSPOSE4_PS(column1[0], column1[1], column1[2], column1[3]);
+	_MM_TRANSPOSE4_PS(column2[0], column2[1], column2[2], column2[3]);
+	_MM_TRANSPOSE4_PS(column3[0], column3[1], column3[2], column3[3]);
+
+	for (int i = 0; i < 4; ++i)
+	{
+		_mm_storeu_ps(&a_transforms[i][0][0], column0[i]);
+		_mm_storeu_ps(&a_transforms[i][1][0], column1[i]);
+		_mm_storeu_ps(&a_transforms[i][2][0], column2[i]);
+		_mm_storeu_ps(&a_transforms[i][3][0], column3[i]);
+	}
+}
+
+// a_lhs * a_rhs, each column of the result being a_lhs's columns weighted by a_rhs's column
+// a_result can be either of the others
+static void multiply(const glm::mat4& a_lhs, const glm::mat4& a_rhs, glm::mat4& a_result)
+{
+	__m128 column0 = _mm_loadu_ps(&a_lhs[0][0]);
+	__m128 column1 = _mm_loadu_ps(&a_lhs[1][0]);
+	__m128 column2 = _mm_loadu_ps(&a_lhs[2][0]);
+	__m128 column3 = _mm_loadu_ps(&a_lhs[3][0]);
+
+	for (int i = 0; i < 4; ++i)
+	{
+		const float* weights = &a_rhs[i][0];
+		__m128 result = _mm_add_ps(_mm_add_ps(_mm_mul_ps(column0, _mm_set1_ps(weights[0])), _mm_mul_ps(column1, _mm_set1_ps(weights[1]))),
+								   _mm_add_ps(_mm_mul_ps(column2, _mm_set1_ps(weights[2])), _mm_mul_ps(column3, _mm_set1_ps(weights[3]))));
+		_mm_storeu_ps(&a_result[i][0], result);
+	}
+}
+
+#else
+
+static void multiply(const glm::mat4& a_lhs, const glm::mat4& a_rhs, glm::mat4& a_result)
+{
+	a_result = a_lhs * a_rhs;
+}
+
+#endif
+
+void FBXPose::resize(unsigned int a_boneCount)
+{
+	if (m_boneCount == a_boneCount)
+		return;
+
+	m_boneCount = a_boneCount;
+	m_rotations.assign(a_boneCount, glm::quat(1, 0, 0, 0));
+	m_translations.assign(a_boneCount, glm::vec4(0));
+	m_scales.assign(a_boneCount, glm::vec4(1));
+}
+
+void FBXPose::reset(const FBXSkeleton* a_skeleton)
+{
+	resize(a_skeleton->m_boneCount);
+
+	for ( unsigned int i = 0 ; i < m_boneCount ; ++i )
+		decomposeTransform(a_skeleton->m_nodes[i]->m_localTransform, m_rotations[i], m_translations[i], m_scales[i]);
+}
+
+void FBXPose::sample(const FBXAnimation* a_animation, float a_time, bool a_loop /* = true */, float a_FPS /* = 24.0f */)
+{
+	// animations put together by hand need their streams built before they can be sampled
+	if (a_animation == nullptr ||
+		a_animation->m_keyStart.size() != a_animation->m_trackCount + 1)
+		return;
+
+	float frame = animationFrame(a_animation->m_startFrame, a_animation->m_endFrame, a_time, a_loop, a_FPS);
+
+	if (m_cursorGeneration != a_animation->m_generation)
+	{
+		m_cursorGeneration = a_animation->m_generation;
+		m_keyCursors.assign(a_animation->m_trackCount, 0);
+	}
+
+	// find each track's keys, sampling them in fours as they're ready
+	TrackSample samples[4];
+	unsigned int sampleCount = 0;
+
+	for ( unsigned int i = 0 ; i < a_animation->m_trackCount ; ++i )
+	{
+		unsigned int first = a_animation->m_keyStart[i];
+		unsigned int count = a_animation->m_keyStart[i + 1] - first;
+		if (count == 0 ||
+			a_animation->m_tracks[i].m_boneIndex >= m_boneCount)
+			continue;
+
+		TrackSample& sample = samples[sampleCount];
+		sample.bone = a_animation->m_tracks[i].m_boneIndex;
+		sample.start = sample.end = first;
+		sample.blend = 0;
+
+		if (count > 1)
+		{
+			const float* frames = &a_animation->m_keyFrames[first];
+			unsigned int key = findKey(frames, count, frame, m_keyCursors[i]);
+			m_keyCursors[i] = key;
+
+			sample.start = first + key;
+			sample.end = first + key + 1;
+			float span = frames[key + 1] - frames[key];
+			if (span > 0)
+				sample.blend = glm::clamp((frame - frames[key]) / span, 0.0f, 1.0f);
+		}
+
+#if defined(FBXFILE_SSE)
+		if (++sampleCount == 4)
+		{
+			sampleTracks(a_animation, samples, *this);
+			sampleCount = 0;
+		}
+#else
+		sampleTrack(a_animation, sample, *this);
+#endif
+	}
+
+	for (unsigned int i = 0; i < sampleCount; ++i)
+		sampleTrack(a_animation, samples[i], *this);
+}
+
+void FBXPose::blend(const FBXPose& a_other, float a_weight, const float* a_mask /* = nullptr */)
+{
+	unsigned int boneCount = glm::min(m_boneCount, a_other.m_boneCount);
+	for ( unsigned int i = 0 ; i < boneCount ; ++i )
+	{
+		float weight = a_mask != nullptr ? a_weight * a_mask[i] : a_weight;
+		if (weight <= 0)
+			continue;
+
+		m_rotations[i] = nlerp(m_rotations[i], a_other.m_rotations[i], weight);
+		m_translations[i] = glm::mix(m_translations[i], a_other.m_translations[i], weight);
+		m_scales[i] = glm::mix(m_scales[i], a_other.m_scales[i], weight);
+	}
+}
+
+void FBXPose::add(const FBXPose& a_additive, const FBXPose& a_reference, float a_weight, const float* a_mask /* = nullptr */)
+{
+	unsigned int boneCount = glm::min(m_boneCount, glm::min(a_additive.m_boneCount, a_reference.m_boneCount));
+	for ( unsigned int i = 0 ; i < boneCount ; ++i )
+	{
+		float weight = a_mask != nullptr ? a_weight * a_mask[i] : a_weight;
+		if (weight <= 0)
+			continue;
+
+		// the rotation from the reference to the additive, applied on top of the bone's own
+		glm::quat difference = glm::conjugate(a_reference.m_rotations[i]) * a_additive.m_rotations[i];
+		m_rotations[i] = glm::normalize(m_rotations[i] * nlerp(glm::quat(1, 0, 0, 0), difference, weight));
+
+		m_translations[i] += (a_additive.m_translations[i] - a_reference.m_translations[i]) * weight;
+
+		glm::vec4 scale(1);
+		for (int j = 0; j < 3; ++j)
+		{
+			if (a_reference.m_scales[i][j] != 0)
+				scale[j] = a_additive.m_scales[i][j] / a_reference.m_scales[i][j];
+		}
+		m_scales[i] *= glm::mix(glm::vec4(1), scale, weight);
+	}
+}
+
+void FBXSkeleton::evaluate(const FBXAnimation* a_animation, float a_time, bool a_loop, float a_FPS)
+{
+	if (a_animation == nullptr ||
+		a_animation->m_keyStart.size() != a_animation->m_trackCount + 1)
+		return;
+
+	// only the animated bones are written, so the rest of the nodes keep their transforms
+	m_pose.resize(m_boneCount);
+	m_pose.sample(a_animation, a_time, a_loop, a_FPS);
+
+	for ( unsigned int i = 0 ; i < a_animation->m_trackCount ; ++i )
+	{
+		unsigned int bone = a_animation->m_tracks[i].m_boneIndex;
+		if (a_animation->m_tracks[i].m_keyframeCount > 0 &&
+			bone < m_boneCount)
+			composeTransform(m_pose.m_rotations[bone], glm::vec3(m_pose.m_translations[bone]), glm::vec3(m_pose.m_scales[bone]), m_nodes[bone]->m_localTransform);
+	}
+}
+
+static void encodeRotation(const glm::quat& a_rotation, unsigned short* a_values)
+{
+	float components[4] = { a_rotation.x, a_rotation.y, a_rotation.z, a_rotation.w };
+	int largest = 0;
+	for (int i = 1; i < 4; ++i)
+	{
+		if (fabsf(components[i]) > fabsf(components[largest]))
+			largest = i;
+	}
+
+	// q and -q are the same rotation, so flip it to make the largest positive, then it can be
+	// rebuilt from the other three
+	float sign = components[largest] < 0 ? -1.0f : 1.0f;
+
+	unsigned short packed[3];
+	for (int i = 0, j = 0; i < 4; ++i)
+	{
+		if (i == largest)
+			continue;
+		float value = glm::clamp(components[i] * sign / sc_smallestThreeRange, -1.0f, 1.0f);
+		packed[j++] = (unsigned short)floorf((value * 0.5f + 0.5f) * 32767.0f + 0.5f);
+	}
+
+	// 15 bits each, with the largest's index in the top bits of the first two
+	a_values[0] = (unsigned short)(packed[0] | ((largest & 2) << 14));
+	a_values[1] = (unsigned short)(packed[1] | ((largest & 1) << 15));
+	a_values[2] = packed[2];
+}
+
+static glm::quat decodeRotation(const unsigned short* a_values)
+{
+	int largest = ((a_values[0] >> 14) & 2) | (a_values[1] >> 15);
+
+	float components[4];
+	float lengthSquared = 0;
+	for (int i = 0, j = 0; i < 4; ++i)
+	{
+		if (i == largest)
+			continue;
+		components[i] = ((a_values[j++] & 0x7fff) / 32767.0f * 2 - 1) * sc_smallestThreeRange;
+		lengthSquared += components[i] * components[i];
+	}
+	components[largest] = sqrtf(glm::max(1 - lengthSquared, 0.0f));
+
+	return glm::quat(components[3], components[0], components[1], components[2]);
+}
+
+static unsigned short encodeRanged(float a_value, float a_min, float a_extent)
+{
+	if (a_extent <= 0)
+		return 0;
+	return (unsigned short)floorf(glm::clamp((a_value - a_min) / a_extent, 0.0f, 1.0f) * 65535.0f + 0.5f);
+}
+
+static glm::vec3 decodeRanged(const unsigned short* a_values, const glm::vec3& a_min, const glm::vec3& a_extent)
+{
+	return a_min + a_extent * glm::vec3(a_values[0], a_values[1], a_values[2]) / 65535.0f;
+}
+
+// the angle between two rotations, from their distance apart, which unlike acos of their dot
+// product is still accurate for the tiny angles tolerances are set at
+static float rotationError(const glm::quat& a_rotation, glm::quat a_target)
+{
+	if (glm::dot(a_rotation, a_target) < 0)
+		a_target = -a_target;
+	glm::quat difference = a_rotation + -a_target;
+	float distance = sqrtf(glm::dot(difference, difference));
+	return 4 * asinf(glm::min(distance * 0.5f, 1.0f));
+}
+
+// how far a_key is between a_first and a_last
+static float keyBlend(const FBXKeyFrame* a_keys, unsigned int a_key, unsigned int a_first, unsigned int a_last)
+{
+	if (a_keys[a_last].m_key <= a_keys[a_first].m_key)
+		return 0;
+	return (a_keys[a_key].m_key - a_keys[a_first].m_key) / (float)(a_keys[a_last].m_key - a_keys[a_first].m_key);
+}
+
+// picks the keys of a channel to keep; a_error(key, first, last) is how far a key is from the
+// interpolation of two others. if every key is within tolerance of the first only it is kept,
+// otherwise each kept key is followed by the furthest key that leaves those between within tolerance
+template <typename Error>
+static void reduceKeys(unsigned int a_count, float a_tolerance, Error a_error, std::vector<unsigned int>& a_kept)
+{
+	a_kept.assign(1, 0);
+
+	bool constant = true;
+	for (unsigned int i = 1; i < a_count && constant; ++i)
+		constant = a_error(i, 0, 0) <= a_tolerance;
+	if (constant)
+		return;
+
+	unsigned int first = 0;
+	while (first + 1 < a_count)
+	{
+		unsigned int last = first + 1;
+		while (last + 1 < a_count)
+		{
+			bool fits = true;
+			for (unsigned int i = first + 1; i <= last && fits; ++i)
+				fits = a_error(i, first, last + 1) <= a_tolerance;
+			if (fits == false)
+				break;
+			++last;
+		}
+
+		a_kept.push_back(last);
+		first = last;
+	}
+}
+
+bool FBXCompressedAnimation::compress(const FBXAnimation* a_animation, float a_rotationTolerance /* = 0.001f */,
+	float a_translationTolerance /* = 0.001f */, float a_scaleTolerance /* = 0.001f */)
+{
+	m_tracks.clear();
+	m_keyFrames.clear();
+	m_keyValues.clear();
+	m_generation = FBXAnimation::newGeneration();
+
+	if (a_animation == nullptr)
+		return false;
+
+	if (a_animation->m_endFrame > a_animation->m_startFrame + 65535)
+	{
+		printf("Error: Animation '%s' is too long to compress!\n", a_animation->m_name.c_str());
+		return false;
+	}
+
+	m_name = a_animation->m_name;
+	m_startFrame = a_animation->m_startFrame;
+	m_endFrame = a_animation->m_endFrame;
+
+	std::vector<unsigned int> kept;
+
+	for ( unsigned int i = 0 ; i < a_animation->m_trackCount ; ++i )
+	{
+		const FBXKeyFrame* keys = a_animation->m_tracks[i].m_keyframes;
+		unsigned int keyCount = a_animation->m_tracks[i].m_keyframeCount;
+		if (keyCount == 0)
+			continue;
+
+		Track track;
+		track.boneIndex = a_animation->m_tracks[i].m_boneIndex;
+
+		// rotation
+		reduceKeys(keyCount, a_rotationTolerance, [keys](unsigned int a_key, unsigned int a_first, unsigned int a_last) {
+			glm::quat rotation = nlerp(keys[a_first].m_rotation, keys[a_last].m_rotation, keyBlend(keys, a_key, a_first, a_last));
+			return rotationError(rotation, keys[a_key].m_rotation);
+		}, kept);
+
+		track.rotation.firstKey = (unsigned int)m_keyFrames.size();
+		track.rotation.keyCount = (unsigned int)kept.size();
+		for (auto key : kept)
+		{
+			unsigned short values[3];
+			encodeRotation(glm::normalize(keys[key].m_rotation), values);
+			m_keyFrames.push_back((unsigned short)(keys[key].m_key - m_startFrame));
+			m_keyValues.insert(m_keyValues.end(), values, values + 3);
+		}
+
+		// translation
+		reduceKeys(keyCount, a_translationTolerance, [keys](unsigned int a_key, unsigned int a_first, unsigned int a_last) {
+			glm::vec3 translation = glm::mix(keys[a_first].m_translation, keys[a_last].m_translation, keyBlend(keys, a_key, a_first, a_last));
+			return glm::distance(translation, keys[a_key].m_translation);
+		}, kept);
+
+		glm::vec3 minimum(keys[kept[0]].m_translation), maximum(minimum);
+		for (auto key : kept)
+		{
+			minimum = glm::min(minimum, keys[key].m_translation);
+			maximum = glm::max(maximum, keys[key].m_translation);
+		}
+		track.translationMin = minimum;
+		track.translationExtent = maximum - minimum;
+
+		track.translation.firstKey = (unsigned int)m_keyFrames.size();
+		track.translation.keyCount = (unsigned int)kept.size();
+		for (auto key : kept)
+		{
+			m_keyFrames.push_back((unsigned short)(keys[key].m_key - m_startFrame));
+			for (int j = 0; j < 3; ++j)
+				m_keyValues.push_back(encodeRanged(keys[key].m_translation[j], minimum[j], track.translationExtent[j]));
+		}
+
+		// scale, dropped altogether if it stays at 1
+		reduceKeys(keyCount, a_scaleTolerance, [keys](unsigned int a_key, unsigned int a_first, unsigned int a_last) {
+			glm::vec3 scale = glm::mix(keys[a_first].m_scale, keys[a_last].m_scale, keyBlend(keys, a_key, a_first, a_last));
+			return glm::distance(scale, keys[a_key].m_scale);
+		}, kept);
+
+		if (kept.size() == 1 &&
+			glm::distance(keys[0].m_scale, glm::vec3(1)) <= a_scaleTolerance)
+			kept.clear();
+
+		minimum = maximum = kept.empty() ? glm::vec3(1) : keys[kept[0]].m_scale;
+		for (auto key : kept)
+		{
+			minimum = glm::min(minimum, keys[key].m_scale);
+			maximum = glm::max(maximum, keys[key].m_scale);
+		}
+		track.scaleMin = minimum;
+		track.scaleExtent = maximum - minimum;
+
+		track.scale.firstKey = (unsigned int)m_keyFrames.size();
+		track.scale.keyCount = (unsigned int)kept.size();
+		for (auto key : kept)
+		{
+			m_keyFrames.push_back((unsigned short)(keys[key].m_key - m_startFrame));
+			for (int j = 0; j < 3; ++j)
+				m_keyValues.push_back(encodeRanged(keys[key].m_scale[j], minimum[j], track.scaleExtent[j]));
+		}
+
+		m_tracks.push_back(track);
+	}
+
+	return true;
+}
+
+size_t FBXCompressedAnimation::memoryUsage() const
+{
+	return m_tracks.size() * sizeof(Track) +
+		m_keyFrames.size() * sizeof(unsigned short) +
+		m_keyValues.size() * sizeof(unsigned short);
+}
+
+// the keys of a channel either side of a_frame, and how far between them it is
+static void sampleChannel(const FBXCompressedAnimation::Channel& a_channel, const unsigned short* a_frames, float a_frame,
+	unsigned int& a_cursor, unsigned int& a_start, unsigned int& a_end, float& a_blend)
+{
+	a_start = a_end = a_channel.firstKey;
+	a_blend = 0;
+	if (a_channel.keyCount < 2)
+		return;
+
+	const unsigned short* frames = a_frames + a_channel.firstKey;
+	unsigned int key = findKey(frames, a_channel.keyCount, a_frame, a_cursor);
+	a_cursor = key;
+
+	a_start = a_channel.firstKey + key;
+	a_end = a_start + 1;
+	a_blend = glm::clamp((a_frame - frames[key]) / (float)(frames[key + 1] - frames[key]), 0.0f, 1.0f);
+}
+
+void FBXPose::sample(const FBXCompressedAnimation* a_animation, float a_time, bool a_loop /* = true */, float a_FPS /* = 24.0f */)
+{
+	if (a_animation == nullptr)
+		return;
+
+	// keys are stored relative to the start frame
+	float frame = animationFrame(a_animation->m_startFrame, a_animation->m_endFrame, a_time, a_loop, a_FPS) - a_animation->m_startFrame;
+
+	if (m_cursorGeneration != a_animation->m_generation)
+	{
+		m_cursorGeneration = a_animation->m_generation;
+		m_keyCursors.assign(a_animation->m_tracks.size() * 3, 0);
+	}
+
+	const unsigned short* frames = a_animation->m_keyFrames.data();
+	const unsigned short* values = a_animation->m_keyValues.data();
+	unsigned int start, end;
+	float blend;
+
+	for ( unsigned int i = 0 ; i < a_animation->m_tracks.size() ; ++i )
+	{
+		const FBXCompressedAnimation::Track& track = a_animation->m_tracks[i];
+		unsigned int* cursors = &m_keyCursors[i * 3];
+		if (track.boneIndex >= m_boneCount)
+			continue;
+
+		glm::quat rotation(1, 0, 0, 0);
+		glm::vec3 translation(0), scale(1);
+
+		if (track.rotation.keyCount > 0)
+		{
+			sampleChannel(track.rotation, frames, frame, cursors[0], start, end, blend);
+			rotation = nlerp(decodeRotation(values + start * 3), decodeRotation(values + end * 3), blend);
+		}
+		if (track.translation.keyCount > 0)
+		{
+			sampleChannel(track.translation, frames, frame, cursors[1], start, end, blend);
+			translation = glm::mix(decodeRanged(values + start * 3, track.translationMin, track.translationExtent),
+								   decodeRanged(values + end * 3, track.translationMin, track.translationExtent), blend);
+		}
+		if (track.scale.keyCount > 0)
+		{
+			sampleChannel(track.scale, frames, frame, cursors[2], start, end, blend);
+			scale = glm::mix(decodeRanged(values + start * 3, track.scaleMin, track.scaleExtent),
+							 decodeRanged(values + end * 3, track.scaleMin, track.scaleExtent), blend);
+		}
+
+		m_rotations[track.boneIndex] = rotation;
+		m_translations[track.boneIndex] = glm::vec4(translation, 0);
+		m_scales[track.boneIndex] = glm::vec4(scale, 1);
+	}
+}
+
+void FBXSkeleton::evaluate(const FBXCompressedAnimation* a_animation, float a_time, bool a_loop, float a_FPS)
+{
+	if (a_animation == nullptr)
+		return;
+
+	m_pose.resize(m_boneCount);
+	m_pose.sample(a_animation, a_time, a_loop, a_FPS);
+
+	for (auto& track : a_animation->m_tracks)
+	{
+		unsigned int bone = track.boneIndex;
+		if (bone < m_boneCount)
+			composeTransform(m_pose.m_rotations[bone], glm::vec3(m_pose.m_translations[bone]), glm::vec3(m_pose.m_scales[bone]), m_nodes[bone]->m_localTransform);
+	}
+}
+
+void FBXSkeleton::computeBones(const FBXPose& a_pose, glm::mat4* a_bones) const
+{
+	if (a_pose.m_boneCount != m_boneCount)
+		return;
+
+	// local transforms, four at a time
+	unsigned int i = 0;
+#if defined(FBXFILE_SSE)
+	for ( ; i + 4 <= m_boneCount; i += 4)
+		composeTransforms(&a_pose.m_rotations[i], &a_pose.m_translations[i], &a_pose.m_scales[i], a_bones + i);
+#endif
+	for ( ; i < m_boneCount; ++i)
+		composeTransform(a_pose.m_rotations[i], glm::vec3(a_pose.m_translations[i]), glm::vec3(a_pose.m_scales[i]), a_bones[i]);
+
+	// into model space, parents always come before their children
+	for ( i = 0 ; i < m_boneCount ; ++i )
+	{
+		if ( m_parentIndex[i] != -1 )
+			multiply(a_bones[ m_parentIndex[i] ], a_bones[i], a_bones[i]);
+	}
+
+	// combine bind pose
+	for ( i = 0 ; i < m_boneCount ; ++i )
+		multiply(a_bones[i], m_bindPoses[i], a_bones[i]);
+}
+
+void FBXSkeleton::computeBones(const FBXPose* const* a_poses, glm::mat4* const* a_bones, unsigned int a_count, TaskGraph& a_tasks) const
+{
+	addRangeTasks(a_tasks, a_count, sc_skeletonsPerTask, [this, a_poses, a_bones](unsigned int first, unsigned int last){
+		for (unsigned int i = first; i < last; ++i)
+			computeBones(*a_poses[i], a_bones[i]);
+	});
+	a_tasks.wait();
+}
+
+void FBXSkeleton::updateBones(const FBXPose& a_pose)
+{
+	computeBones(a_pose, m_bones);
+}
+
+int FBXSkeleton::findBone(const char* a_name) const
+{
+	for ( unsigned int i = 0 ; i < m_boneCount ; ++i )
+	{
+		if (m_nodes[i]->m_name == a_name)
+			return (int)i;
+	}
+	return -1;
+}
+
+void FBXSkeleton::buildMask(unsigned int a_bone, std::vector<float>& a_mask, float a_weight /* = 1 */) const
+{
+	a_mask.assign(m_boneCount, 0.0f);
+	if (a_bone >= m_boneCount)
+		return;
+
+	// parents come before their children, so one pass finds every bone below
+	std::vector<bool> below(m_boneCount, false);
+	below[a_bone] = true;
+	a_mask[a_bone] = a_weight;
+	for ( unsigned int i = a_bone + 1 ; i < m_boneCount ; ++i )
+	{
+		if (m_parentIndex[i] != -1 &&
+			below[ m_parentIndex[i] ])
+		{
+			below[i] = true;
+			a_mask[i] = a_weight;
+		}
+	}
+}
+
+void FBXFile::compressAnimations(float a_rotationTolerance /* = 0.001f */, float a_translationTolerance /* = 0.001f */, float a_scaleTolerance /* = 0.001f */)
+{
+	for (auto a : m_compressedAnimations)
+		delete a.second;
+	m_compressedAnimations.clear();
+
+	std::vector<FBXCompressedAnimation*> compressed;
+	std::vector<unsigned char> succeeded(m_animations.size(), 0);
+
+	TaskGraph tasks;
+	for (auto animation : m_animations)
+	{
+		FBXCompressedAnimation* target = new FBXCompressedAnimation();
+		const FBXAnimation* source = animation.second;
+		unsigned char* result = &succeeded[compressed.size()];
+		compressed.push_back(target);
+
+		tasks.add([target, source, result, a_rotationTolerance, a_translationTolerance, a_scaleTolerance]{
+			*result = target->compress(source, a_rotationTolerance, a_translationTolerance, a_scaleTolerance) ? 1 : 0;
+		});
+	}
+	tasks.wait();
+
+	for (unsigned int i = 0; i < compressed.size(); ++i)
+	{
+		if (succeeded[i])
+			m_compressedAnimations[ compressed[i]->m_name ] = compressed[i];
+		else
+			delete compressed[i];
+	}
+}
@@ -0,0 +1,141 @@
+#include "FBXFile.h"
+#include <stdio.h>
+#include <chrono>
+
+FBXLoadHandle* FBXFile::loadAsync(const char* a_filename, UNIT_SCALE a_scale /* = FBXFile::UNITS_METER */,
+	bool a_loadTextures /* = true */, bool a_loadAnimations /* = true */, bool a_flipTextureY /*= true*/)
+{
+	if (m_root != nullptr ||
+		m_loadHandle != nullptr)
+	{
+		printf("Scene already loaded!\n");
+		return nullptr;
+	}
+
+	m_loadHandle = new FBXLoadHandle(this);
+
+	std::string filename = a_filename;
+	FBXLoadHandle* handle = m_loadHandle;
+	handle->m_thread = new std::thread([this, handle, filename, a_scale, a_loadTextures, a_loadAnimations, a_flipTextureY]{
+		handle->m_succeeded = load(filename.c_str(), a_scale, a_loadTextures, a_loadAnimations, a_flipTextureY);
+		handle->m_finished = true;
+	});
+
+	return m_loadHandle;
+}
+
+FBXLoadHandle::FBXLoadHandle(FBXFile* a_file)
+	: m_file(a_file),
+	m_thread(nullptr),
+	m_state(LOADING),
+	m_hierarchyReady(false),
+	m_finished(false),
+	m_succeeded(false)
+{
+}
+
+FBXLoadHandle::~FBXLoadHandle()
+{
+}
+
+void FBXLoadHandle::publish(ITEM_TYPE a_type, void* a_object)
+{
+	Item item = { a_type, a_object };
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_published.push_back(item);
+}
+
+bool FBXLoadHandle::update(float a_budgetSeconds /* = 0.004f */)
+{
+	if (m_state != LOADING)
+		return m_state == READY;
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// read the flags before taking the items, so that nothing published before them is missed
+	bool finished = m_finished;
+	bool hierarchyReady = m_hierarchyReady || finished;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (auto& item : m_published)
+		{
+			if (item.type == ITEM_MESH &&
+				hierarchyReady == false)
+				m_waitingMeshes.push_back(item);
+			else
+				m_queue.push_back(item);
+		}
+		m_published.clear();
+	}
+
+	if (hierarchyReady &&
+		m_waitingMeshes.empty() == false)
+	{
+		m_queue.insert(m_queue.end(), m_waitingMeshes.begin(), m_waitingMeshes.end());
+		m_waitingMeshes.clear();
+	}
+
+	// hand items over until the budget runs out, always managing at least one
+	while (m_queue.empty() == false)
+	{
+		Item item = m_queue.front();
+		m_queue.pop_front();
+
+		switch (item.type)
+		{
+		case ITEM_MESH:
+			{
+				// the scene's transforms are only updated once it's ready, so walk up the parents
+				FBXMeshNode* mesh = (FBXMeshNode*)item.object;
+				mesh->m_globalTransform = mesh->m_localTransform;
+				for (FBXNode* parent = mesh->m_parent; parent != nullptr; parent = parent->m_parent)
+					mesh->m_globalTransform = parent->m_localTransform * mesh->m_globalTransform;
+
+				if (m_onMeshReady)
+					m_onMeshReady(mesh);
+			}
+			break;
+		case ITEM_MATERIAL:
+			if (m_onMaterialReady)
+				m_onMaterialReady((FBXMaterial*)item.object);
+			break;
+		case ITEM_TEXTURE:
+			{
+				FBXTexture* texture = (FBXTexture*)item.object;
+				FBXFile::initialiseOpenGLTexture(texture);
+
+				if (m_onTextureReady)
+					m_onTextureReady(texture);
+			}
+			break;
+		}
+
+		std::chrono::duration<float> elapsed = std::chrono::high_resolution_clock::now() - start;
+		if (elapsed.count() >= a_budgetSeconds)
+			break;
+	}
+
+	if (finished &&
+		m_queue.empty() &&
+		m_waitingMeshes.empty())
+	{
+		m_thread->join();
+		delete m_thread;
+		m_thread = nullptr;
+
+		if (m_succeeded &&
+			m_file->m_root != nullptr)
+		{
+			m_file->m_root->updateGlobalTransform();
+			m_state = READY;
+		}
+		else
+		{
+			m_state = FAILED;
+		}
+	}
+
+	return m_state == READY;
+}
@@ -0,0 +1,628 @@
+#include "FBXFile.h"
+#include "FileView.h"
+#include <stdio.h>
+#include <string.h>
+
+// a baked file is a header followed by tables of fixed-size records and the arrays they refer to
+// every table and array starts on a 16 byte boundary so that the file can be mapped and read in
+// place; records refer to arrays by offsets from the start of the file, to strings by offsets
+// into the string table, and to other records by index, which loadBaked() fixes up into pointers
+// vertices and keyframes are stored exactly as they are in memory, so bump the version whenever
+// a record, FBXVertex or FBXKeyFrame changes
+static const unsigned int sc_bakedMagic = 0x42584246;	// "FBXB"
+static const unsigned int sc_bakedVersion = 1;
+static const size_t sc_bakedAlignment = 16;
+
+struct BakedHeader
+{
+	unsigned int		magic;
+	unsigned int		version;
+	unsigned int		vertexSize;
+	unsigned int		keyFrameSize;
+
+	glm::vec4			ambientLight;
+
+	unsigned int		nodeCount;
+	unsigned int		meshCount;
+	unsigned int		materialCount;
+	unsigned int		textureCount;
+	unsigned int		skeletonCount;
+	unsigned int		animationCount;
+	unsigned int		stringsSize;
+	unsigned int		padding;
+
+	unsigned long long	nodes;			// BakedNode[nodeCount], parents before children, root first
+	unsigned long long	meshes;			// node index[meshCount], in the scene's mesh order
+	unsigned long long	materials;		// BakedMaterial[materialCount]
+	unsigned long long	textures;		// string offset[textureCount], the texture filenames
+	unsigned long long	skeletons;		// BakedSkeleton[skeletonCount]
+	unsigned long long	animations;		// BakedAnimation[animationCount]
+	unsigned long long	strings;		// null-terminated strings, starting with an empty one
+};
+
+struct BakedNode
+{
+	unsigned int		type;
+	unsigned int		name;
+	int					parent;			// -1 for the root
+	int					material;		// -1 if none
+
+	glm::mat4			localTransform;
+
+	// mesh nodes
+	unsigned int		vertexAttributes;
+	unsigned int		vertexCount;
+	unsigned int		indexCount;
+	unsigned int		padding;
+	unsigned long long	vertices;		// FBXVertex[vertexCount]
+	unsigned long long	indices;		// unsigned int[indexCount]
+
+	// light nodes
+	unsigned int		lightType;
+	unsigned int		on;
+	glm::vec4			colour;
+	glm::vec4			attenuation;
+	float				innerAngle;
+	float				outerAngle;
+
+	// camera nodes
+	float				fieldOfView;
+	float				aspectRatio;
+	float				nearPlane;
+	float				farPlane;
+};
+
+struct BakedMaterial
+{
+	unsigned int		name;
+	int					textures[FBXMaterial::TextureTypes_Count];	// -1 if none
+
+	glm::vec4			ambient;
+	glm::vec4			diffuse;
+	glm::vec4			specular;
+	glm::vec4			emissive;
+
+	glm::vec2			textureOffsets[FBXMaterial::TextureTypes_Count];
+	glm::vec2			textureTiling[FBXMaterial::TextureTypes_Count];
+	float				textureRotation[FBXMaterial::TextureTypes_Count];
+};
+
+struct BakedSkeleton
+{
+	unsigned int		boneCount;
+	unsigned int		padding;
+	unsigned long long	nodes;			// node index[boneCount]
+	unsigned long long	parents;		// int[boneCount], -1 for none
+	unsigned long long	bindPoses;		// glm::mat4[boneCount]
+};
+
+struct BakedAnimation
+{
+	unsigned int		name;
+	unsigned int		startFrame;
+	unsigned int		endFrame;
+	unsigned int		trackCount;
+	unsigned long long	tracks;			// BakedTrack[trackCount]
+};
+
+struct BakedTrack
+{
+	unsigned int		boneIndex;
+	unsigned int		keyframeCount;
+	unsigned long long	keyframes;		// FBXKeyFrame[keyframeCount]
+};
+
+// appends aligned data to the file being written, returning its offset
+static unsigned long long bakeData(std::vector<unsigned char>& a_file, const void* a_data, size_t a_size)
+{
+	size_t offset = (a_file.size() + sc_bakedAlignment - 1) & ~(sc_bakedAlignment - 1);
+	a_file.resize(offset + a_size);
+	if (a_size > 0)
+		memcpy(&a_file[offset], a_data, a_size);
+	return offset;
+}
+
+template <typename T>
+static unsigned long long bakeArray(std::vector<unsigned char>& a_file, const std::vector<T>& a_array)
+{
+	return bakeData(a_file, a_array.empty() ? nullptr : &a_array[0], a_array.size() * sizeof(T));
+}
+
+static unsigned int bakeString(std::string& a_strings, const std::string& a_string)
+{
+	if (a_string.empty())
+		return 0;
+
+	unsigned int offset = (unsigned int)a_strings.size();
+	a_strings.append(a_string.c_str(), a_string.size() + 1);
+	return offset;
+}
+
+// lists nodes with parents before their children
+static void gatherNodes(FBXNode* a_node, std::vector<FBXNode*>& a_nodes, std::map<const FBXNode*,int>& a_indices)
+{
+	a_indices[a_node] = (int)a_nodes.size();
+	a_nodes.push_back(a_node);
+	for (auto child : a_node->m_children)
+		gatherNodes(child, a_nodes, a_indices);
+}
+
+bool FBXFile::save(const char* a_filename) const
+{
+	if (m_root == nullptr)
+	{
+		printf("Error: No scene loaded to save to '%s'!\n", a_filename);
+		return false;
+	}
+
+	std::vector<unsigned char> file;
+	std::string strings(1, '\0');
+
+	BakedHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = sc_bakedMagic;
+	header.version = sc_bakedVersion;
+	header.vertexSize = sizeof(FBXVertex);
+	header.keyFrameSize = sizeof(FBXKeyFrame);
+	header.ambientLight = m_ambientLight;
+	bakeData(file, &header, sizeof(header));
+
+	// textures
+	std::map<const FBXTexture*,int> textureIndices;
+	std::vector<unsigned int> textures;
+	for (auto& texture : m_textures)
+	{
+		textureIndices[texture.second] = (int)textures.size();
+		textures.push_back(bakeString(strings, texture.second->name));
+	}
+	header.textureCount = (unsigned int)textures.size();
+	header.textures = bakeArray(file, textures);
+
+	// materials
+	std::map<const FBXMaterial*,int> materialIndices;
+	std::vector<BakedMaterial> materials;
+	for (auto& material : m_materials)
+	{
+		const FBXMaterial* source = material.second;
+		materialIndices[source] = (int)materials.size();
+
+		BakedMaterial baked;
+		memset(&baked, 0, sizeof(baked));
+		baked.name = bakeString(strings, source->name);
+		baked.ambient = source->ambient;
+		baked.diffuse = source->diffuse;
+		baked.specular = source->specular;
+		baked.emissive = source->emissive;
+		for (unsigned int i = 0; i < FBXMaterial::TextureTypes_Count; ++i)
+		{
+			auto iter = textureIndices.find(source->textures[i]);
+			baked.textures[i] = iter != textureIndices.end() ? iter->second : -1;
+			baked.textureOffsets[i] = source->textureOffsets[i];
+			baked.textureTiling[i] = source->textureTiling[i];
+			baked.textureRotation[i] = source->textureRotation[i];
+		}
+		materials.push_back(baked);
+	}
+	header.materialCount = (unsigned int)materials.size();
+	header.materials = bakeArray(file, materials);
+
+	// nodes, with each mesh's vertices and indices ahead of the node table
+	std::vector<FBXNode*> nodes;
+	std::map<const FBXNode*,int> nodeIndices;
+	gatherNodes(m_root, nodes, nodeIndices);
+
+	std::vector<BakedNode> bakedNodes(nodes.size());
+	for (unsigned int i = 0; i < nodes.size(); ++i)
+	{
+		const FBXNode* node = nodes[i];
+		BakedNode& baked = bakedNodes[i];
+		memset(&baked, 0, sizeof(baked));
+
+		baked.type = node->m_nodeType;
+		baked.name = bakeString(strings, node->m_name);
+		baked.parent = node->m_parent != nullptr ? nodeIndices[node->m_parent] : -1;
+		baked.material = -1;
+		baked.localTransform = node->m_localTransform;
+
+		switch (node->m_nodeType)
+		{
+		case FBXNode::MESH:
+			{
+				const FBXMeshNode* mesh = (const FBXMeshNode*)node;
+				auto iter = materialIndices.find(mesh->m_material);
+				baked.material = iter != materialIndices.end() ? iter->second : -1;
+				baked.vertexAttributes = mesh->m_vertexAttributes;
+				baked.vertexCount = (unsigned int)mesh->m_vertices.size();
+				baked.indexCount = (unsigned int)mesh->m_indices.size();
+				baked.vertices = bakeArray(file, mesh->m_vertices);
+				baked.indices = bakeArray(file, mesh->m_indices);
+			}
+			break;
+		case FBXNode::LIGHT:
+			{
+				const FBXLightNode* light = (const FBXLightNode*)node;
+				baked.lightType = light->m_type;
+				baked.on = light->m_on ? 1 : 0;
+				baked.colour = light->m_colour;
+				baked.attenuation = light->m_attenuation;
+				baked.innerAngle = light->m_innerAngle;
+				baked.outerAngle = light->m_outerAngle;
+			}
+			break;
+		case FBXNode::CAMERA:
+			{
+				const FBXCameraNode* camera = (const FBXCameraNode*)node;
+				baked.fieldOfView = camera->m_fieldOfView;
+				baked.aspectRatio = camera->m_aspectRatio;
+				baked.nearPlane = camera->m_near;
+				baked.farPlane = camera->m_far;
+			}
+			break;
+		default: break;
+		}
+	}
+	header.nodeCount = (unsigned int)bakedNodes.size();
+	header.nodes = bakeArray(file, bakedNodes);
+
+	std::vector<unsigned int> meshes;
+	for (auto mesh : m_meshes)
+		meshes.push_back(nodeIndices[mesh]);
+	header.meshCount = (unsigned int)meshes.size();
+	header.meshes = bakeArray(file, meshes);
+
+	// skeletons
+	std::vector<BakedSkeleton> skeletons;
+	for (auto skeleton : m_skeletons)
+	{
+		std::vector<unsigned int> bones(skeleton->m_boneCount);
+		for (unsigned int i = 0; i < skeleton->m_boneCount; ++i)
+			bones[i] = nodeIndices[ skeleton->m_nodes[i] ];
+
+		BakedSkeleton baked;
+		memset(&baked, 0, sizeof(baked));
+		baked.boneCount = skeleton->m_boneCount;
+		baked.nodes = bakeArray(file, bones);
+		baked.parents = bakeData(file, skeleton->m_parentIndex, skeleton->m_boneCount * sizeof(int));
+		baked.bindPoses = bakeData(file, skeleton->m_bindPoses, skeleton->m_boneCount * sizeof(glm::mat4));
+		skeletons.push_back(baked);
+	}
+	header.skeletonCount = (unsigned int)skeletons.size();
+	header.skeletons = bakeArray(file, skeletons);
+
+	// animations
+	std::vector<BakedAnimation> animations;
+	for (auto& animation : m_animations)
+	{
+		const FBXAnimation* source = animation.second;
+
+		std::vector<BakedTrack> tracks(source->m_trackCount);
+		for (unsigned int i = 0; i < source->m_trackCount; ++i)
+		{
+			tracks[i].boneIndex = source->m_tracks[i].m_boneIndex;
+			tracks[i].keyframeCount = source->m_tracks[i].m_keyframeCount;
+			tracks[i].keyframes = bakeData(file, source->m_tracks[i].m_keyframes, source->m_tracks[i].m_keyframeCount * sizeof(FBXKeyFrame));
+		}
+
+		BakedAnimation baked;
+		memset(&baked, 0, sizeof(baked));
+		baked.name = bakeString(strings, source->m_name);
+		baked.startFrame = source->m_startFrame;
+		baked.endFrame = source->m_endFrame;
+		baked.trackCount = source->m_trackCount;
+		baked.tracks = bakeArray(file, tracks);
+		animations.push_back(baked);
+	}
+	header.animationCount = (unsigned int)animations.size();
+	header.animations = bakeArray(file, animations);
+
+	header.stringsSize = (unsigned int)strings.size();
+	header.strings = bakeData(file, strings.data(), strings.size());
+
+	memcpy(&file[0], &header, sizeof(header));
+
+	FILE* output = fopen(a_filename, "wb");
+	if (output == nullptr)
+	{
+		printf("Error: Unable to open file '%s' for writing!\n", a_filename);
+		return false;
+	}
+
+	bool written = fwrite(&file[0], 1, file.size(), output) == file.size();
+	fclose(output);
+
+	if (written == false)
+		printf("Error: Unable to write baked file '%s'!\n", a_filename);
+	return written;
+}
+
+// checks that an array lies within the file and is aligned, returning nullptr if it doesn't
+template <typename T>
+static const T* bakedArray(const FileView& a_file, unsigned long long a_offset, unsigned long long a_count)
+{
+	if (a_offset % sc_bakedAlignment != 0 ||
+		a_offset > a_file.size() ||
+		a_count > (a_file.size() - a_offset) / sizeof(T))
+		return nullptr;
+
+	return (const T*)(a_file.data() + a_offset);
+}
+
+bool FBXFile::loadBaked(const char* a_filename, bool a_loadTextures /* = true */)
+{
+	if (m_root != nullptr)
+	{
+		printf("Scene already loaded!\n");
+		return false;
+	}
+
+	FileView file(a_filename);
+	if (file.isOpen() == false)
+		return false;
+
+	const BakedHeader* header = bakedArray<BakedHeader>(file, 0, 1);
+	if (header == nullptr ||
+		header->magic != sc_bakedMagic)
+	{
+		printf("Error: '%s' is not a baked FBX file!\n", a_filename);
+		return false;
+	}
+	if (header->version != sc_bakedVersion ||
+		header->vertexSize != sizeof(FBXVertex) ||
+		header->keyFrameSize != sizeof(FBXKeyFrame))
+	{
+		printf("Error: '%s' was baked by a different version, bake it again!\n", a_filename);
+		return false;
+	}
+
+	const BakedNode* nodes = bakedArray<BakedNode>(file, header->nodes, header->nodeCount);
+	const unsigned int* meshes = bakedArray<unsigned int>(file, header->meshes, header->meshCount);
+	const BakedMaterial* materials = bakedArray<BakedMaterial>(file, header->materials, header->materialCount);
+	const unsigned int* textures = bakedArray<unsigned int>(file, header->textures, header->textureCount);
+	const BakedSkeleton* skeletons = bakedArray<BakedSkeleton>(file, header->skeletons, header->skeletonCount);
+	const BakedAnimation* animations = bakedArray<BakedAnimation>(file, header->animations, header->animationCount);
+	const char* strings = bakedArray<char>(file, header->strings, header->stringsSize);
+
+	bool valid = nodes != nullptr && meshes != nullptr && materials != nullptr && textures != nullptr &&
+				 skeletons != nullptr && animations != nullptr && strings != nullptr &&
+				 header->nodeCount > 0 && nodes[0].parent == -1 &&
+				 header->stringsSize > 0 && strings[ header->stringsSize - 1 ] == 0;
+
+	auto string = [&](unsigned int a_offset) { return a_offset < header->stringsSize ? strings + a_offset : ""; };
+
+	// the folder path of the scene, for textures
+	m_path = a_filename;
+	size_t lastSlash = m_path.find_last_of("/\\");
+	m_path.resize(lastSlash != std::string::npos ? lastSlash + 1 : 0);
+	m_ambientLight = header->ambientLight;
+
+	// textures
+	std::vector<FBXTexture*> textureList(header->textureCount, nullptr);
+	for (unsigned int i = 0; valid && a_loadTextures && i < header->textureCount; ++i)
+	{
+		FBXTexture* texture = new FBXTexture();
+		texture->name = string(textures[i]);
+		texture->path = m_path + texture->name;
+		m_textures[ texture->path ] = texture;
+		textureList[i] = texture;
+	}
+
+	// materials
+	std::vector<FBXMaterial*> materialList(header->materialCount, nullptr);
+	for (unsigned int i = 0; valid && i < header->materialCount; ++i)
+	{
+		const BakedMaterial& baked = materials[i];
+
+		FBXMaterial* material = new FBXMaterial();
+		material->name = string(baked.name);
+		m_materials[ material->name ] = material;
+		materialList[i] = material;
+
+		material->ambient = baked.ambient;
+		material->diffuse = baked.diffuse;
+		material->specular = baked.specular;
+		material->emissive = baked.emissive;
+		for (unsigned int j = 0; j < FBXMaterial::TextureTypes_Count; ++j)
+		{
+			if (baked.textures[j] >= (int)header->textureCount)
+				valid = false;
+			else if (baked.textures[j] >= 0)
+				material->textures[j] = textureList[ baked.textures[j] ];
+			material->textureOffsets[j] = baked.textureOffsets[j];
+			material->textureTiling[j] = baked.textureTiling[j];
+			material->textureRotation[j] = baked.textureRotation[j];
+		}
+	}
+
+	// nodes, each attached to its parent as soon as it's created so that unload() cleans up after a failure
+	std::vector<FBXNode*> nodeList(header->nodeCount, nullptr);
+	for (unsigned int i = 0; valid && i < header->nodeCount; ++i)
+	{
+		const BakedNode& baked = nodes[i];
+		if ((i > 0 && (baked.parent < 0 || baked.parent >= (int)i)) ||
+			baked.material >= (int)header->materialCount)
+		{
+			valid = false;
+			break;
+		}
+
+		FBXNode* node = nullptr;
+		switch (baked.type)
+		{
+		case FBXNode::MESH:
+			{
+				const FBXVertex* vertices = bakedArray<FBXVertex>(file, baked.vertices, baked.vertexCount);
+				const unsigned int* indices = bakedArray<unsigned int>(file, baked.indices, baked.indexCount);
+				if (vertices == nullptr ||
+					indices == nullptr)
+				{
+					valid = false;
+					break;
+				}
+
+				FBXMeshNode* mesh = new FBXMeshNode();
+				mesh->m_vertexAttributes = baked.vertexAttributes;
+				mesh->m_material = baked.material >= 0 ? materialList[ baked.material ] : nullptr;
+				mesh->m_vertices.assign(vertices, vertices + baked.vertexCount);
+				mesh->m_indices.assign(indices, indices + baked.indexCount);
+				node = mesh;
+			}
+			break;
+		case FBXNode::LIGHT:
+			{
+				FBXLightNode* light = new FBXLightNode();
+				light->m_type = (FBXLightNode::LightType)baked.lightType;
+				light->m_on = baked.on != 0;
+				light->m_colour = baked.colour;
+				light->m_attenuation = baked.attenuation;
+				light->m_innerAngle = baked.innerAngle;
+				light->m_outerAngle = baked.outerAngle;
+				node = light;
+			}
+			break;
+		case FBXNode::CAMERA:
+			{
+				FBXCameraNode* camera = new FBXCameraNode();
+				camera->m_fieldOfView = baked.fieldOfView;
+				camera->m_aspectRatio = baked.aspectRatio;
+				camera->m_near = baked.nearPlane;
+				camera->m_far = baked.farPlane;
+				node = camera;
+			}
+			break;
+		default:
+			node = new FBXNode();
+			break;
+		}
+		if (node == nullptr)
+			break;
+
+		node->m_name = string(baked.name);
+		node->m_localTransform = baked.localTransform;
+		nodeList[i] = node;
+
+		if (i == 0)
+		{
+			m_root = node;
+		}
+		else
+		{
+			node->m_parent = nodeList[ baked.parent ];
+			node->m_parent->m_children.push_back(node);
+		}
+
+		if (baked.type == FBXNode::LIGHT)
+			m_lights[ node->m_name ] = (FBXLightNode*)node;
+		else if (baked.type == FBXNode::CAMERA)
+			m_cameras[ node->m_name ] = (FBXCameraNode*)node;
+	}
+
+	for (unsigned int i = 0; valid && i < header->meshCount; ++i)
+	{
+		if (meshes[i] >= header->nodeCount ||
+			nodes[ meshes[i] ].type != FBXNode::MESH)
+			valid = false;
+		else
+			m_meshes.push_back((FBXMeshNode*)nodeList[ meshes[i] ]);
+	}
+
+	// skeletons
+	for (unsigned int i = 0; valid && i < header->skeletonCount; ++i)
+	{
+		const BakedSkeleton& baked = skeletons[i];
+		const unsigned int* bones = bakedArray<unsigned int>(file, baked.nodes, baked.boneCount);
+		const int* parents = bakedArray<int>(file, baked.parents, baked.boneCount);
+		const glm::mat4* bindPoses = bakedArray<glm::mat4>(file, baked.bindPoses, baked.boneCount);
+		if (bones == nullptr ||
+			parents == nullptr ||
+			bindPoses == nullptr)
+		{
+			valid = false;
+			break;
+		}
+
+		FBXSkeleton* skeleton = new FBXSkeleton();
+		m_skeletons.push_back(skeleton);
+
+		skeleton->m_boneCount = baked.boneCount;
+		skeleton->m_nodes = new FBXNode * [ baked.boneCount ];
+		skeleton->m_parentIndex = new int[ baked.boneCount ];
+		skeleton->m_bones = new glm::mat4[ baked.boneCount ];
+		skeleton->m_bindPoses = new glm::mat4[ baked.boneCount ];
+
+		// parents always come before their children, so bones can be updated in order
+		for (unsigned int j = 0; j < baked.boneCount; ++j)
+		{
+			if (bones[j] >= header->nodeCount ||
+				parents[j] < -1 ||
+				parents[j] >= (int)j)
+			{
+				valid = false;
+				break;
+			}
+			skeleton->m_nodes[j] = nodeList[ bones[j] ];
+			skeleton->m_parentIndex[j] = parents[j];
+			skeleton->m_bones[j] = skeleton->m_nodes[j]->m_localTransform;
+		}
+		memcpy(skeleton->m_bindPoses, bindPoses, baked.boneCount * sizeof(glm::mat4));
+	}
+
+	// tracks index the bones of the file's skeletons
+	unsigned int boneCount = 0;
+	for (unsigned int i = 0; valid && i < header->skeletonCount; ++i)
+		boneCount = glm::max(boneCount, skeletons[i].boneCount);
+
+	// animations
+	for (unsigned int i = 0; valid && i < header->animationCount; ++i)
+	{
+		const BakedAnimation& baked = animations[i];
+		const BakedTrack* tracks = bakedArray<BakedTrack>(file, baked.tracks, baked.trackCount);
+		if (tracks == nullptr)
+		{
+			valid = false;
+			break;
+		}
+
+		FBXAnimation* animation = new FBXAnimation();
+		animation->m_name = string(baked.name);
+		animation->m_startFrame = baked.startFrame;
+		animation->m_endFrame = baked.endFrame;
+		animation->m_trackCount = baked.trackCount;
+		animation->m_tracks = new FBXTrack[ baked.trackCount ];
+		m_animations[ animation->m_name ] = animation;
+
+		for (unsigned int j = 0; j < baked.trackCount; ++j)
+		{
+			const FBXKeyFrame* keyframes = bakedArray<FBXKeyFrame>(file, tracks[j].keyframes, tracks[j].keyframeCount);
+			if (keyframes == nullptr ||
+				tracks[j].boneIndex >= boneCount)
+			{
+				valid = false;
+				break;
+			}
+
+			FBXTrack& track = animation->m_tracks[j];
+			track.m_boneIndex = tracks[j].boneIndex;
+			track.m_keyframeCount = tracks[j].keyframeCount;
+			track.m_keyframes = new FBXKeyFrame[ track.m_keyframeCount ];
+			memcpy(track.m_keyframes, keyframes, track.m_keyframeCount * sizeof(FBXKeyFrame));
+		}
+
+		animation->buildKeyStreams();
+	}
+
+	if (valid == false)
+	{
+		printf("Error: Baked FBX file '%s' is corrupt!\n", a_filename);
+
+		// materials and textures that were created but not yet stored are owned by the maps
+		unload();
+		return false;
+	}
+
+	m_root->updateGlobalTransform();
+
+	if (a_loadTextures)
+		loadTextureData();
+
+	return true;
+}
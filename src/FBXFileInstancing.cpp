@@ -0,0 +1,127 @@
+#include "FBXFile.h"
+#include "FBXFileInternal.h"
+#include <GL/glew.h>
+#include <stdio.h>
+#include <string.h>
+
+FBXSkeletonInstance::FBXSkeletonInstance(const FBXSkeleton* a_skeleton)
+	: m_skeleton(a_skeleton),
+	m_bones(a_skeleton->m_boneCount),
+	m_transform(1),
+	m_userData(nullptr)
+{
+	m_pose.reset(a_skeleton);
+}
+
+void FBXSkeletonInstance::evaluate(const FBXAnimation* a_animation, float a_time, bool a_loop /* = true */, float a_fps /* = 24.0f */)
+{
+	m_pose.sample(a_animation, a_time, a_loop, a_fps);
+}
+
+void FBXSkeletonInstance::evaluate(const FBXCompressedAnimation* a_animation, float a_time, bool a_loop /* = true */, float a_fps /* = 24.0f */)
+{
+	m_pose.sample(a_animation, a_time, a_loop, a_fps);
+}
+
+void FBXSkeletonInstance::updateBones()
+{
+	m_skeleton->computeBones(m_pose, m_bones.data());
+}
+
+void FBXSkeletonInstance::updateBones(FBXSkeletonInstance* const* a_instances, unsigned int a_count, TaskGraph& a_tasks)
+{
+	addRangeTasks(a_tasks, a_count, sc_skeletonsPerTask, [a_instances](unsigned int first, unsigned int last){
+		for (unsigned int i = first; i < last; ++i)
+			a_instances[i]->updateBones();
+	});
+	a_tasks.wait();
+}
+
+FBXBonePalette::FBXBonePalette()
+	: m_buffer(0),
+	m_texture(0),
+	m_capacity(0),
+	m_boneCount(0),
+	m_instanceCount(0)
+{
+}
+
+FBXBonePalette::~FBXBonePalette()
+{
+	destroy();
+}
+
+void FBXBonePalette::upload(const FBXSkeletonInstance* const* a_instances, unsigned int a_count)
+{
+	m_instanceCount = a_count;
+	m_boneCount = 0;
+	for (unsigned int i = 0; i < a_count; ++i)
+		m_boneCount = glm::max(m_boneCount, (unsigned int)a_instances[i]->m_bones.size());
+
+	// each instance's transform, then its bones
+	unsigned int stride = m_boneCount + 1;
+	unsigned int size = stride * a_count;
+	if (size == 0)
+		return;
+
+	if (m_buffer == 0)
+	{
+		glGenBuffers(1, &m_buffer);
+		glGenTextures(1, &m_texture);
+	}
+
+	glBindBuffer(GL_TEXTURE_BUFFER, m_buffer);
+
+	// grow by half again so a crowd that's slowly growing doesn't reallocate every frame,
+	// otherwise orphan the old contents so that the GPU can still be reading them
+	if (size > m_capacity)
+	{
+		m_capacity = size + size / 2;
+		glBufferData(GL_TEXTURE_BUFFER, m_capacity * sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+
+		glBindTexture(GL_TEXTURE_BUFFER, m_texture);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_buffer);
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+	}
+
+	glm::mat4* bones = (glm::mat4*)glMapBufferRange(GL_TEXTURE_BUFFER, 0, size * sizeof(glm::mat4), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (bones == nullptr)
+	{
+		printf("Error: Failed to map bone palette!\n");
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+		return;
+	}
+
+	for (unsigned int i = 0; i < a_count; ++i)
+	{
+		const FBXSkeletonInstance* instance = a_instances[i];
+		glm::mat4* palette = bones + i * stride;
+		palette[0] = instance->m_transform;
+		memcpy(palette + 1, instance->m_bones.data(), instance->m_bones.size() * sizeof(glm::mat4));
+	}
+
+	glUnmapBuffer(GL_TEXTURE_BUFFER);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void FBXBonePalette::bind(unsigned int a_textureUnit) const
+{
+	glActiveTexture(GL_TEXTURE0 + a_textureUnit);
+	glBindTexture(GL_TEXTURE_BUFFER, m_texture);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+void FBXBonePalette::destroy()
+{
+	if (m_buffer != 0)
+	{
+		glDeleteTextures(1, &m_texture);
+		glDeleteBuffers(1, &m_buffer);
+	}
+
+	m_buffer = 0;
+	m_texture = 0;
+	m_capacity = 0;
+	m_boneCount = 0;
+	m_instanceCount = 0;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+// helpers shared by the FBXFile sources, not part of its interface
+#include "TaskGraph.h"
+#include <glm/glm.hpp>
+#include <math.h>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FBXFILE_SSE
+#include <emmintrin.h>
+#endif
+
+// how many skeletons or instances each task computes the bones of, enough to outweigh the cost of a task
+static const unsigned int sc_skeletonsPerTask = 16;
+
+inline unsigned char toUnorm8(float a_value)
+{
+	return (unsigned char)floorf(glm::clamp(a_value, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+// adds a task calling a_work(first, last) for each run of up to a_perTask of a_count items,
+// returning them so that later tasks can depend on them, or the caller can wait() for them
+template <typename WORK>
+std::vector<TaskGraph::Task> addRangeTasks(TaskGraph& a_tasks, unsigned int a_count, unsigned int a_perTask, const WORK& a_work)
+{
+	std::vector<TaskGraph::Task> tasks;
+	for (unsigned int first = 0; first < a_count; first += a_perTask)
+	{
+		unsigned int last = glm::min(first + a_perTask, a_count);
+		tasks.push_back(a_tasks.add([a_work, first, last]{ a_work(first, last); }));
+	}
+	return tasks;
+}
@@ -0,0 +1,305 @@
+#include "FBXFile.h"
+#include "TaskGraph.h"
+#include <stdio.h>
+#include <algorithm>
+
+// the post-transform cache that orders are tuned and measured for, a FIFO of this many vertices
+// (real caches vary, but orders that suit 16 hold up well on larger ones)
+static const unsigned int sc_vertexCacheSize = 16;
+
+// a cluster is split once its running ACMR comes within this factor of the mesh's
+static const float sc_overdrawThreshold = 1.05f;
+
+// the average number of vertices transformed per triangle, for a FIFO cache
+static float calculateACMR(const std::vector<unsigned int>& a_indices, unsigned int a_vertexCount)
+{
+	if (a_indices.size() < 3)
+		return 0;
+
+	std::vector<unsigned int> cacheTime(a_vertexCount, 0);
+	unsigned int time = sc_vertexCacheSize + 1;
+	unsigned int misses = 0;
+
+	for (auto index : a_indices)
+	{
+		if (time - cacheTime[index] > sc_vertexCacheSize)
+		{
+			cacheTime[index] = time++;
+			++misses;
+		}
+	}
+
+	return misses / (float)(a_indices.size() / 3);
+}
+
+// orders triangles for the vertex cache with Tipsify (Sander, Nehab & Barczak 2007), fanning around
+// one vertex at a time and moving on to whichever vertex is most likely to still be in the cache
+// the start of each run that had to restart from a dead end is added to a_clusters
+static void tipsify(std::vector<unsigned int>& a_indices, unsigned int a_vertexCount, std::vector<unsigned int>& a_clusters)
+{
+	unsigned int triangleCount = (unsigned int)a_indices.size() / 3;
+
+	// the triangles using each vertex, and how many of them are yet to be emitted
+	std::vector<unsigned int> live(a_vertexCount, 0);
+	for (auto index : a_indices)
+		++live[index];
+
+	std::vector<unsigned int> offsets(a_vertexCount + 1, 0);
+	for (unsigned int i = 0; i < a_vertexCount; ++i)
+		offsets[i + 1] = offsets[i] + live[i];
+
+	std::vector<unsigned int> adjacency(a_indices.size());
+	std::vector<unsigned int> filled(offsets.begin(), offsets.end() - 1);
+	for (unsigned int i = 0; i < a_indices.size(); ++i)
+		adjacency[ filled[ a_indices[i] ]++ ] = i / 3;
+
+	std::vector<unsigned int> cacheTime(a_vertexCount, 0);
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<unsigned int> deadEnd;
+	std::vector<unsigned int> candidates;
+	std::vector<unsigned int> output;
+	output.reserve(a_indices.size());
+	deadEnd.reserve(a_indices.size());
+
+	unsigned int time = sc_vertexCacheSize + 1;
+	unsigned int cursor = 0;
+	int fan = 0;
+	a_clusters.push_back(0);
+
+	while (fan >= 0)
+	{
+		candidates.clear();
+
+		// emit every remaining triangle around the fanning vertex
+		for (unsigned int i = offsets[fan]; i < offsets[fan + 1]; ++i)
+		{
+			unsigned int triangle = adjacency[i];
+			if (emitted[triangle])
+				continue;
+			emitted[triangle] = true;
+
+			for (unsigned int j = 0; j < 3; ++j)
+			{
+				unsigned int vertex = a_indices[triangle * 3 + j];
+				output.push_back(vertex);
+				deadEnd.push_back(vertex);
+				candidates.push_back(vertex);
+				--live[vertex];
+
+				if (time - cacheTime[vertex] > sc_vertexCacheSize)
+					cacheTime[vertex] = time++;
+			}
+		}
+
+		// pick the candidate that will still be in the cache once its remaining triangles are emitted,
+		// preferring the one that has been there longest
+		int best = -1;
+		int bestPriority = -1;
+		for (auto vertex : candidates)
+		{
+			if (live[vertex] == 0)
+				continue;
+
+			int priority = 0;
+			if (time - cacheTime[vertex] + 2 * live[vertex] <= sc_vertexCacheSize)
+				priority = time - cacheTime[vertex];
+			if (priority > bestPriority)
+			{
+				best = vertex;
+				bestPriority = priority;
+			}
+		}
+
+		// otherwise fall back on a recently used vertex, then on the next vertex with triangles left
+		if (best < 0)
+		{
+			while (best < 0 &&
+				   deadEnd.empty() == false)
+			{
+				unsigned int vertex = deadEnd.back();
+				deadEnd.pop_back();
+				if (live[vertex] > 0)
+					best = vertex;
+			}
+			while (best < 0 &&
+				   cursor < a_vertexCount)
+			{
+				if (live[cursor] > 0)
+					best = cursor;
+				++cursor;
+			}
+
+			if (best >= 0 &&
+				output.size() / 3 != a_clusters.back())
+				a_clusters.push_back((unsigned int)output.size() / 3);
+		}
+
+		fan = best;
+	}
+
+	a_indices.swap(output);
+}
+
+// splits each cluster where its ACMR so far is close to the mesh's, so that there are enough
+// clusters to sort without costing much in cache misses
+static void splitClusters(const std::vector<unsigned int>& a_indices, unsigned int a_vertexCount, std::vector<unsigned int>& a_clusters)
+{
+	float threshold = calculateACMR(a_indices, a_vertexCount) * sc_overdrawThreshold;
+	unsigned int triangleCount = (unsigned int)a_indices.size() / 3;
+
+	std::vector<unsigned int> cacheTime(a_vertexCount, 0);
+	unsigned int time = sc_vertexCacheSize + 1;
+
+	std::vector<unsigned int> clusters;
+	for (unsigned int i = 0; i < a_clusters.size(); ++i)
+	{
+		unsigned int start = a_clusters[i];
+		unsigned int end = i + 1 < a_clusters.size() ? a_clusters[i + 1] : triangleCount;
+
+		// each cluster starts with a cold cache, as it may end up drawn after any other
+		time += sc_vertexCacheSize + 1;
+		clusters.push_back(start);
+
+		unsigned int misses = 0;
+		for (unsigned int triangle = start; triangle < end; ++triangle)
+		{
+			for (unsigned int j = 0; j < 3; ++j)
+			{
+				unsigned int vertex = a_indices[triangle * 3 + j];
+				if (time - cacheTime[vertex] > sc_vertexCacheSize)
+				{
+					cacheTime[vertex] = time++;
+					++misses;
+				}
+			}
+
+			unsigned int size = triangle + 1 - clusters.back();
+			if (triangle + 1 < end &&
+				misses <= threshold * size)
+			{
+				clusters.push_back(triangle + 1);
+				time += sc_vertexCacheSize + 1;
+				misses = 0;
+			}
+		}
+	}
+
+	a_clusters.swap(clusters);
+}
+
+// sorts clusters so that those facing out from the middle of the mesh are drawn first
+// (the linear-speed overdraw ordering from the Tipsify paper)
+static void sortClusters(std::vector<unsigned int>& a_indices, const std::vector<FBXVertex>& a_vertices, const std::vector<unsigned int>& a_clusters)
+{
+	unsigned int triangleCount = (unsigned int)a_indices.size() / 3;
+
+	glm::vec3 meshCentre(0);
+	for (auto& vertex : a_vertices)
+		meshCentre += glm::vec3(vertex.position);
+	meshCentre /= (float)a_vertices.size();
+
+	std::vector<std::pair<float,unsigned int>> order(a_clusters.size());
+	for (unsigned int i = 0; i < a_clusters.size(); ++i)
+	{
+		unsigned int start = a_clusters[i];
+		unsigned int end = i + 1 < a_clusters.size() ? a_clusters[i + 1] : triangleCount;
+
+		// area-weighted normal and centroid of the cluster
+		glm::vec3 normal(0), centre(0);
+		float area = 0;
+		for (unsigned int triangle = start; triangle < end; ++triangle)
+		{
+			glm::vec3 p0(a_vertices[ a_indices[triangle * 3 + 0] ].position);
+			glm::vec3 p1(a_vertices[ a_indices[triangle * 3 + 1] ].position);
+			glm::vec3 p2(a_vertices[ a_indices[triangle * 3 + 2] ].position);
+
+			glm::vec3 cross = glm::cross(p1 - p0, p2 - p0);
+			float triangleArea = glm::length(cross);
+			normal += cross;
+			centre += (p0 + p1 + p2) * (triangleArea / 3.0f);
+			area += triangleArea;
+		}
+
+		float sortKey = 0;
+		float normalLength = glm::length(normal);
+		if (area > 0 &&
+			normalLength > 0)
+			sortKey = glm::dot(centre / area - meshCentre, normal / normalLength);
+
+		// highest first
+		order[i] = std::make_pair(-sortKey, i);
+	}
+	std::stable_sort(order.begin(), order.end());
+
+	std::vector<unsigned int> output;
+	output.reserve(a_indices.size());
+	for (auto& cluster : order)
+	{
+		unsigned int start = a_clusters[cluster.second];
+		unsigned int end = cluster.second + 1 < a_clusters.size() ? a_clusters[cluster.second + 1] : triangleCount;
+		output.insert(output.end(), a_indices.begin() + start * 3, a_indices.begin() + end * 3);
+	}
+	a_indices.swap(output);
+}
+
+// moves vertices into the order the indices first use them, dropping any that aren't used
+static void reorderVertices(FBXMeshNode* a_mesh)
+{
+	std::vector<unsigned int> remap(a_mesh->m_vertices.size(), 0xffffffff);
+	std::vector<FBXVertex> vertices;
+	vertices.reserve(a_mesh->m_vertices.size());
+
+	for (auto& index : a_mesh->m_indices)
+	{
+		if (remap[index] == 0xffffffff)
+		{
+			remap[index] = (unsigned int)vertices.size();
+			vertices.push_back(a_mesh->m_vertices[index]);
+		}
+		index = remap[index];
+	}
+
+	a_mesh->m_vertices.swap(vertices);
+}
+
+static void reorderMesh(FBXMeshNode* a_mesh, bool a_overdraw, float* a_acmr)
+{
+	unsigned int vertexCount = (unsigned int)a_mesh->m_vertices.size();
+	a_acmr[0] = a_acmr[1] = calculateACMR(a_mesh->m_indices, vertexCount);
+
+	if (a_mesh->m_indices.size() < 3 ||
+		a_mesh->m_indices.size() % 3 != 0)
+		return;
+
+	std::vector<unsigned int> clusters;
+	tipsify(a_mesh->m_indices, vertexCount, clusters);
+
+	if (a_overdraw)
+	{
+		splitClusters(a_mesh->m_indices, vertexCount, clusters);
+		sortClusters(a_mesh->m_indices, a_mesh->m_vertices, clusters);
+	}
+
+	reorderVertices(a_mesh);
+	a_acmr[1] = calculateACMR(a_mesh->m_indices, (unsigned int)a_mesh->m_vertices.size());
+}
+
+void FBXFile::optimiseMeshOrder(bool a_overdraw /* = false */, bool a_report /* = false */)
+{
+	std::vector<float> acmr(m_meshes.size() * 2);
+
+	TaskGraph tasks;
+	for (unsigned int i = 0; i < m_meshes.size(); ++i)
+	{
+		FBXMeshNode* mesh = m_meshes[i];
+		float* meshACMR = &acmr[i * 2];
+		tasks.add([mesh, a_overdraw, meshACMR]{ reorderMesh(mesh, a_overdraw, meshACMR); });
+	}
+	tasks.wait();
+
+	if (a_report)
+	{
+		for (unsigned int i = 0; i < m_meshes.size(); ++i)
+			printf("Mesh '%s': ACMR %.3f -> %.3f\n", m_meshes[i]->m_name.c_str(), acmr[i * 2], acmr[i * 2 + 1]);
+	}
+}
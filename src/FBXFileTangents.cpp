@@ -0,0 +1,296 @@
+#include "FBXFile.h"
+#include "FBXFileInternal.h"
+#include <math.h>
+#include <float.h>
+#include <memory>
+
+// triangles or vertices per task; meshes smaller than two tasks' worth are done in one go
+static const unsigned int sc_tangentsPerTask = 16384;
+
+// Tangents follow MikkTSpace (Mikkelsen 2008), so they match what normal maps are usually baked with:
+// each triangle's tangent is normalised rather than weighted by its area, then projected into each of
+// its vertices' tangent planes and weighted by the angle at that corner. Vertices shared by mirrored
+// and unmirrored triangles are split so that each side keeps its own bitangent sign.
+// Each vertex gathers from the triangles around it rather than triangles scattering into their
+// vertices, so every stage can be spread across tasks without atomics or per-task accumulators.
+struct TangentBuilder
+{
+	TangentBuilder(FBXMeshNode* a_mesh) : mesh(a_mesh), vertexCount(0), triangleCount(0) {}
+
+	FBXMeshNode*				mesh;
+	unsigned int				vertexCount;	// before any were split
+	unsigned int				triangleCount;
+
+	// each triangle's tangent, with w 1 if its texture keeps its winding, -1 if the texture is
+	// mirrored and 0 if the triangle is degenerate in texture space
+	std::vector<glm::vec4>		faceTangents;
+
+	// the triangles using each vertex
+	std::vector<unsigned int>	adjacencyStart;
+	std::vector<unsigned int>	adjacency;
+
+	// the vertex each split vertex was copied from
+	std::vector<unsigned int>	splitSource;
+};
+
+static bool needsTangents(const FBXMeshNode* a_mesh)
+{
+	return (a_mesh->m_vertexAttributes & FBXVertex::eTEXCOORD1) != 0 &&
+		   (a_mesh->m_vertexAttributes & FBXVertex::eTANGENT) == 0 &&
+		   a_mesh->m_indices.size() >= 3;
+}
+
+static void prepareTangents(TangentBuilder& a_builder)
+{
+	const std::vector<unsigned int>& indices = a_builder.mesh->m_indices;
+	a_builder.vertexCount = (unsigned int)a_builder.mesh->m_vertices.size();
+	a_builder.triangleCount = (unsigned int)indices.size() / 3;
+	a_builder.faceTangents.resize(a_builder.triangleCount);
+
+	unsigned int cornerCount = a_builder.triangleCount * 3;
+	a_builder.adjacencyStart.assign(a_builder.vertexCount + 1, 0);
+	for (unsigned int i = 0; i < cornerCount; ++i)
+		++a_builder.adjacencyStart[ indices[i] + 1 ];
+	for (unsigned int i = 0; i < a_builder.vertexCount; ++i)
+		a_builder.adjacencyStart[i + 1] += a_builder.adjacencyStart[i];
+
+	a_builder.adjacency.resize(cornerCount);
+	std::vector<unsigned int> filled(a_builder.adjacencyStart.begin(), a_builder.adjacencyStart.end() - 1);
+	for (unsigned int i = 0; i < cornerCount; ++i)
+		a_builder.adjacency[ filled[ indices[i] ]++ ] = i / 3;
+}
+
+static glm::vec4 faceTangent(const FBXVertex& a_v1, const FBXVertex& a_v2, const FBXVertex& a_v3)
+{
+	glm::vec3 d1 = glm::vec3(a_v2.position - a_v1.position);
+	glm::vec3 d2 = glm::vec3(a_v3.position - a_v1.position);
+
+	float s1 = a_v2.texCoord1.x - a_v1.texCoord1.x;
+	float s2 = a_v3.texCoord1.x - a_v1.texCoord1.x;
+	float t1 = a_v2.texCoord1.y - a_v1.texCoord1.y;
+	float t2 = a_v3.texCoord1.y - a_v1.texCoord1.y;
+
+	float area = s1 * t2 - s2 * t1;
+	float orientation = area > FLT_MIN ? 1.0f : area < -FLT_MIN ? -1.0f : 0.0f;
+
+	// the direction the texture's s increases in, flipped where the texture is mirrored
+	glm::vec3 tangent = d1 * t2 - d2 * t1;
+	float length = glm::length(tangent);
+	if (length > 0)
+		tangent *= orientation / length;
+
+	return glm::vec4(tangent, orientation);
+}
+
+static void buildFaceTangents(TangentBuilder& a_builder, unsigned int a_first, unsigned int a_last)
+{
+	const FBXVertex* vertices = a_builder.mesh->m_vertices.data();
+	const unsigned int* indices = a_builder.mesh->m_indices.data();
+	glm::vec4* tangents = a_builder.faceTangents.data();
+	unsigned int i = a_first;
+
+#if defined(FBXFILE_SSE)
+	// faceTangent() for four triangles at once
+	__m128 minArea = _mm_set1_ps(FLT_MIN);
+	__m128 one = _mm_set1_ps(1);
+	for ( ; i + 4 <= a_last; i += 4)
+	{
+		const unsigned int* triangle = indices + i * 3;
+		__m128 p[3][4], uv[3][2];
+		for (int corner = 0; corner < 3; ++corner)
+		{
+			const FBXVertex& v0 = vertices[ triangle[corner] ];
+			const FBXVertex& v1 = vertices[ triangle[3 + corner] ];
+			const FBXVertex& v2 = vertices[ triangle[6 + corner] ];
+			const FBXVertex& v3 = vertices[ triangle[9 + corner] ];
+
+			p[corner][0] = _mm_loadu_ps(&v0.position.x);
+			p[corner][1] = _mm_loadu_ps(&v1.position.x);
+			p[corner][2] = _mm_loadu_ps(&v2.position.x);
+			p[corner][3] = _mm_loadu_ps(&v3.position.x);
+			_MM_TRANSPOSE4_PS(p[corner][0], p[corner][1], p[corner][2], p[corner][3]);
+
+			uv[corner][0] = _mm_set_ps(v3.texCoord1.x, v2.texCoord1.x, v1.texCoord1.x, v0.texCoord1.x);
+			uv[corner][1] = _mm_set_ps(v3.texCoord1.y, v2.texCoord1.y, v1.texCoord1.y, v0.texCoord1.y);
+		}
+
+		__m128 s1 = _mm_sub_ps(uv[1][0], uv[0][0]);
+		__m128 s2 = _mm_sub_ps(uv[2][0], uv[0][0]);
+		__m128 t1 = _mm_sub_ps(uv[1][1], uv[0][1]);
+		__m128 t2 = _mm_sub_ps(uv[2][1], uv[0][1]);
+
+		__m128 area = _mm_sub_ps(_mm_mul_ps(s1, t2), _mm_mul_ps(s2, t1));
+		__m128 orientation = _mm_or_ps(_mm_and_ps(_mm_cmpgt_ps(area, minArea), one),
+									   _mm_and_ps(_mm_cmplt_ps(area, _mm_sub_ps(_mm_setzero_ps(), minArea)), _mm_sub_ps(_mm_setzero_ps(), one)));
+
+		__m128 tangent[4];
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			__m128 d1 = _mm_sub_ps(p[1][axis], p[0][axis]);
+			__m128 d2 = _mm_sub_ps(p[2][axis], p[0][axis]);
+			tangent[axis] = _mm_sub_ps(_mm_mul_ps(d1, t2), _mm_mul_ps(d2, t1));
+		}
+
+		// zero length tangents are left as they are rather than divided by zero
+		__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tangent[0], tangent[0]), _mm_mul_ps(tangent[1], tangent[1])),
+											   _mm_mul_ps(tangent[2], tangent[2])));
+		__m128 nonZero = _mm_cmpgt_ps(length, _mm_setzero_ps());
+		__m128 scale = _mm_or_ps(_mm_and_ps(nonZero, _mm_div_ps(orientation, _mm_max_ps(length, minArea))),
+								 _mm_andnot_ps(nonZero, one));
+		tangent[0] = _mm_mul_ps(tangent[0], scale);
+		tangent[1] = _mm_mul_ps(tangent[1], scale);
+		tangent[2] = _mm_mul_ps(tangent[2], scale);
+		tangent[3] = orientation;
+
+		_MM_TRANSPOSE4_PS(tangent[0], tangent[1], tangent[2], tangent[3]);
+		for (int j = 0; j < 4; ++j)
+			_mm_storeu_ps(&tangents[i + j].x, tangent[j]);
+	}
+#endif
+
+	for ( ; i < a_last; ++i)
+	{
+		const unsigned int* triangle = indices + i * 3;
+		tangents[i] = faceTangent(vertices[ triangle[0] ], vertices[ triangle[1] ], vertices[ triangle[2] ]);
+	}
+}
+
+// copies each vertex used by both mirrored and unmirrored triangles, moving the mirrored ones onto the copy
+static void splitMirroredVertices(TangentBuilder& a_builder)
+{
+	std::vector<FBXVertex>& vertices = a_builder.mesh->m_vertices;
+	std::vector<unsigned int>& indices = a_builder.mesh->m_indices;
+
+	for (unsigned int i = 0; i < a_builder.vertexCount; ++i)
+	{
+		bool kept = false, mirrored = false;
+		for (unsigned int j = a_builder.adjacencyStart[i]; j < a_builder.adjacencyStart[i + 1]; ++j)
+		{
+			float orientation = a_builder.faceTangents[ a_builder.adjacency[j] ].w;
+			kept |= orientation > 0;
+			mirrored |= orientation < 0;
+		}
+		if (kept == false ||
+			mirrored == false)
+			continue;
+
+		unsigned int copy = (unsigned int)vertices.size();
+		FBXVertex vertex = vertices[i];
+		vertices.push_back(vertex);
+		a_builder.splitSource.push_back(i);
+
+		for (unsigned int j = a_builder.adjacencyStart[i]; j < a_builder.adjacencyStart[i + 1]; ++j)
+		{
+			unsigned int triangle = a_builder.adjacency[j];
+			if (a_builder.faceTangents[triangle].w >= 0)
+				continue;
+			for (unsigned int corner = 0; corner < 3; ++corner)
+			{
+				if (indices[triangle * 3 + corner] == i)
+					indices[triangle * 3 + corner] = copy;
+			}
+		}
+	}
+}
+
+// a_vector projected into the plane with normal a_normal, normalised unless it's zero
+static glm::vec3 projectToPlane(const glm::vec3& a_vector, const glm::vec3& a_normal)
+{
+	glm::vec3 projected = a_vector - a_normal * glm::dot(a_normal, a_vector);
+	float length = glm::length(projected);
+	return length > 0 ? projected / length : projected;
+}
+
+static void gatherTangents(TangentBuilder& a_builder, unsigned int a_first, unsigned int a_last)
+{
+	FBXVertex* vertices = a_builder.mesh->m_vertices.data();
+	const unsigned int* indices = a_builder.mesh->m_indices.data();
+
+	for (unsigned int i = a_first; i < a_last; ++i)
+	{
+		FBXVertex& vertex = vertices[i];
+		glm::vec3 normal(vertex.normal);
+		glm::vec3 tangent(0);
+		float sign = 1;
+
+		// split vertices look through the triangles of the vertex they came from for those now using them
+		unsigned int source = i < a_builder.vertexCount ? i : a_builder.splitSource[i - a_builder.vertexCount];
+		for (unsigned int j = a_builder.adjacencyStart[source]; j < a_builder.adjacencyStart[source + 1]; ++j)
+		{
+			unsigned int triangle = a_builder.adjacency[j];
+			const glm::vec4& face = a_builder.faceTangents[triangle];
+			const unsigned int* corners = indices + triangle * 3;
+
+			unsigned int corner = corners[0] == i ? 0 : corners[1] == i ? 1 : corners[2] == i ? 2 : 3;
+			if (corner == 3 ||
+				face.w == 0)
+				continue;
+
+			glm::vec3 position(vertex.position);
+			glm::vec3 edge1 = projectToPlane(glm::vec3(vertices[ corners[(corner + 1) % 3] ].position) - position, normal);
+			glm::vec3 edge2 = projectToPlane(glm::vec3(vertices[ corners[(corner + 2) % 3] ].position) - position, normal);
+			float angle = acosf(glm::clamp(glm::dot(edge1, edge2), -1.0f, 1.0f));
+
+			tangent += projectToPlane(glm::vec3(face), normal) * angle;
+			sign = face.w;
+		}
+
+		float length = glm::length(tangent);
+		if (length > 0)
+		{
+			tangent /= length;
+			vertex.tangent = glm::vec4(tangent, 0);
+			vertex.binormal = glm::vec4(glm::cross(normal, tangent) * sign, 0);
+		}
+	}
+}
+
+void FBXFile::calculateTangentsBinormals(FBXMeshNode* a_mesh)
+{
+	if (needsTangents(a_mesh) == false)
+		return;
+
+	TangentBuilder builder(a_mesh);
+	prepareTangents(builder);
+	buildFaceTangents(builder, 0, builder.triangleCount);
+	splitMirroredVertices(builder);
+	gatherTangents(builder, 0, (unsigned int)a_mesh->m_vertices.size());
+
+	a_mesh->m_vertexAttributes |= FBXVertex::eTANGENT|FBXVertex::eBINORMAL;
+}
+
+void FBXFile::calculateTangentsBinormals(FBXMeshNode* a_mesh, TaskGraph& a_tasks, const std::function<void()>& a_onFinished)
+{
+	if (needsTangents(a_mesh) == false ||
+		a_mesh->m_indices.size() / 3 < sc_tangentsPerTask * 2)
+	{
+		calculateTangentsBinormals(a_mesh);
+		if (a_onFinished)
+			a_onFinished();
+		return;
+	}
+
+	// the builder is shared by the tasks and goes once the last of them does
+	std::shared_ptr<TangentBuilder> builder = std::make_shared<TangentBuilder>(a_mesh);
+	prepareTangents(*builder);
+
+	std::vector<TaskGraph::Task> faceTasks = addRangeTasks(a_tasks, builder->triangleCount, sc_tangentsPerTask,
+		[builder](unsigned int first, unsigned int last){ buildFaceTangents(*builder, first, last); });
+
+	// the vertex count is only known once vertices are split, so the gathering is added from there
+	TaskGraph* tasks = &a_tasks;
+	a_tasks.add([builder, tasks, a_onFinished]{
+		splitMirroredVertices(*builder);
+
+		FBXMeshNode* mesh = builder->mesh;
+		unsigned int vertexCount = (unsigned int)mesh->m_vertices.size();
+		std::vector<TaskGraph::Task> gatherTasks = addRangeTasks(*tasks, vertexCount, sc_tangentsPerTask,
+			[builder](unsigned int first, unsigned int last){ gatherTangents(*builder, first, last); });
+
+		tasks->add([mesh, a_onFinished]{
+			mesh->m_vertexAttributes |= FBXVertex::eTANGENT|FBXVertex::eBINORMAL;
+			if (a_onFinished)
+				a_onFinished();
+		}, gatherTasks.data(), (unsigned int)gatherTasks.size());
+	}, faceTasks.data(), (unsigned int)faceTasks.size());
+}
@@ -0,0 +1,555 @@
+#include "FBXFile.h"
+#include "FBXFileInternal.h"
+#include "FileView.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#define GLEW_NO_GLU
+#include <GL/glew.h>
+
+#include <stb_image.h>
+
+// compressed textures are cached as <image>.ctex, a header followed by the mip table then the levels
+static const unsigned int sc_cacheMagic = 0x58455443;	// "CTEX"
+static const unsigned int sc_cacheVersion = 1;
+
+struct CacheHeader
+{
+	unsigned int	magic;
+	unsigned int	version;
+	unsigned int	format;
+	int				width;
+	int				height;
+	unsigned int	mipCount;
+
+	// the image the cache was built from, it's rebuilt if either changes
+	long long		sourceSize;
+	long long		sourceTime;
+};
+
+static bool fileInfo(const char* a_path, long long& a_size, long long& a_time)
+{
+	struct stat info;
+	if (stat(a_path, &info) != 0)
+		return false;
+	a_size = (long long)info.st_size;
+	a_time = (long long)info.st_mtime;
+	return true;
+}
+
+static bool isCompressed(int a_format)
+{
+	return a_format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ||
+		a_format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT ||
+		a_format == GL_COMPRESSED_RG_RGTC2;
+}
+
+static bool readCache(FBXTexture* a_texture, const std::string& a_cachePath, long long a_sourceSize, long long a_sourceTime)
+{
+	// FileView complains about missing files, and the cache won't exist the first time round
+	long long cacheSize = 0, cacheTime = 0;
+	if (fileInfo(a_cachePath.c_str(), cacheSize, cacheTime) == false ||
+		cacheSize < (long long)sizeof(CacheHeader))
+		return false;
+
+	FileView file(a_cachePath.c_str());
+	if (file.size() < sizeof(CacheHeader))
+		return false;
+
+	CacheHeader header;
+	memcpy(&header, file.data(), sizeof(CacheHeader));
+	if (header.magic != sc_cacheMagic ||
+		header.version != sc_cacheVersion ||
+		header.sourceSize != a_sourceSize ||
+		header.sourceTime != a_sourceTime ||
+		isCompressed(header.format) == false ||
+		(header.format == GL_COMPRESSED_RG_RGTC2) != a_texture->normalMap ||
+		header.mipCount == 0 ||
+		header.mipCount > 32)
+		return false;
+
+	size_t tableSize = header.mipCount * sizeof(FBXTexture::Mip);
+	if (file.size() < sizeof(CacheHeader) + tableSize)
+		return false;
+
+	std::vector<FBXTexture::Mip> mips(header.mipCount);
+	memcpy(mips.data(), file.data() + sizeof(CacheHeader), tableSize);
+
+	size_t dataSize = file.size() - sizeof(CacheHeader) - tableSize;
+	for (auto& mip : mips)
+	{
+		if ((size_t)mip.offset + mip.size > dataSize)
+			return false;
+	}
+
+	a_texture->width = header.width;
+	a_texture->height = header.height;
+	a_texture->format = header.format;
+	a_texture->mips.swap(mips);
+	a_texture->mipData.assign(file.data() + sizeof(CacheHeader) + tableSize, file.end());
+	return true;
+}
+
+static void writeCache(const FBXTexture* a_texture, const std::string& a_cachePath, long long a_sourceSize, long long a_sourceTime)
+{
+	CacheHeader header;
+	memset(&header, 0, sizeof(CacheHeader));
+	header.magic = sc_cacheMagic;
+	header.version = sc_cacheVersion;
+	header.format = a_texture->format;
+	header.width = a_texture->width;
+	header.height = a_texture->height;
+	header.mipCount = (unsigned int)a_texture->mips.size();
+	header.sourceSize = a_sourceSize;
+	header.sourceTime = a_sourceTime;
+
+	// not being able to cache only costs time, so carry on regardless
+	FILE* output = fopen(a_cachePath.c_str(), "wb");
+	if (output == nullptr)
+	{
+		printf("Warning: Unable to write texture cache '%s'\n", a_cachePath.c_str());
+		return;
+	}
+
+	bool written = fwrite(&header, sizeof(CacheHeader), 1, output) == 1 &&
+		fwrite(a_texture->mips.data(), sizeof(FBXTexture::Mip), a_texture->mips.size(), output) == a_texture->mips.size() &&
+		fwrite(a_texture->mipData.data(), 1, a_texture->mipData.size(), output) == a_texture->mipData.size();
+	fclose(output);
+
+	// a partial cache would fail validation anyway, but don't leave it lying around
+	if (written == false)
+		remove(a_cachePath.c_str());
+}
+
+// halves a level with a box filter, edge texels are repeated for odd sizes
+// normal maps are renormalised, otherwise their mips shorten and shading darkens with distance
+static void downsample(const std::vector<unsigned char>& a_level, int a_width, int a_height, int a_channels, bool a_normalMap,
+	std::vector<unsigned char>& a_next)
+{
+	int width = a_width > 1 ? a_width / 2 : 1;
+	int height = a_height > 1 ? a_height / 2 : 1;
+	a_next.resize(width * height * a_channels);
+
+	for (int y = 0; y < height; ++y)
+	{
+		int y0 = glm::min(y * 2, a_height - 1);
+		int y1 = glm::min(y * 2 + 1, a_height - 1);
+
+		for (int x = 0; x < width; ++x)
+		{
+			int x0 = glm::min(x * 2, a_width - 1);
+			int x1 = glm::min(x * 2 + 1, a_width - 1);
+
+			const unsigned char* p00 = &a_level[(y0 * a_width + x0) * a_channels];
+			const unsigned char* p01 = &a_level[(y0 * a_width + x1) * a_channels];
+			const unsigned char* p10 = &a_level[(y1 * a_width + x0) * a_channels];
+			const unsigned char* p11 = &a_level[(y1 * a_width + x1) * a_channels];
+			unsigned char* texel = &a_next[(y * width + x) * a_channels];
+
+			for (int c = 0; c < a_channels; ++c)
+				texel[c] = (unsigned char)((p00[c] + p01[c] + p10[c] + p11[c] + 2) / 4);
+
+			if (a_normalMap &&
+				a_channels >= 3)
+			{
+				glm::vec3 normal = glm::vec3(texel[0], texel[1], texel[2]) / 127.5f - 1.0f;
+				float length = glm::length(normal);
+				if (length > 0)
+				{
+					normal /= length;
+					for (int c = 0; c < 3; ++c)
+						texel[c] = toUnorm8(normal[c] * 0.5f + 0.5f);
+				}
+			}
+		}
+	}
+}
+
+static unsigned short toRGB565(const glm::vec3& a_colour)
+{
+	int r = (int)floorf(glm::clamp(a_colour.x, 0.0f, 255.0f) * 31.0f / 255.0f + 0.5f);
+	int g = (int)floorf(glm::clamp(a_colour.y, 0.0f, 255.0f) * 63.0f / 255.0f + 0.5f);
+	int b = (int)floorf(glm::clamp(a_colour.z, 0.0f, 255.0f) * 31.0f / 255.0f + 0.5f);
+	return (unsigned short)((r << 11) | (g << 5) | b);
+}
+
+// expands the way the hardware does, replicating the high bits into the low ones
+static glm::vec3 fromRGB565(unsigned short a_colour)
+{
+	int r = (a_colour >> 11) & 31;
+	int g = (a_colour >> 5) & 63;
+	int b = a_colour & 31;
+	return glm::vec3((float)((r << 3) | (r >> 2)), (float)((g << 2) | (g >> 4)), (float)((b << 3) | (b >> 2)));
+}
+
+// a BC1 colour block: two 565 endpoints and a 2 bit index per texel
+// the endpoints are the block's extremes along its principal axis, which suits the line the palette lies on
+static void encodeBC1(const unsigned char a_texels[16][4], unsigned char* a_block)
+{
+	glm::vec3 colours[16];
+	glm::vec3 mean(0);
+	for (int i = 0; i < 16; ++i)
+	{
+		colours[i] = glm::vec3(a_texels[i][0], a_texels[i][1], a_texels[i][2]);
+		mean += colours[i];
+	}
+	mean /= 16.0f;
+
+	// covariance, then power iteration for its largest eigenvector
+	float xx = 0, xy = 0, xz = 0, yy = 0, yz = 0, zz = 0;
+	for (int i = 0; i < 16; ++i)
+	{
+		glm::vec3 d = colours[i] - mean;
+		xx += d.x * d.x;	xy += d.x * d.y;	xz += d.x * d.z;
+		yy += d.y * d.y;	yz += d.y * d.z;	zz += d.z * d.z;
+	}
+
+	glm::vec3 axis(1, 1, 1);
+	for (int i = 0; i < 8; ++i)
+	{
+		glm::vec3 next(xx * axis.x + xy * axis.y + xz * axis.z,
+					   xy * axis.x + yy * axis.y + yz * axis.z,
+					   xz * axis.x + yz * axis.y + zz * axis.z);
+		float length = glm::length(next);
+		if (length <= 0)
+			break;
+		axis = next / length;
+	}
+
+	float lowest = FLT_MAX, highest = -FLT_MAX;
+	for (int i = 0; i < 16; ++i)
+	{
+		float projection = glm::dot(colours[i] - mean, axis);
+		lowest = glm::min(lowest, projection);
+		highest = glm::max(highest, projection);
+	}
+
+	unsigned short c0 = toRGB565(mean + axis * highest);
+	unsigned short c1 = toRGB565(mean + axis * lowest);
+
+	// c0 > c1 selects the four colour palette
+	if (c0 < c1)
+	{
+		unsigned short swap = c0;
+		c0 = c1;
+		c1 = swap;
+	}
+
+	unsigned int indices = 0;
+	if (c0 != c1)
+	{
+		glm::vec3 palette[4];
+		palette[0] = fromRGB565(c0);
+		palette[1] = fromRGB565(c1);
+		palette[2] = (palette[0] * 2.0f + palette[1]) / 3.0f;
+		palette[3] = (palette[0] + palette[1] * 2.0f) / 3.0f;
+
+		for (int i = 0; i < 16; ++i)
+		{
+			unsigned int best = 0;
+			float bestDistance = FLT_MAX;
+			for (unsigned int j = 0; j < 4; ++j)
+			{
+				glm::vec3 d = colours[i] - palette[j];
+				float distance = glm::dot(d, d);
+				if (distance < bestDistance)
+				{
+					best = j;
+					bestDistance = distance;
+				}
+			}
+			indices |= best << (i * 2);
+		}
+	}
+
+	a_block[0] = (unsigned char)(c0 & 0xff);
+	a_block[1] = (unsigned char)(c0 >> 8);
+	a_block[2] = (unsigned char)(c1 & 0xff);
+	a_block[3] = (unsigned char)(c1 >> 8);
+	for (int i = 0; i < 4; ++i)
+		a_block[4 + i] = (unsigned char)(indices >> (i * 8));
+}
+
+// a BC4 single channel block, as used for BC3's alpha and BC5's two channels: the channel's extremes
+// as endpoints, with six values evenly spaced between them and a 3 bit index per texel
+static void encodeBC4(const unsigned char a_values[16], unsigned char* a_block)
+{
+	int high = 0, low = 255;
+	for (int i = 0; i < 16; ++i)
+	{
+		high = glm::max(high, (int)a_values[i]);
+		low = glm::min(low, (int)a_values[i]);
+	}
+
+	a_block[0] = (unsigned char)high;
+	a_block[1] = (unsigned char)low;
+
+	unsigned long long indices = 0;
+	if (high > low)
+	{
+		int range = high - low;
+		for (int i = 0; i < 16; ++i)
+		{
+			// sevenths of the way from high to low, index 0 is high, 1 is low and 2-7 are in between
+			int step = ((high - a_values[i]) * 7 + range / 2) / range;
+			unsigned long long index = step == 0 ? 0 : (step == 7 ? 1 : step + 1);
+			indices |= index << (i * 3);
+		}
+	}
+
+	for (int i = 0; i < 6; ++i)
+		a_block[2 + i] = (unsigned char)(indices >> (i * 8));
+}
+
+// compresses an RGBA level in 4x4 blocks, repeating edge texels for levels that aren't a multiple of 4
+static void compressLevel(const std::vector<unsigned char>& a_level, int a_width, int a_height, int a_format,
+	std::vector<unsigned char>& a_output)
+{
+	unsigned int blockSize = a_format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? 8 : 16;
+	int blocksWide = (a_width + 3) / 4;
+	int blocksHigh = (a_height + 3) / 4;
+
+	size_t start = a_output.size();
+	a_output.resize(start + blocksWide * blocksHigh * blockSize);
+	unsigned char* block = a_output.data() + start;
+
+	unsigned char texels[16][4];
+	unsigned char channel[16];
+
+	for (int blockY = 0; blockY < blocksHigh; ++blockY)
+	{
+		for (int blockX = 0; blockX < blocksWide; ++blockX)
+		{
+			for (int i = 0; i < 16; ++i)
+			{
+				int x = glm::min(blockX * 4 + (i & 3), a_width - 1);
+				int y = glm::min(blockY * 4 + (i >> 2), a_height - 1);
+				memcpy(texels[i], &a_level[(y * a_width + x) * 4], 4);
+			}
+
+			switch (a_format)
+			{
+			case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+				encodeBC1(texels, block);
+				break;
+			case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+				for (int i = 0; i < 16; ++i)
+					channel[i] = texels[i][3];
+				encodeBC4(channel, block);
+				encodeBC1(texels, block + 8);
+				break;
+			case GL_COMPRESSED_RG_RGTC2:
+				for (int i = 0; i < 16; ++i)
+					channel[i] = texels[i][0];
+				encodeBC4(channel, block);
+				for (int i = 0; i < 16; ++i)
+					channel[i] = texels[i][1];
+				encodeBC4(channel, block + 8);
+				break;
+			}
+
+			block += blockSize;
+		}
+	}
+}
+
+void FBXFile::loadTexture(FBXTexture* a_texture, bool a_compress)
+{
+	long long sourceSize = 0, sourceTime = 0;
+	std::string cachePath = a_texture->path + ".ctex";
+	bool cacheable = a_compress && fileInfo(a_texture->path.c_str(), sourceSize, sourceTime);
+	if (cacheable &&
+		readCache(a_texture, cachePath, sourceSize, sourceTime))
+		return;
+
+	// compression works on RGBA, otherwise the image keeps its own channels
+	int sourceChannels = 0;
+	unsigned char* image = nullptr;
+	FileView file(a_texture->path.c_str());
+	if (file.isOpen())
+		image = stbi_load_from_memory(file.data(), (int)file.size(), &a_texture->width, &a_texture->height, &sourceChannels, a_compress ? STBI_rgb_alpha : STBI_default);
+	if (image == nullptr)
+	{
+		printf("Failed to load texture: %s\n", a_texture->path.c_str());
+		return;
+	}
+
+	int channels = a_compress ? STBI_rgb_alpha : sourceChannels;
+	int width = a_texture->width;
+	int height = a_texture->height;
+
+	std::vector<unsigned char> level(image, image + width * height * channels);
+	std::vector<unsigned char> next;
+	stbi_image_free(image);
+
+	if (a_compress)
+	{
+		bool alpha = false;
+		if (sourceChannels == STBI_grey_alpha ||
+			sourceChannels == STBI_rgb_alpha)
+		{
+			for (unsigned int i = 3; i < level.size() && alpha == false; i += 4)
+				alpha = level[i] != 255;
+		}
+
+		if (a_texture->normalMap)
+			a_texture->format = GL_COMPRESSED_RG_RGTC2;
+		else if (alpha)
+			a_texture->format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		else
+			a_texture->format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	}
+	else
+	{
+		switch (channels)
+		{
+		case STBI_grey: a_texture->format = GL_LUMINANCE; break;
+		case STBI_grey_alpha: a_texture->format = GL_LUMINANCE_ALPHA; break;
+		case STBI_rgb: a_texture->format = GL_RGB; break;
+		case STBI_rgb_alpha: a_texture->format = GL_RGBA; break;
+		};
+	}
+
+	// every level down to 1x1
+	while (true)
+	{
+		FBXTexture::Mip mip;
+		mip.width = width;
+		mip.height = height;
+		mip.offset = (unsigned int)a_texture->mipData.size();
+
+		if (a_compress)
+			compressLevel(level, width, height, a_texture->format, a_texture->mipData);
+		else
+			a_texture->mipData.insert(a_texture->mipData.end(), level.begin(), level.end());
+
+		mip.size = (unsigned int)a_texture->mipData.size() - mip.offset;
+		a_texture->mips.push_back(mip);
+
+		if (width == 1 &&
+			height == 1)
+			break;
+
+		downsample(level, width, height, channels, a_texture->normalMap, next);
+		level.swap(next);
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+	}
+
+	if (cacheable)
+		writeCache(a_texture, cachePath, sourceSize, sourceTime);
+}
+
+void FBXFile::loadTextureData()
+{
+	// normal maps are filtered and compressed differently, so flag them before loading
+	for (auto material : m_materials)
+	{
+		if (material.second->textures[FBXMaterial::NormalTexture] != nullptr)
+			material.second->textures[FBXMaterial::NormalTexture]->normalMap = true;
+	}
+
+	TaskGraph tasks;
+	bool compress = m_compressTextures;
+	for (auto texture : m_textures)
+	{
+		FBXTexture* t = texture.second;
+		tasks.add([t, compress]{ loadTexture(t, compress); });
+	}
+	tasks.wait();
+}
+
+void FBXFile::initialiseOpenGLTextures()
+{
+	for (auto texture : m_textures)
+		initialiseOpenGLTexture(texture.second);
+}
+
+void FBXFile::initialiseOpenGLTexture(FBXTexture* a_texture)
+{
+	// images filled in by hand rather than loaded still go up the old way
+	if (a_texture->mips.empty())
+	{
+		if (a_texture->data == nullptr)
+			return;
+
+		switch (a_texture->format)
+		{
+		case STBI_grey: a_texture->format = GL_LUMINANCE; break;
+		case STBI_grey_alpha: a_texture->format = GL_LUMINANCE_ALPHA; break;
+		case STBI_rgb: a_texture->format = GL_RGB; break;
+		case STBI_rgb_alpha: a_texture->format = GL_RGBA; break;
+		};
+
+		glGenTextures(1, &a_texture->handle);
+		glBindTexture(GL_TEXTURE_2D, a_texture->handle);
+		glTexImage2D(GL_TEXTURE_2D, 0, a_texture->format, a_texture->width, a_texture->height, 0, a_texture->format, GL_UNSIGNED_BYTE, a_texture->data);
+		glGenerateMipmap(GL_TEXTURE_2D);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		stbi_image_free(a_texture->data);
+		a_texture->data = nullptr;
+		return;
+	}
+
+	bool compressed = isCompressed(a_texture->format);
+	if ((a_texture->format == GL_COMPRESSED_RG_RGTC2 && GLEW_VERSION_3_0 == GL_FALSE && GLEW_ARB_texture_compression_rgtc == GL_FALSE) ||
+		(compressed && a_texture->format != GL_COMPRESSED_RG_RGTC2 && GLEW_EXT_texture_compression_s3tc == GL_FALSE))
+	{
+		printf("Error: Compressed texture format not supported for '%s'!\n", a_texture->path.c_str());
+		return;
+	}
+
+	// stage the whole chain in a pixel buffer, so the driver can copy it to the GPU in its own time
+	// rather than the upload stalling until it has, and point each level at its offset in the buffer
+	unsigned int pixelBuffer = 0;
+	glGenBuffers(1, &pixelBuffer);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, a_texture->mipData.size(), nullptr, GL_STREAM_DRAW);
+
+	void* staging = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, a_texture->mipData.size(), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (staging != nullptr)
+	{
+		memcpy(staging, a_texture->mipData.data(), a_texture->mipData.size());
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	}
+	else
+	{
+		glBufferSubData(GL_PIXEL_UNPACK_BUFFER, 0, a_texture->mipData.size(), a_texture->mipData.data());
+	}
+
+	// uncompressed rows of odd sized levels aren't 4 byte aligned
+	int alignment = 4;
+	glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	glGenTextures(1, &a_texture->handle);
+	glBindTexture(GL_TEXTURE_2D, a_texture->handle);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (int)a_texture->mips.size() - 1);
+
+	for (unsigned int i = 0; i < a_texture->mips.size(); ++i)
+	{
+		const FBXTexture::Mip& mip = a_texture->mips[i];
+		const void* offset = (const void*)(size_t)mip.offset;
+
+		if (compressed)
+			glCompressedTexImage2D(GL_TEXTURE_2D, i, a_texture->format, mip.width, mip.height, 0, mip.size, offset);
+		else
+			glTexImage2D(GL_TEXTURE_2D, i, a_texture->format, mip.width, mip.height, 0, a_texture->format, GL_UNSIGNED_BYTE, offset);
+	}
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	// the driver keeps the buffer alive until it's done with it
+	glDeleteBuffers(1, &pixelBuffer);
+
+	// the GPU has its own copy now
+	std::vector<unsigned char>().swap(a_texture->mipData);
+	std::vector<FBXTexture::Mip>().swap(a_texture->mips);
+}
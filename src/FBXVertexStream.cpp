@@ -0,0 +1,250 @@
+#include "FBXFile.h"
+#include "FBXFileInternal.h"
+#include <string.h>
+#include <math.h>
+
+#define GLEW_NO_GLU
+#include <GL/glew.h>
+
+// converts to an IEEE half float, rounding to nearest
+static unsigned short toHalf(float a_value)
+{
+	unsigned int bits = 0;
+	memcpy(&bits, &a_value, sizeof(float));
+
+	unsigned int sign = (bits >> 16) & 0x8000;
+	int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+	unsigned int mantissa = bits & 0x7fffff;
+
+	// too large, infinity or NaN
+	if (exponent >= 31)
+		return (unsigned short)(sign | 0x7c00 | ((bits & 0x7f800000) == 0x7f800000 && mantissa != 0 ? 0x200 : 0));
+
+	// too small for a normal half, so denormalise or flush to 0
+	if (exponent <= 0)
+	{
+		if (exponent < -10)
+			return (unsigned short)sign;
+
+		mantissa |= 0x800000;
+		unsigned int shift = 14 - exponent;
+		unsigned int half = mantissa >> shift;
+		if ((mantissa >> (shift - 1)) & 1)
+			++half;
+		return (unsigned short)(sign | half);
+	}
+
+	// a carry out of the mantissa correctly rounds up into the exponent
+	unsigned int half = sign | (exponent << 10) | (mantissa >> 13);
+	if (mantissa & 0x1000)
+		++half;
+	return (unsigned short)half;
+}
+
+static short toSnorm16(float a_value)
+{
+	return (short)floorf(glm::clamp(a_value, -1.0f, 1.0f) * 32767.0f + 0.5f);
+}
+
+static unsigned short toUnorm16(float a_value)
+{
+	return (unsigned short)floorf(glm::clamp(a_value, 0.0f, 1.0f) * 65535.0f + 0.5f);
+}
+
+// projects a unit vector onto an octahedron, then folds the lower half over the upper
+static void octahedralEncode(const glm::vec4& a_vector, short* a_encoded)
+{
+	float x = a_vector.x, y = a_vector.y, z = a_vector.z;
+	float length = fabsf(x) + fabsf(y) + fabsf(z);
+	if (length == 0)
+	{
+		a_encoded[0] = a_encoded[1] = 0;
+		return;
+	}
+
+	x /= length;
+	y /= length;
+	if (z < 0)
+	{
+		float foldedX = (1 - fabsf(y)) * (x >= 0 ? 1.0f : -1.0f);
+		float foldedY = (1 - fabsf(x)) * (y >= 0 ? 1.0f : -1.0f);
+		x = foldedX;
+		y = foldedY;
+	}
+
+	a_encoded[0] = toSnorm16(x);
+	a_encoded[1] = toSnorm16(y);
+}
+
+static void addAttribute(FBXVertexStream& a_stream, unsigned int a_attribute, int a_size, unsigned int a_type, unsigned int a_typeSize, bool a_normalised, bool a_integer)
+{
+	FBXVertexAttribute attribute;
+	attribute.attribute = a_attribute;
+	attribute.location = 0;
+	while ((1u << attribute.location) != a_attribute)
+		++attribute.location;
+	attribute.size = a_size;
+	attribute.type = a_type;
+	attribute.normalised = a_normalised;
+	attribute.integer = a_integer;
+	attribute.offset = a_stream.m_stride;
+
+	a_stream.m_attributes.push_back(attribute);
+	a_stream.m_stride += a_size * a_typeSize;
+}
+
+void FBXVertexStream::build(const FBXMeshNode* a_mesh)
+{
+	const std::vector<FBXVertex>& vertices = a_mesh->m_vertices;
+	unsigned int attributes = a_mesh->m_vertexAttributes;
+
+	m_stride = 0;
+	m_vertexCount = (unsigned int)vertices.size();
+	m_attributes.clear();
+	m_data.clear();
+
+	// pick the smallest formats that hold the mesh's data
+	bool wideIndices = false;
+	bool unitTexCoord1 = true, unitTexCoord2 = true;
+	for (auto& vertex : vertices)
+	{
+		for (int i = 0; i < 4; ++i)
+			wideIndices |= vertex.indices[i] > 255;
+		for (int i = 0; i < 2; ++i)
+		{
+			unitTexCoord1 &= vertex.texCoord1[i] >= 0 && vertex.texCoord1[i] <= 1;
+			unitTexCoord2 &= vertex.texCoord2[i] >= 0 && vertex.texCoord2[i] <= 1;
+		}
+	}
+
+	if ((attributes & FBXVertex::ePOSITION) != 0)
+		addAttribute(*this, FBXVertex::ePOSITION, 3, GL_FLOAT, sizeof(float), false, false);
+	if ((attributes & FBXVertex::eCOLOUR) != 0)
+		addAttribute(*this, FBXVertex::eCOLOUR, 4, GL_UNSIGNED_BYTE, 1, true, false);
+	if ((attributes & FBXVertex::eNORMAL) != 0)
+		addAttribute(*this, FBXVertex::eNORMAL, 2, GL_SHORT, sizeof(short), true, false);
+	if ((attributes & FBXVertex::eTANGENT) != 0)
+		addAttribute(*this, FBXVertex::eTANGENT, 4, GL_SHORT, sizeof(short), true, false);
+	if ((attributes & FBXVertex::eINDICES) != 0)
+	{
+		if (wideIndices)
+			addAttribute(*this, FBXVertex::eINDICES, 4, GL_UNSIGNED_SHORT, sizeof(short), false, true);
+		else
+			addAttribute(*this, FBXVertex::eINDICES, 4, GL_UNSIGNED_BYTE, 1, false, true);
+	}
+	if ((attributes & FBXVertex::eWEIGHTS) != 0)
+		addAttribute(*this, FBXVertex::eWEIGHTS, 4, GL_UNSIGNED_BYTE, 1, true, false);
+	if ((attributes & FBXVertex::eTEXCOORD1) != 0)
+		addAttribute(*this, FBXVertex::eTEXCOORD1, 2, unitTexCoord1 ? GL_UNSIGNED_SHORT : GL_HALF_FLOAT, sizeof(short), unitTexCoord1, false);
+	if ((attributes & FBXVertex::eTEXCOORD2) != 0)
+		addAttribute(*this, FBXVertex::eTEXCOORD2, 2, unitTexCoord2 ? GL_UNSIGNED_SHORT : GL_HALF_FLOAT, sizeof(short), unitTexCoord2, false);
+
+	m_data.resize(m_vertexCount * m_stride);
+
+	for (unsigned int i = 0; i < m_vertexCount; ++i)
+	{
+		const FBXVertex& vertex = vertices[i];
+		unsigned char* packed = m_data.data() + i * m_stride;
+
+		for (auto& attribute : m_attributes)
+		{
+			unsigned char* destination = packed + attribute.offset;
+
+			switch (attribute.attribute)
+			{
+			case FBXVertex::ePOSITION:
+				memcpy(destination, &vertex.position, sizeof(float) * 3);
+				break;
+			case FBXVertex::eCOLOUR:
+				for (int j = 0; j < 4; ++j)
+					destination[j] = toUnorm8(vertex.colour[j]);
+				break;
+			case FBXVertex::eNORMAL:
+				{
+					short encoded[2];
+					octahedralEncode(vertex.normal, encoded);
+					memcpy(destination, encoded, sizeof(encoded));
+				}
+				break;
+			case FBXVertex::eTANGENT:
+				{
+					// the bitangent sign is which way the binormal points relative to cross(normal, tangent)
+					float sign = 1;
+					if ((attributes & FBXVertex::eBINORMAL) != 0)
+					{
+						glm::vec3 normal(vertex.normal.x, vertex.normal.y, vertex.normal.z);
+						glm::vec3 tangent(vertex.tangent.x, vertex.tangent.y, vertex.tangent.z);
+						glm::vec3 binormal(vertex.binormal.x, vertex.binormal.y, vertex.binormal.z);
+						sign = glm::dot(glm::cross(normal, tangent), binormal) < 0 ? -1.0f : 1.0f;
+					}
+					else if (vertex.tangent.w < 0)
+					{
+						sign = -1;
+					}
+
+					short encoded[4] = { 0, 0, 0, toSnorm16(sign) };
+					octahedralEncode(vertex.tangent, encoded);
+					memcpy(destination, encoded, sizeof(encoded));
+				}
+				break;
+			case FBXVertex::eINDICES:
+				for (int j = 0; j < 4; ++j)
+				{
+					unsigned int index = (unsigned int)glm::max(vertex.indices[j], 0.0f);
+					if (attribute.type == GL_UNSIGNED_SHORT)
+						((unsigned short*)destination)[j] = (unsigned short)glm::min(index, 65535u);
+					else
+						destination[j] = (unsigned char)index;
+				}
+				break;
+			case FBXVertex::eWEIGHTS:
+				{
+					// round each weight, then give the rounding error to the heaviest so the sum stays exact
+					float total = vertex.weights.x + vertex.weights.y + vertex.weights.z + vertex.weights.w;
+					if (total <= 0)
+					{
+						memset(destination, 0, 4);
+						break;
+					}
+
+					int sum = 0, heaviest = 0;
+					for (int j = 0; j < 4; ++j)
+					{
+						destination[j] = toUnorm8(vertex.weights[j] / total);
+						sum += destination[j];
+						if (destination[j] > destination[heaviest])
+							heaviest = j;
+					}
+					destination[heaviest] = (unsigned char)(destination[heaviest] + 255 - sum);
+				}
+				break;
+			case FBXVertex::eTEXCOORD1:
+			case FBXVertex::eTEXCOORD2:
+				{
+					const glm::vec2& texCoord = attribute.attribute == FBXVertex::eTEXCOORD1 ? vertex.texCoord1 : vertex.texCoord2;
+					unsigned short encoded[2];
+					for (int j = 0; j < 2; ++j)
+						encoded[j] = attribute.type == GL_HALF_FLOAT ? toHalf(texCoord[j]) : toUnorm16(texCoord[j]);
+					memcpy(destination, encoded, sizeof(encoded));
+				}
+				break;
+			default:
+				break;
+			}
+		}
+	}
+}
+
+void FBXVertexStream::bindAttributes(unsigned int a_bufferOffset /* = 0 */) const
+{
+	for (auto& attribute : m_attributes)
+	{
+		const void* offset = (const void*)(size_t)(a_bufferOffset + attribute.offset);
+
+		glEnableVertexAttribArray(attribute.location);
+		if (attribute.integer)
+			glVertexAttribIPointer(attribute.location, attribute.size, attribute.type, m_stride, offset);
+		else
+			glVertexAttribPointer(attribute.location, attribute.size, attribute.type, attribute.normalised ? GL_TRUE : GL_FALSE, m_stride, offset);
+	}
+}
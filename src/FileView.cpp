@@ -0,0 +1,179 @@
+#include "FileView.h"
+#include <stdio.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// empty files have nothing to map, but still make an open view
+static const unsigned char sc_empty[1] = { 0 };
+
+FileView::FileView()
+	: m_data(nullptr),
+	m_size(0),
+	m_mapped(false)
+{
+}
+
+FileView::FileView(const char* a_filename)
+	: m_data(nullptr),
+	m_size(0),
+	m_mapped(false)
+{
+	open(a_filename);
+}
+
+FileView::FileView(FileView&& a_other)
+	: m_data(nullptr),
+	m_size(0),
+	m_mapped(false)
+{
+	swap(a_other);
+}
+
+FileView::~FileView()
+{
+	close();
+}
+
+FileView& FileView::operator = (FileView&& a_other)
+{
+	if (this != &a_other)
+	{
+		close();
+		swap(a_other);
+	}
+	return *this;
+}
+
+void FileView::swap(FileView& a_other)
+{
+	// a streamed view points into its own buffer, which moves along with it
+	const unsigned char* data = m_data;
+	size_t size = m_size;
+	bool mapped = m_mapped;
+
+	m_data = a_other.m_data;
+	m_size = a_other.m_size;
+	m_mapped = a_other.m_mapped;
+	m_buffer.swap(a_other.m_buffer);
+
+	a_other.m_data = data;
+	a_other.m_size = size;
+	a_other.m_mapped = mapped;
+}
+
+bool FileView::open(const char* a_filename)
+{
+	close();
+
+#if defined(_WIN32)
+	HANDLE file = CreateFileA(a_filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		printf("Error: Unable to open file '%s' for reading!\n",a_filename);
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (GetFileType(file) == FILE_TYPE_DISK &&
+		GetFileSizeEx(file, &size) != 0)
+	{
+		if (size.QuadPart == 0)
+		{
+			CloseHandle(file);
+			m_data = sc_empty;
+			return true;
+		}
+
+		// the mapping object can be closed straight away, the view keeps it alive
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping != nullptr)
+		{
+			void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+			CloseHandle(mapping);
+			if (view != nullptr)
+			{
+				CloseHandle(file);
+				m_data = (const unsigned char*)view;
+				m_size = (size_t)size.QuadPart;
+				m_mapped = true;
+				return true;
+			}
+		}
+	}
+
+	// fall back to streaming
+	unsigned char chunk[65536];
+	DWORD read = 0;
+	while (ReadFile(file, chunk, sizeof(chunk), &read, nullptr) != 0 &&
+		   read > 0)
+		m_buffer.insert(m_buffer.end(), chunk, chunk + read);
+	CloseHandle(file);
+#else
+	int file = ::open(a_filename, O_RDONLY);
+	if (file < 0)
+	{
+		printf("Error: Unable to open file '%s' for reading!\n",a_filename);
+		return false;
+	}
+
+	struct stat info;
+	if (fstat(file, &info) == 0 &&
+		S_ISREG(info.st_mode))
+	{
+		if (info.st_size == 0)
+		{
+			::close(file);
+			m_data = sc_empty;
+			return true;
+		}
+
+		// the mapping stays valid after the descriptor is closed
+		void* view = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+		if (view != MAP_FAILED)
+		{
+			::close(file);
+			m_data = (const unsigned char*)view;
+			m_size = (size_t)info.st_size;
+			m_mapped = true;
+			return true;
+		}
+	}
+
+	// fall back to streaming
+	unsigned char chunk[65536];
+	ssize_t bytes = 0;
+	while ((bytes = read(file, chunk, sizeof(chunk))) > 0)
+		m_buffer.insert(m_buffer.end(), chunk, chunk + bytes);
+	::close(file);
+#endif
+
+	m_data = m_buffer.empty() ? sc_empty : m_buffer.data();
+	m_size = m_buffer.size();
+	return true;
+}
+
+void FileView::close()
+{
+	if (m_mapped)
+	{
+#if defined(_WIN32)
+		UnmapViewOfFile(m_data);
+#else
+		munmap((void*)m_data, m_size);
+#endif
+	}
+
+	m_data = nullptr;
+	m_size = 0;
+	m_mapped = false;
+	std::vector<unsigned char>().swap(m_buffer);
+}
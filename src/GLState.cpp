@@ -0,0 +1,124 @@
+#include "GLState.h"
+#include <GL/glew.h>
+
+enum CachedCapabilities
+{
+	eBlend = 0,
+	eDepthTest,
+	eCullFace,
+
+	eCapabilityCount
+};
+
+static const GLenum sc_capabilities[eCapabilityCount] = { GL_BLEND, GL_DEPTH_TEST, GL_CULL_FACE };
+
+// the cache belongs to the GL context, so it is only touched from the GL thread
+static bool s_capabilityKnown[eCapabilityCount] = { false, false, false };
+static bool s_capabilityEnabled[eCapabilityCount] = { false, false, false };
+
+static bool s_blendKnown = false;
+static GLenum s_blendSource = GL_ONE;
+static GLenum s_blendDestination = GL_ZERO;
+
+static bool s_depthMaskKnown = false;
+static bool s_depthMask = true;
+
+static int cachedIndex(unsigned int a_capability)
+{
+	for (int i = 0; i < eCapabilityCount; ++i)
+		if (sc_capabilities[i] == a_capability)
+			return i;
+	return -1;
+}
+
+void GLState::invalidate()
+{
+	for (auto& known : s_capabilityKnown)
+		known = false;
+	s_blendKnown = false;
+	s_depthMaskKnown = false;
+}
+
+void GLState::setEnabled(unsigned int a_capability, bool a_enabled)
+{
+	int index = cachedIndex(a_capability);
+	if (index >= 0)
+	{
+		if (s_capabilityKnown[index] &&
+			s_capabilityEnabled[index] == a_enabled)
+			return;
+		s_capabilityKnown[index] = true;
+		s_capabilityEnabled[index] = a_enabled;
+	}
+
+	if (a_enabled)
+		glEnable(a_capability);
+	else
+		glDisable(a_capability);
+}
+
+bool GLState::isEnabled(unsigned int a_capability)
+{
+	int index = cachedIndex(a_capability);
+	if (index < 0)
+		return glIsEnabled(a_capability) == GL_TRUE;
+
+	if (s_capabilityKnown[index] == false)
+	{
+		s_capabilityEnabled[index] = glIsEnabled(a_capability) == GL_TRUE;
+		s_capabilityKnown[index] = true;
+	}
+	return s_capabilityEnabled[index];
+}
+
+void GLState::blendFunc(unsigned int a_source, unsigned int a_destination)
+{
+	if (s_blendKnown &&
+		s_blendSource == a_source &&
+		s_blendDestination == a_destination)
+		return;
+
+	glBlendFunc(a_source, a_destination);
+	s_blendKnown = true;
+	s_blendSource = a_source;
+	s_blendDestination = a_destination;
+}
+
+void GLState::getBlendFunc(unsigned int& a_source, unsigned int& a_destination)
+{
+	if (s_blendKnown == false)
+	{
+		int source = GL_ONE, destination = GL_ZERO;
+		glGetIntegerv(GL_BLEND_SRC, &source);
+		glGetIntegerv(GL_BLEND_DST, &destination);
+		s_blendSource = source;
+		s_blendDestination = destination;
+		s_blendKnown = true;
+	}
+
+	a_source = s_blendSource;
+	a_destination = s_blendDestination;
+}
+
+void GLState::depthMask(bool a_write)
+{
+	if (s_depthMaskKnown &&
+		s_depthMask == a_write)
+		return;
+
+	glDepthMask(a_write ? GL_TRUE : GL_FALSE);
+	s_depthMaskKnown = true;
+	s_depthMask = a_write;
+}
+
+bool GLState::getDepthMask()
+{
+	if (s_depthMaskKnown == false)
+	{
+		GLboolean mask = GL_TRUE;
+		glGetBooleanv(GL_DEPTH_WRITEMASK, &mask);
+		s_depthMask = mask == GL_TRUE;
+		s_depthMaskKnown = true;
+	}
+	return s_depthMask;
+}
@@ -1,25 +1,86 @@
 #include "Gizmos.h"
+#include "GLState.h"
 #include <GL/glew.h>
 #include <glm/ext.hpp>
+#include <string.h>
+#include <assert.h>
+#include <algorithm>
+#include <functional>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GIZMOS_SSE
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#define GIZMOS_THREAD_LOCAL __declspec(thread)
+#else
+#define GIZMOS_THREAD_LOCAL __thread
+#endif
 
 Gizmos* Gizmos::sm_singleton = nullptr;
+unsigned int Gizmos::sm_generation = 0;
+
+// each thread caches its buffer, the generation catches a destroyed and re-created Gizmos
+static GIZMOS_THREAD_LOCAL void* st_threadBuffer = nullptr;
+static GIZMOS_THREAD_LOCAL unsigned int st_threadGeneration = 0;
+
+// vertices per pooled block, a multiple of both 2 and 3
+static const unsigned int sc_blockVertices = 4092;
+
+struct Gizmos::Block
+{
+	unsigned int	count;
+	GizmoVertex		vertices[sc_blockVertices];
+};
+
+static unsigned int createProgram(const char* a_vsSource, const char* a_fsSource)
+{
+	unsigned int vs = glCreateShader(GL_VERTEX_SHADER);
+	unsigned int fs = glCreateShader(GL_FRAGMENT_SHADER);
+
+	glShaderSource(vs, 1, (const char**)&a_vsSource, 0);
+	glCompileShader(vs);
+
+	glShaderSource(fs, 1, (const char**)&a_fsSource, 0);
+	glCompileShader(fs);
+
+	unsigned int program = glCreateProgram();
+	glAttachShader(program, vs);
+	glAttachShader(program, fs);
+	glBindAttribLocation(program, 0, "Position");
+	glBindAttribLocation(program, 1, "Colour");
+	glBindAttribLocation(program, 2, "Transform");
+	glLinkProgram(program);
+    
+	int success = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+	if (success == GL_FALSE)
+	{
+		int infoLogLength = 0;
+		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &infoLogLength);
+		char* infoLog = new char[infoLogLength];
+        
+		glGetProgramInfoLog(program, infoLogLength, 0, infoLog);
+		printf("Error: Failed to link Gizmo shader program!\n");
+		printf("%s",infoLog);
+		printf("\n");
+		delete[] infoLog;
+	}
+
+	glDeleteShader(vs);
+	glDeleteShader(fs);
+
+	return program;
+}
 
 Gizmos::Gizmos(unsigned int a_maxLines, unsigned int a_maxTris,
 			   unsigned int a_max2DLines, unsigned int a_max2DTris)
-	: m_maxLines(a_maxLines),
-	m_lineCount(0),
-	m_lines(new GizmoLine[a_maxLines]),
-	m_maxTris(a_maxTris),
-	m_triCount(0),
-	m_tris(new GizmoTri[a_maxTris]),
-	m_transparentTriCount(0),
-	m_transparentTris(new GizmoTri[a_maxTris]),
-	m_max2DLines(a_max2DLines),
-	m_2DlineCount(0),
-	m_2Dlines(new GizmoLine[a_max2DLines]),
-	m_max2DTris(a_max2DTris),
-	m_2DtriCount(0),
-	m_2Dtris(new GizmoTri[a_max2DTris])
+	: m_persistent(GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage),
+	m_recording(nullptr),
+	m_transparency(eUnsortedTransparency),
+	m_instancing(GLEW_VERSION_3_3 || GLEW_ARB_instanced_arrays),
+	m_glThread(std::this_thread::get_id())
 {
 	// create shaders
 	const char* vsSource = "#version 150\n \
@@ -29,136 +90,908 @@ Gizmos::Gizmos(unsigned int a_maxLines, unsigned int a_maxTris,
 					 uniform mat4 ProjectionView; \
 					 void main() { vColour = Colour; gl_Position = ProjectionView * Position; }";
 
-	const char* fsSource = "#version 150\n \
-					 in vec4 vColour; \
-                     out vec4 FragColor; \
-					 void main()	{ FragColor = vColour; }";
-    
-    
-	unsigned int vs = glCreateShader(GL_VERTEX_SHADER);
-	unsigned int fs = glCreateShader(GL_FRAGMENT_SHADER);
+	// instanced gizmos take their colour and transform per-instance
+	const char* vsInstanceSource = "#version 150\n \
+					 in vec4 Position; \
+					 in vec4 Colour; \
+					 in mat4 Transform; \
+					 out vec4 vColour; \
+					 uniform mat4 ProjectionView; \
+					 void main() { vColour = Colour; gl_Position = ProjectionView * Transform * Position; }";
+
+	const char* fsSource = "#version 150\n \
+					 in vec4 vColour; \
+                     out vec4 FragColor; \
+					 void main()	{ FragColor = vColour; }";
+
+	m_shader = createProgram(vsSource, fsSource);
+	m_projectionViewUniform = glGetUniformLocation(m_shader,"ProjectionView");
+
+	// sorted transparent triangles are uploaded whole each draw
+	glGenBuffers(1, &m_sortedVBO);
+	glGenVertexArrays(1, &m_sortedVAO);
+	glBindVertexArray(m_sortedVAO);
+	glBindBuffer(GL_ARRAY_BUFFER, m_sortedVBO);
+	setVertexLayout();
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	m_instanceShader = 0;
+	m_instanceProjectionViewUniform = 0;
+	m_meshVAO = 0;
+	m_meshVBO = 0;
+	m_instanceVBO = 0;
+	m_instanceCapacity = 0;
+	m_meshesChanged = false;
+	m_instancesChanged = false;
+
+	if (m_instancing)
+	{
+		m_instanceShader = createProgram(vsInstanceSource, fsSource);
+		m_instanceProjectionViewUniform = glGetUniformLocation(m_instanceShader,"ProjectionView");
+
+		glGenBuffers(1, &m_meshVBO);
+		glGenBuffers(1, &m_instanceVBO);
+
+		// the per-instance attributes are pointed at each run as it is drawn
+		glGenVertexArrays(1, &m_meshVAO);
+		glBindVertexArray(m_meshVAO);
+		glBindBuffer(GL_ARRAY_BUFFER, m_meshVBO);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), 0);
+		for (unsigned int i = 1; i < 6; ++i)
+		{
+			glEnableVertexAttribArray(i);
+			glVertexAttribDivisor(i, 1);
+		}
+
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	// create vertex streams
+	createStream(m_streams[eLines], a_maxLines * 2);
+	createStream(m_streams[eTris], a_maxTris * 3);
+	createStream(m_streams[eTransparentTris], a_maxTris * 3);
+	createStream(m_streams[e2DLines], a_max2DLines * 2);
+	createStream(m_streams[e2DTris], a_max2DTris * 3);
+}
+
+Gizmos::~Gizmos()
+{
+	for (auto& stream : m_streams)
+		destroyStream(stream);
+	glDeleteProgram(m_shader);
+	glDeleteBuffers(1, &m_sortedVBO);
+	glDeleteVertexArrays(1, &m_sortedVAO);
+
+	for (auto layer : m_layers)
+	{
+		glDeleteBuffers(1, &layer->vbo);
+		glDeleteVertexArrays(1, &layer->vao);
+		delete layer;
+	}
+
+	if (m_instancing)
+	{
+		glDeleteProgram(m_instanceShader);
+		glDeleteBuffers(1, &m_meshVBO);
+		glDeleteBuffers(1, &m_instanceVBO);
+		glDeleteVertexArrays(1, &m_meshVAO);
+	}
+
+	for (auto buffer : m_threadBuffers)
+	{
+		for (auto& blocks : buffer->blocks)
+			for (auto block : blocks)
+				delete block;
+		delete buffer;
+	}
+	for (auto block : m_freeBlocks)
+		delete block;
+}
+
+void Gizmos::setVertexLayout()
+{
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(GizmoVertex), 0);
+	glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(GizmoVertex), ((char*)0) + 12);
+}
+
+void Gizmos::createStream(GizmoStream& a_stream, unsigned int a_vertices)
+{
+	// streams grow, but always start with some room
+	if (a_vertices < 6)
+		a_vertices = 6;
+
+	a_stream.capacity = a_vertices;
+	a_stream.count = 0;
+	a_stream.region = 0;
+	a_stream.mapping = nullptr;
+	a_stream.write = nullptr;
+	a_stream.orphan = true;
+	for (auto& fence : a_stream.fences)
+		fence = nullptr;
+
+	glGenBuffers( 1, &a_stream.vbo );
+	glBindBuffer(GL_ARRAY_BUFFER, a_stream.vbo);
+
+	if (m_persistent)
+	{
+		// three regions, mapped for the lifetime of the stream
+		GLsizeiptr size = 3 * a_vertices * sizeof(GizmoVertex);
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_ARRAY_BUFFER, size, nullptr, flags);
+		a_stream.mapping = (GizmoVertex*)glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags);
+		a_stream.write = a_stream.mapping;
+	}
+	else
+	{
+		glBufferData(GL_ARRAY_BUFFER, a_vertices * sizeof(GizmoVertex), nullptr, GL_STREAM_DRAW);
+	}
+
+	glGenVertexArrays(1, &a_stream.vao);
+	glBindVertexArray(a_stream.vao);
+	setVertexLayout();
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void Gizmos::destroyStream(GizmoStream& a_stream)
+{
+	for (auto& fence : a_stream.fences)
+	{
+		if (fence != nullptr)
+			glDeleteSync((GLsync)fence);
+		fence = nullptr;
+	}
+
+	if (a_stream.mapping != nullptr)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, a_stream.vbo);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	glDeleteBuffers( 1, &a_stream.vbo );
+	glDeleteVertexArrays( 1, &a_stream.vao );
+}
+
+void Gizmos::resetStream(GizmoStream& a_stream)
+{
+	a_stream.count = 0;
+
+	if (m_persistent)
+	{
+		// a region that hasn't been drawn since the last clear() isn't being read by the GPU,
+		// so keep writing to it rather than using up the ring when frames are skipped
+		if (a_stream.fences[ a_stream.region ] == nullptr)
+		{
+			a_stream.write = a_stream.mapping + a_stream.region * a_stream.capacity;
+			return;
+		}
+
+		// move to the next region, waiting if the GPU is still reading it
+		a_stream.region = (a_stream.region + 1) % 3;
+
+		GLsync fence = (GLsync)a_stream.fences[ a_stream.region ];
+		if (fence != nullptr)
+		{
+			while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED)
+				;
+			glDeleteSync(fence);
+			a_stream.fences[ a_stream.region ] = nullptr;
+		}
+
+		a_stream.write = a_stream.mapping + a_stream.region * a_stream.capacity;
+	}
+	else
+	{
+		// the buffer is orphaned the next time something is written to it
+		a_stream.orphan = true;
+	}
+}
+
+Gizmos::GizmoVertex* Gizmos::reserve(GizmoStream& a_stream, unsigned int a_vertices)
+{
+	if (a_stream.count + a_vertices > a_stream.capacity)
+		return nullptr;
+
+	// without persistent mapping, map the buffer on the first write after a clear() or draw()
+	if (a_stream.write == nullptr)
+	{
+		GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+		glBindBuffer(GL_ARRAY_BUFFER, a_stream.vbo);
+		if (a_stream.orphan)
+		{
+			glBufferData(GL_ARRAY_BUFFER, a_stream.capacity * sizeof(GizmoVertex), nullptr, GL_STREAM_DRAW);
+			access |= GL_MAP_INVALIDATE_BUFFER_BIT;
+			a_stream.orphan = false;
+		}
+		a_stream.mapping = (GizmoVertex*)glMapBufferRange(GL_ARRAY_BUFFER, 0, a_stream.capacity * sizeof(GizmoVertex), access);
+		a_stream.write = a_stream.mapping;
+		if (a_stream.write == nullptr)
+			return nullptr;
+	}
+
+	GizmoVertex* vertices = a_stream.write + a_stream.count;
+	a_stream.count += a_vertices;
+	return vertices;
+}
+
+void Gizmos::growStream(GizmoStream& a_stream, unsigned int a_vertices)
+{
+	unsigned int capacity = a_stream.capacity;
+	while (capacity < a_vertices)
+		capacity *= 2;
+
+	GizmoStream grown;
+	createStream(grown, capacity);
+
+	// copy the vertices already written on the GPU, rather than reading back mapped memory
+	if (a_stream.count > 0)
+	{
+		if (m_persistent == false &&
+			a_stream.write != nullptr)
+		{
+			glBindBuffer(GL_ARRAY_BUFFER, a_stream.vbo);
+			glUnmapBuffer(GL_ARRAY_BUFFER);
+			a_stream.mapping = nullptr;
+			a_stream.write = nullptr;
+		}
+
+		glBindBuffer(GL_COPY_READ_BUFFER, a_stream.vbo);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, grown.vbo);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+							a_stream.region * a_stream.capacity * sizeof(GizmoVertex), 0,
+							a_stream.count * sizeof(GizmoVertex));
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+		grown.count = a_stream.count;
+		grown.orphan = false;
+	}
+
+	destroyStream(a_stream);
+	a_stream = grown;
+}
+
+void Gizmos::drawStream(GizmoStream& a_stream, unsigned int a_mode)
+{
+	if (m_persistent == false &&
+		a_stream.write != nullptr)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, a_stream.vbo);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+		a_stream.mapping = nullptr;
+		a_stream.write = nullptr;
+	}
+
+	glBindVertexArray(a_stream.vao);
+	glDrawArrays(a_mode, a_stream.region * a_stream.capacity, a_stream.count);
+
+	if (m_persistent)
+	{
+		if (a_stream.fences[ a_stream.region ] != nullptr)
+			glDeleteSync((GLsync)a_stream.fences[ a_stream.region ]);
+		a_stream.fences[ a_stream.region ] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+}
+
+Gizmos::ThreadBuffer* Gizmos::threadBuffer()
+{
+	if (st_threadBuffer == nullptr ||
+		st_threadGeneration != sm_generation)
+	{
+		ThreadBuffer* buffer = new ThreadBuffer();
+
+		m_threadMutex.lock();
+		m_threadBuffers.push_back(buffer);
+		m_threadMutex.unlock();
+
+		st_threadBuffer = buffer;
+		st_threadGeneration = sm_generation;
+	}
+
+	return (ThreadBuffer*)st_threadBuffer;
+}
+
+Gizmos::GizmoVertex* Gizmos::reserve(ThreadBuffer& a_buffer, unsigned int a_stream, unsigned int a_vertices)
+{
+	std::vector<Block*>& blocks = a_buffer.blocks[a_stream];
+	if (blocks.empty() ||
+		blocks.back()->count + a_vertices > sc_blockVertices)
+	{
+		Block* block = nullptr;
+
+		m_poolMutex.lock();
+		if (m_freeBlocks.empty() == false)
+		{
+			block = m_freeBlocks.back();
+			m_freeBlocks.pop_back();
+		}
+		m_poolMutex.unlock();
+
+		if (block == nullptr)
+			block = new Block;
+		block->count = 0;
+		blocks.push_back(block);
+	}
+
+	Block* block = blocks.back();
+	GizmoVertex* vertices = block->vertices + block->count;
+	block->count += a_vertices;
+	return vertices;
+}
+
+void Gizmos::releaseBlocks(ThreadBuffer& a_buffer, unsigned int a_stream)
+{
+	std::vector<Block*>& blocks = a_buffer.blocks[a_stream];
+	if (blocks.empty())
+		return;
+
+	m_poolMutex.lock();
+	m_freeBlocks.insert(m_freeBlocks.end(), blocks.begin(), blocks.end());
+	m_poolMutex.unlock();
+	blocks.clear();
+}
+
+void Gizmos::mergeThreadBuffers(unsigned int a_stream)
+{
+	GizmoStream& stream = m_streams[a_stream];
+
+	std::lock_guard<std::mutex> lock(m_threadMutex);
+
+	unsigned int total = stream.count;
+	for (auto buffer : m_threadBuffers)
+	{
+		buffer->mutex.lock();
+		for (auto block : buffer->blocks[a_stream])
+			total += block->count;
+	}
+
+	if (total > stream.count)
+	{
+		if (total > stream.capacity)
+			growStream(stream, total);
+
+		GizmoVertex* vertices = reserve(stream, total - stream.count);
+		for (auto buffer : m_threadBuffers)
+		{
+			for (auto block : buffer->blocks[a_stream])
+			{
+				if (vertices != nullptr)
+					memcpy(vertices, block->vertices, block->count * sizeof(GizmoVertex));
+				vertices += block->count;
+			}
+			releaseBlocks(*buffer, a_stream);
+		}
+	}
+
+	for (auto buffer : m_threadBuffers)
+		buffer->mutex.unlock();
+}
+
+void Gizmos::gatherTransparentTris()
+{
+	std::lock_guard<std::mutex> lock(m_threadMutex);
+	for (auto buffer : m_threadBuffers)
+	{
+		buffer->mutex.lock();
+		for (auto block : buffer->blocks[eTransparentTris])
+			m_transparentTris.insert(m_transparentTris.end(), block->vertices, block->vertices + block->count);
+		releaseBlocks(*buffer, eTransparentTris);
+		buffer->mutex.unlock();
+	}
+}
+
+// runs a_work(0 .. a_threads-1), each on its own thread apart from the first
+static void parallelFor(unsigned int a_threads, const std::function<void(unsigned int)>& a_work)
+{
+	std::vector<std::thread> threads;
+	for (unsigned int i = 1; i < a_threads; ++i)
+		threads.push_back(std::thread(a_work, i));
+	a_work(0);
+	for (auto& thread : threads)
+		thread.join();
+}
+
+// below this many keys a single thread sorts faster than starting more
+static const unsigned int sc_parallelSortCount = 32768;
+
+// a stable least-significant-digit radix sort of 32-bit keys and their values, 8 bits per pass
+// each thread counts digits in its own slice of the keys, and then scatters that slice into the
+// ranges the combined counts give it, so no two threads write to the same place
+// a_tempKeys and a_tempValues must hold a_count entries, the result ends up back in a_keys and a_values
+static void radixSort(unsigned int* a_keys, unsigned int* a_values,
+					  unsigned int* a_tempKeys, unsigned int* a_tempValues, unsigned int a_count)
+{
+	unsigned int threadCount = 1;
+	if (a_count >= sc_parallelSortCount)
+	{
+		threadCount = std::thread::hardware_concurrency();
+		threadCount = threadCount < 1 ? 1 : (threadCount > 8 ? 8 : threadCount);
+	}
+
+	std::vector<unsigned int> counts(threadCount * 256);
+
+	unsigned int* keys = a_keys;
+	unsigned int* values = a_values;
+	unsigned int* tempKeys = a_tempKeys;
+	unsigned int* tempValues = a_tempValues;
+
+	for (unsigned int shift = 0; shift < 32; shift += 8)
+	{
+		parallelFor(threadCount, [&](unsigned int a_thread)
+		{
+			unsigned int* digits = &counts[a_thread * 256];
+			memset(digits, 0, 256 * sizeof(unsigned int));
+			unsigned int end = (unsigned int)((unsigned long long)a_count * (a_thread + 1) / threadCount);
+			for (unsigned int i = (unsigned int)((unsigned long long)a_count * a_thread / threadCount); i < end; ++i)
+				++digits[ (keys[i] >> shift) & 0xff ];
+		});
+
+		// turn the counts into where each thread starts writing each digit
+		unsigned int offset = 0;
+		bool sorted = false;
+		for (unsigned int digit = 0; digit < 256; ++digit)
+		{
+			unsigned int total = 0;
+			for (unsigned int thread = 0; thread < threadCount; ++thread)
+			{
+				unsigned int count = counts[thread * 256 + digit];
+				counts[thread * 256 + digit] = offset + total;
+				total += count;
+			}
+			offset += total;
+
+			// every key has the same digit, so this pass wouldn't move anything
+			if (total == a_count)
+				sorted = true;
+		}
+
+		if (sorted)
+			continue;
+
+		parallelFor(threadCount, [&](unsigned int a_thread)
+		{
+			unsigned int* offsets = &counts[a_thread * 256];
+			unsigned int end = (unsigned int)((unsigned long long)a_count * (a_thread + 1) / threadCount);
+			for (unsigned int i = (unsigned int)((unsigned long long)a_count * a_thread / threadCount); i < end; ++i)
+			{
+				unsigned int position = offsets[ (keys[i] >> shift) & 0xff ]++;
+				tempKeys[position] = keys[i];
+				tempValues[position] = values[i];
+			}
+		});
+
+		std::swap(keys, tempKeys);
+		std::swap(values, tempValues);
+	}
+
+	if (keys != a_keys)
+	{
+		memcpy(a_keys, keys, a_count * sizeof(unsigned int));
+		memcpy(a_values, values, a_count * sizeof(unsigned int));
+	}
+}
+
+void Gizmos::sortTransparentTris(const glm::mat4& a_projectionView)
+{
+	gatherTransparentTris();
+
+	unsigned int count = (unsigned int)(m_transparentTris.size() / 3);
+	m_sortedTris.resize(count * 3);
+	if (count == 0)
+		return;
+
+	// clip-space z increases with view depth for both perspective and orthographic projections
+	glm::vec4 depthRow(a_projectionView[0][2], a_projectionView[1][2], a_projectionView[2][2], a_projectionView[3][2]);
+
+	m_sortKeys.resize(count * 2);
+	m_sortIndices.resize(count * 2);
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		const GizmoVertex* vertices = &m_transparentTris[i * 3];
+		glm::vec3 center = (vertices[0].position + vertices[1].position + vertices[2].position) * (1 / 3.0f);
+		float depth = depthRow.x * center.x + depthRow.y * center.y + depthRow.z * center.z + depthRow.w;
+
+		// flip the float's bits so that they sort as unsigned integers, then invert them to sort furthest first
+		unsigned int bits;
+		memcpy(&bits, &depth, sizeof(bits));
+		bits ^= (bits & 0x80000000) != 0 ? 0xffffffff : 0x80000000;
+
+		m_sortKeys[i] = ~bits;
+		m_sortIndices[i] = i;
+	}
+
+	radixSort(&m_sortKeys[0], &m_sortIndices[0], &m_sortKeys[count], &m_sortIndices[count], count);
+
+#if !defined(NDEBUG)
+	// the furthest tris must be drawn first
+	for (unsigned int i = 1; i < count; ++i)
+		assert(m_sortKeys[i - 1] <= m_sortKeys[i]);
+#endif
+
+	for (unsigned int i = 0; i < count; ++i)
+		memcpy(&m_sortedTris[i * 3], &m_transparentTris[ m_sortIndices[i] * 3 ], 3 * sizeof(GizmoVertex));
+
+	// orphaned rather than updated in place, in case a previous draw() is still reading it
+	glBindBuffer(GL_ARRAY_BUFFER, m_sortedVBO);
+	glBufferData(GL_ARRAY_BUFFER, m_sortedTris.size() * sizeof(GizmoVertex), m_sortedTris.data(), GL_STREAM_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+Gizmos::Reservation::Reservation(unsigned int a_stream, unsigned int a_vertices)
+	: vertices(nullptr),
+	m_buffer(nullptr)
+{
+	if (sm_singleton == nullptr)
+		return;
+
+	// a layer being recorded takes the GL thread's gizmos
+	if (sm_singleton->m_recording != nullptr &&
+		std::this_thread::get_id() == sm_singleton->m_glThread)
+	{
+		std::vector<GizmoVertex>& layerVertices = sm_singleton->m_recording->vertices[a_stream];
+		size_t count = layerVertices.size();
+		layerVertices.resize(count + a_vertices);
+		vertices = &layerVertices[count];
+		return;
+	}
+
+	// the GL thread writes straight into the stream while it has room, unless the vertices are to be sorted
+	if (std::this_thread::get_id() == sm_singleton->m_glThread &&
+		(a_stream != eTransparentTris || sm_singleton->m_transparency == eUnsortedTransparency))
+	{
+		vertices = sm_singleton->reserve(sm_singleton->m_streams[a_stream], a_vertices);
+		if (vertices != nullptr)
+			return;
+	}
+
+	m_buffer = sm_singleton->threadBuffer();
+	m_buffer->mutex.lock();
+	vertices = sm_singleton->reserve(*m_buffer, a_stream, a_vertices);
+}
+
+Gizmos::Reservation::~Reservation()
+{
+	if (m_buffer != nullptr)
+		m_buffer->mutex.unlock();
+}
+
+unsigned int Gizmos::packColour(const glm::vec4& a_colour)
+{
+	unsigned int colour = 0;
+	for (int i = 3; i >= 0; --i)
+	{
+		float c = a_colour[i] < 0 ? 0 : (a_colour[i] > 1 ? 1 : a_colour[i]);
+		colour = (colour << 8) | (unsigned int)(c * 255 + 0.5f);
+	}
+	return colour;
+}
+
+void Gizmos::copyPositions(GizmoVertex* a_vertices, unsigned int a_stride, const glm::vec3* a_positions, unsigned int a_count, unsigned int a_colour)
+{
+	unsigned int i = 0;
+
+#if defined(GIZMOS_SSE)
+	// each position is loaded as four floats, masking off the next position's x and putting
+	// the colour in its place, so the last position is copied separately to avoid reading past the end
+	const __m128 mask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+	const __m128 colour = _mm_castsi128_ps(_mm_set_epi32((int)a_colour, 0, 0, 0));
+
+	for ( ; i + 1 < a_count; ++i)
+	{
+		__m128 position = _mm_loadu_ps(&a_positions[i].x);
+		_mm_storeu_ps((float*)(a_vertices + i * a_stride), _mm_or_ps(_mm_and_ps(position, mask), colour));
+	}
+#endif
+
+	for ( ; i < a_count; ++i)
+	{
+		a_vertices[i * a_stride].position = a_positions[i];
+		a_vertices[i * a_stride].colour = a_colour;
+	}
+}
+
+unsigned int Gizmos::meshKey(MeshShape a_shape, unsigned int a_a, unsigned int a_b /* = 0 */)
+{
+	return ((unsigned int)a_shape << 28) | (a_a << 14) | a_b;
+}
+
+glm::mat4 Gizmos::instanceTransform(const glm::vec3& a_center, const glm::vec3& a_scale, const glm::mat4* a_transform)
+{
+	// like the tessellated gizmos, only the rotation of a_transform is used
+	glm::mat4 transform(1);
+	if (a_transform != nullptr)
+		transform = *a_transform;
+	transform[3] = glm::vec4(a_center, 1);
+
+	transform[0] *= a_scale.x;
+	transform[1] *= a_scale.y;
+	transform[2] *= a_scale.z;
+	return transform;
+}
+
+void Gizmos::addInstance(unsigned int a_mesh, bool a_lines, const glm::mat4& a_transform, const glm::vec4& a_colour)
+{
+	// lines are always drawn opaque, like tessellated lines
+	bool transparent = a_lines == false && a_colour.w != 1;
+
+	InstanceRecord record;
+	record.key = ((unsigned long long)transparent << 40) | ((unsigned long long)a_mesh << 1) | (a_lines ? 1 : 0);
+	record.instance.transform = a_transform;
+	record.instance.colour = a_colour;
+
+	ThreadBuffer* buffer = sm_singleton->threadBuffer();
+	std::lock_guard<std::mutex> lock(buffer->mutex);
+	buffer->instances.push_back(record);
+}
+
+const Gizmos::GizmoMesh& Gizmos::mesh(unsigned int a_key)
+{
+	auto iter = m_meshes.find(a_key);
+	if (iter != m_meshes.end())
+		return iter->second;
+
+	std::vector<glm::vec3> tris;
+	std::vector<glm::vec3> lines;
+
+	unsigned int a = (a_key >> 14) & 0x3fff;
+	unsigned int b = a_key & 0x3fff;
+
+	switch (a_key >> 28)
+	{
+	case eSphereMesh:
+	{
+		// the same rows and columns as a tessellated sphere, with a radius of 1
+		int rows = a;
+		int columns = b;
+		std::vector<glm::vec3> points(rows * columns + columns);
+
+		for (int row = 0; row <= rows; ++row)
+		{
+			float radiansAboutXAxis = (float(row) / rows - 0.5f) * glm::pi<float>();
+			float y = sinf(radiansAboutXAxis);
+			float z = cosf(radiansAboutXAxis);
+
+			for (int col = 0; col <= columns; ++col)
+			{
+				float theta = float(col) / columns * 2 * glm::pi<float>();
+				points[ row * columns + (col % columns) ] = glm::vec3( -z * sinf(theta), y, -z * cosf(theta) );
+			}
+		}
+
+		for (int face = 0; face < rows * columns; ++face)
+		{
+			int nextFace = face + 1;
+			if (nextFace % columns == 0)
+				nextFace -= columns;
+
+			lines.push_back(points[face]);
+			lines.push_back(points[face + columns]);
+			lines.push_back(points[nextFace + columns]);
+			lines.push_back(points[face + columns]);
+
+			tris.push_back(points[nextFace + columns]);
+			tris.push_back(points[face]);
+			tris.push_back(points[nextFace]);
+			tris.push_back(points[nextFace + columns]);
+			tris.push_back(points[face + columns]);
+			tris.push_back(points[face]);
+		}
+		break;
+	}
+	case eBoxMesh:
+	{
+		glm::vec3 verts[8] = {
+			glm::vec3(-1,-1,-1), glm::vec3(-1,-1, 1), glm::vec3( 1,-1, 1), glm::vec3( 1,-1,-1),
+			glm::vec3(-1, 1,-1), glm::vec3(-1, 1, 1), glm::vec3( 1, 1, 1), glm::vec3( 1, 1,-1),
+		};
+		static const unsigned char sc_lines[24] = {
+			0,1, 1,2, 2,3, 3,0,  4,5, 5,6, 6,7, 7,4,  0,4, 1,5, 2,6, 3,7,
+		};
+		static const unsigned char sc_tris[36] = {
+			2,1,0, 3,2,0,  5,6,4, 6,7,4,  4,3,0, 7,3,4,
+			1,2,5, 2,6,5,  0,1,4, 1,5,4,  2,3,7, 6,2,7,
+		};
+		for (auto i : sc_lines)
+			lines.push_back(verts[i]);
+		for (auto i : sc_tris)
+			tris.push_back(verts[i]);
+		break;
+	}
+	case eCylinderMesh:
+	{
+		// a radius and half length of 1
+		float segmentSize = (2 * glm::pi<float>()) / a;
+		for (unsigned int i = 0; i < a; ++i)
+		{
+			glm::vec3 v0top(0, 1, 0);
+			glm::vec3 v1top( sinf( i * segmentSize ), 1, cosf( i * segmentSize ) );
+			glm::vec3 v2top( sinf( (i+1) * segmentSize ), 1, cosf( (i+1) * segmentSize ) );
+			glm::vec3 v0bottom(0, -1, 0);
+			glm::vec3 v1bottom( v1top.x, -1, v1top.z );
+			glm::vec3 v2bottom( v2top.x, -1, v2top.z );
+
+			glm::vec3 faces[12] = {
+				v0top, v1top, v2top,
+				v0bottom, v2bottom, v1bottom,
+				v2top, v1top, v1bottom,
+				v1bottom, v2bottom, v2top,
+			};
+			tris.insert(tris.end(), faces, faces + 12);
+
+			glm::vec3 edges[6] = { v1top, v2top, v1top, v1bottom, v1bottom, v2bottom };
+			lines.insert(lines.end(), edges, edges + 6);
+		}
+		break;
+	}
+	case eDiskMesh:
+	{
+		// double-sided, with a radius of 1, and its outline
+		float segmentSize = (2 * glm::pi<float>()) / a;
+		for (unsigned int i = 0; i < a; ++i)
+		{
+			glm::vec3 center(0);
+			glm::vec3 v1outer( sinf( i * segmentSize ), 0, cosf( i * segmentSize ) );
+			glm::vec3 v2outer( sinf( (i+1) * segmentSize ), 0, cosf( (i+1) * segmentSize ) );
 
-	glShaderSource(vs, 1, (const char**)&vsSource, 0);
-	glCompileShader(vs);
+			glm::vec3 faces[6] = { center, v1outer, v2outer, v2outer, v1outer, center };
+			tris.insert(tris.end(), faces, faces + 6);
 
-	glShaderSource(fs, 1, (const char**)&fsSource, 0);
-	glCompileShader(fs);
+			lines.push_back(v1outer);
+			lines.push_back(v2outer);
+		}
+		break;
+	}
+	case eRingMesh:
+	{
+		// double-sided, with an outer radius of 1, and its outlines
+		// inner vertices have a y of 1 so that the instance's y column can pull them in to the inner radius
+		float segmentSize = (2 * glm::pi<float>()) / a;
+		for (unsigned int i = 0; i < a; ++i)
+		{
+			glm::vec3 v1outer( sinf( i * segmentSize ), 0, cosf( i * segmentSize ) );
+			glm::vec3 v2outer( sinf( (i+1) * segmentSize ), 0, cosf( (i+1) * segmentSize ) );
+			glm::vec3 v1inner( v1outer.x, 1, v1outer.z );
+			glm::vec3 v2inner( v2outer.x, 1, v2outer.z );
+
+			glm::vec3 faces[12] = {
+				v2outer, v1outer, v1inner,
+				v1inner, v2inner, v2outer,
+				v1inner, v1outer, v2outer,
+				v2outer, v2inner, v1inner,
+			};
+			tris.insert(tris.end(), faces, faces + 12);
+
+			glm::vec3 edges[4] = { v1inner, v2inner, v1outer, v2outer };
+			lines.insert(lines.end(), edges, edges + 4);
+		}
+		break;
+	}
+	}
 
-	m_shader = glCreateProgram();
-	glAttachShader(m_shader, vs);
-	glAttachShader(m_shader, fs);
-	glBindAttribLocation(m_shader, 0, "Position");
-	glBindAttribLocation(m_shader, 1, "Colour");
-	glLinkProgram(m_shader);
-    
-	int success = GL_FALSE;
-    glGetProgramiv(m_shader, GL_LINK_STATUS, &success);
-	if (success == GL_FALSE)
+	GizmoMesh& info = m_meshes[a_key];
+	info.triFirst = (unsigned int)m_meshVertices.size();
+	info.triCount = (unsigned int)tris.size();
+	info.lineFirst = info.triFirst + info.triCount;
+	info.lineCount = (unsigned int)lines.size();
+
+	for (auto& v : tris)
+		m_meshVertices.push_back(glm::vec4(v, 1));
+	for (auto& v : lines)
+		m_meshVertices.push_back(glm::vec4(v, 1));
+
+	m_meshesChanged = true;
+	return info;
+}
+
+void Gizmos::prepareInstances()
+{
+	// gather instances from every thread, including this one
+	m_threadMutex.lock();
+	for (auto buffer : m_threadBuffers)
 	{
-		int infoLogLength = 0;
-		glGetShaderiv(m_shader, GL_INFO_LOG_LENGTH, &infoLogLength);
-		char* infoLog = new char[infoLogLength];
-        
-		glGetShaderInfoLog(m_shader, infoLogLength, 0, infoLog);
-		printf("Error: Failed to link Gizmo shader program!\n");
-		printf("%s",infoLog);
-		printf("\n");
-		delete[] infoLog;
+		buffer->mutex.lock();
+		if (buffer->instances.empty() == false)
+		{
+			m_instances.insert(m_instances.end(), buffer->instances.begin(), buffer->instances.end());
+			buffer->instances.clear();
+			m_instancesChanged = true;
+		}
+		buffer->mutex.unlock();
 	}
+	m_threadMutex.unlock();
 
-	glDeleteShader(vs);
-	glDeleteShader(fs);
-    
-    // create VBOs
-	glGenBuffers( 1, &m_lineVBO );
-	glBindBuffer(GL_ARRAY_BUFFER, m_lineVBO);
-	glBufferData(GL_ARRAY_BUFFER, m_maxLines * sizeof(GizmoLine), m_lines, GL_DYNAMIC_DRAW);
-
-	glGenBuffers( 1, &m_triVBO );
-	glBindBuffer(GL_ARRAY_BUFFER, m_triVBO);
-	glBufferData(GL_ARRAY_BUFFER, m_maxTris * sizeof(GizmoTri), m_tris, GL_DYNAMIC_DRAW);
-
-	glGenBuffers( 1, &m_transparentTriVBO );
-	glBindBuffer(GL_ARRAY_BUFFER, m_transparentTriVBO);
-	glBufferData(GL_ARRAY_BUFFER, m_maxTris * sizeof(GizmoTri), m_transparentTris, GL_DYNAMIC_DRAW);
-
-	glGenBuffers( 1, &m_2DlineVBO );
-	glBindBuffer(GL_ARRAY_BUFFER, m_2DlineVBO);
-	glBufferData(GL_ARRAY_BUFFER, m_max2DLines * sizeof(GizmoLine), m_2Dlines, GL_DYNAMIC_DRAW);
-
-	glGenBuffers( 1, &m_2DtriVBO );
-	glBindBuffer(GL_ARRAY_BUFFER, m_2DtriVBO);
-	glBufferData(GL_ARRAY_BUFFER, m_max2DTris * sizeof(GizmoTri), m_2Dtris, GL_DYNAMIC_DRAW);
-
-	glGenVertexArrays(1, &m_lineVAO);
-	glBindVertexArray(m_lineVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, m_lineVBO);
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(GizmoVertex), 0);
-	glVertexAttribPointer(1, 4, GL_FLOAT, GL_TRUE, sizeof(GizmoVertex), ((char*)0) + 16);
+	if (m_instancesChanged == false)
+		return;
+	m_instancesChanged = false;
 
-	glGenVertexArrays(1, &m_triVAO);
-	glBindVertexArray(m_triVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, m_triVBO);
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(GizmoVertex), 0);
-	glVertexAttribPointer(1, 4, GL_FLOAT, GL_TRUE, sizeof(GizmoVertex), ((char*)0) + 16);
+	// a stable sort keeps transparent instances in the order they were added
+	std::stable_sort(m_instances.begin(), m_instances.end(),
+					 [](const InstanceRecord& a_lhs, const InstanceRecord& a_rhs) { return a_lhs.key < a_rhs.key; });
 
-	glGenVertexArrays(1, &m_transparentTriVAO);
-	glBindVertexArray(m_transparentTriVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, m_transparentTriVBO);
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(GizmoVertex), 0);
-	glVertexAttribPointer(1, 4, GL_FLOAT, GL_TRUE, sizeof(GizmoVertex), ((char*)0) + 16);
+	m_instanceData.resize(m_instances.size());
+	m_instanceRuns.clear();
+	for (unsigned int i = 0; i < m_instances.size(); ++i)
+	{
+		m_instanceData[i] = m_instances[i].instance;
 
-	glGenVertexArrays(1, &m_2DlineVAO);
-	glBindVertexArray(m_2DlineVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, m_2DlineVBO);
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(GizmoVertex), 0);
-	glVertexAttribPointer(1, 4, GL_FLOAT, GL_TRUE, sizeof(GizmoVertex), ((char*)0) + 16);
+		if (m_instanceRuns.empty() ||
+			m_instanceRuns.back().key != m_instances[i].key)
+		{
+			InstanceRun run = { m_instances[i].key, i, 0 };
+			m_instanceRuns.push_back(run);
+			mesh((unsigned int)(run.key >> 1));
+		}
+		++m_instanceRuns.back().count;
+	}
 
-	glGenVertexArrays(1, &m_2DtriVAO);
-	glBindVertexArray(m_2DtriVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, m_2DtriVBO);
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(GizmoVertex), 0);
-	glVertexAttribPointer(1, 4, GL_FLOAT, GL_TRUE, sizeof(GizmoVertex), ((char*)0) + 16);
+	if (m_meshesChanged)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, m_meshVBO);
+		glBufferData(GL_ARRAY_BUFFER, m_meshVertices.size() * sizeof(glm::vec4), m_meshVertices.data(), GL_STATIC_DRAW);
+		m_meshesChanged = false;
+	}
 
-	glBindVertexArray(0);
+	// orphan the instance buffer rather than waiting on draws still reading it
+	glBindBuffer(GL_ARRAY_BUFFER, m_instanceVBO);
+	if (m_instanceData.size() > m_instanceCapacity)
+		m_instanceCapacity = (unsigned int)m_instanceData.size() * 2;
+	glBufferData(GL_ARRAY_BUFFER, m_instanceCapacity * sizeof(GizmoInstance), nullptr, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, m_instanceData.size() * sizeof(GizmoInstance), m_instanceData.data());
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
-Gizmos::~Gizmos()
+void Gizmos::drawInstances(bool a_transparent)
 {
-	delete[] m_lines;
-	delete[] m_tris;
-	delete[] m_transparentTris;
-	glDeleteBuffers( 1, &m_lineVBO );
-	glDeleteBuffers( 1, &m_triVBO );
-	glDeleteBuffers( 1, &m_transparentTriVBO );
-	glDeleteVertexArrays( 1, &m_lineVAO );
-	glDeleteVertexArrays( 1, &m_triVAO );
-	glDeleteVertexArrays( 1, &m_transparentTriVAO );
-	delete[] m_2Dlines;
-	delete[] m_2Dtris;
-	glDeleteBuffers( 1, &m_2DlineVBO );
-	glDeleteBuffers( 1, &m_2DtriVBO );
-	glDeleteVertexArrays( 1, &m_2DlineVAO );
-	glDeleteVertexArrays( 1, &m_2DtriVAO );
-	glDeleteProgram(m_shader);
+	bool bound = false;
+
+	for (auto& run : m_instanceRuns)
+	{
+		if (((run.key >> 40) != 0) != a_transparent)
+			continue;
+
+		if (bound == false)
+		{
+			glUseProgram(m_instanceShader);
+			glBindVertexArray(m_meshVAO);
+			glBindBuffer(GL_ARRAY_BUFFER, m_instanceVBO);
+			bound = true;
+		}
+
+		// point the per-instance attributes at the start of the run
+		const char* offset = ((char*)0) + run.first * sizeof(GizmoInstance);
+		glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(GizmoInstance), offset + sizeof(glm::mat4));
+		for (unsigned int column = 0; column < 4; ++column)
+			glVertexAttribPointer(2 + column, 4, GL_FLOAT, GL_FALSE, sizeof(GizmoInstance), offset + column * sizeof(glm::vec4));
+
+		const GizmoMesh& info = m_meshes[ (unsigned int)(run.key >> 1) ];
+		if ((run.key & 1) != 0)
+			glDrawArraysInstanced(GL_LINES, info.lineFirst, info.lineCount, run.count);
+		else
+			glDrawArraysInstanced(GL_TRIANGLES, info.triFirst, info.triCount, run.count);
+	}
+
+	if (bound)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glUseProgram(m_shader);
+	}
 }
 
 void Gizmos::create(unsigned int a_maxLines /* = 0xffff */, unsigned int a_maxTris /* = 0xffff */,
 					unsigned int a_max2DLines /* = 0xff */, unsigned int a_max2DTris /* = 0xff */)
 {
 	if (sm_singleton == nullptr)
+	{
+		++sm_generation;
 		sm_singleton = new Gizmos(a_maxLines,a_maxTris,a_max2DLines,a_max2DTris);
+	}
 }
 
 void Gizmos::destroy()
@@ -169,11 +1002,193 @@ void Gizmos::destroy()
 
 void Gizmos::clear()
 {
-	sm_singleton->m_lineCount = 0;
-	sm_singleton->m_triCount = 0;
-	sm_singleton->m_transparentTriCount = 0;
-	sm_singleton->m_2DlineCount = 0;
-	sm_singleton->m_2DtriCount = 0;
+	if (sm_singleton == nullptr)
+		return;
+
+	for (auto& stream : sm_singleton->m_streams)
+		sm_singleton->resetStream(stream);
+
+	// gizmos other threads have added are discarded too
+	std::lock_guard<std::mutex> lock(sm_singleton->m_threadMutex);
+	for (auto buffer : sm_singleton->m_threadBuffers)
+	{
+		buffer->mutex.lock();
+		for (unsigned int i = 0; i < eStreamCount; ++i)
+			sm_singleton->releaseBlocks(*buffer, i);
+		buffer->instances.clear();
+		buffer->mutex.unlock();
+	}
+
+	sm_singleton->m_transparentTris.clear();
+	sm_singleton->m_sortedTris.clear();
+	sm_singleton->m_instances.clear();
+	sm_singleton->m_instanceRuns.clear();
+	sm_singleton->m_instancesChanged = false;
+}
+
+Gizmos::GizmoLayer* Gizmos::findLayer(const char* a_name)
+{
+	for (auto layer : m_layers)
+		if (layer->name == a_name)
+			return layer;
+	return nullptr;
+}
+
+void Gizmos::beginLayer(const char* a_name)
+{
+	if (sm_singleton == nullptr)
+		return;
+
+	if (sm_singleton->m_recording != nullptr)
+		endLayer();
+
+	GizmoLayer* layer = sm_singleton->findLayer(a_name);
+	if (layer == nullptr)
+	{
+		layer = new GizmoLayer();
+		layer->name = a_name;
+		layer->visible = true;
+		layer->vao = 0;
+		layer->vbo = 0;
+		sm_singleton->m_layers.push_back(layer);
+	}
+
+	for (unsigned int i = 0; i < eStreamCount; ++i)
+	{
+		layer->vertices[i].clear();
+		layer->first[i] = 0;
+		layer->count[i] = 0;
+	}
+	layer->dirty = true;
+
+	sm_singleton->m_recording = layer;
+}
+
+void Gizmos::endLayer()
+{
+	if (sm_singleton == nullptr)
+		return;
+
+	sm_singleton->m_recording = nullptr;
+}
+
+bool Gizmos::hasLayer(const char* a_name)
+{
+	if (sm_singleton == nullptr)
+		return false;
+
+	return sm_singleton->findLayer(a_name) != nullptr;
+}
+
+void Gizmos::destroyLayer(const char* a_name)
+{
+	if (sm_singleton == nullptr)
+		return;
+
+	GizmoLayer* layer = sm_singleton->findLayer(a_name);
+	if (layer == nullptr)
+		return;
+
+	if (sm_singleton->m_recording == layer)
+		sm_singleton->m_recording = nullptr;
+
+	auto& layers = sm_singleton->m_layers;
+	layers.erase(std::find(layers.begin(), layers.end(), layer));
+
+	glDeleteBuffers(1, &layer->vbo);
+	glDeleteVertexArrays(1, &layer->vao);
+	delete layer;
+}
+
+void Gizmos::setLayerVisible(const char* a_name, bool a_visible)
+{
+	if (sm_singleton == nullptr)
+		return;
+
+	GizmoLayer* layer = sm_singleton->findLayer(a_name);
+	if (layer != nullptr)
+		layer->visible = a_visible;
+}
+
+bool Gizmos::isLayerVisible(const char* a_name)
+{
+	if (sm_singleton == nullptr)
+		return false;
+
+	GizmoLayer* layer = sm_singleton->findLayer(a_name);
+	return layer != nullptr && layer->visible;
+}
+
+void Gizmos::uploadLayers()
+{
+	for (auto layer : m_layers)
+	{
+		// a layer still being recorded is uploaded once it's finished
+		if (layer->dirty == false ||
+			layer == m_recording)
+			continue;
+
+		unsigned int total = 0;
+		for (unsigned int i = 0; i < eStreamCount; ++i)
+		{
+			layer->first[i] = total;
+			layer->count[i] = (unsigned int)layer->vertices[i].size();
+			total += layer->count[i];
+		}
+
+		if (layer->vao == 0)
+		{
+			glGenBuffers(1, &layer->vbo);
+			glGenVertexArrays(1, &layer->vao);
+			glBindVertexArray(layer->vao);
+			glBindBuffer(GL_ARRAY_BUFFER, layer->vbo);
+			setVertexLayout();
+			glBindVertexArray(0);
+		}
+
+		glBindBuffer(GL_ARRAY_BUFFER, layer->vbo);
+		glBufferData(GL_ARRAY_BUFFER, total * sizeof(GizmoVertex), nullptr, GL_STATIC_DRAW);
+		for (unsigned int i = 0; i < eStreamCount; ++i)
+		{
+			if (layer->count[i] > 0)
+				glBufferSubData(GL_ARRAY_BUFFER, layer->first[i] * sizeof(GizmoVertex),
+								layer->count[i] * sizeof(GizmoVertex), layer->vertices[i].data());
+			std::vector<GizmoVertex>().swap(layer->vertices[i]);
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		layer->dirty = false;
+	}
+}
+
+bool Gizmos::layersHave(unsigned int a_stream)
+{
+	for (auto layer : m_layers)
+		if (layer->visible &&
+			layer->dirty == false &&
+			layer->count[a_stream] > 0)
+			return true;
+	return false;
+}
+
+void Gizmos::drawLayers(unsigned int a_stream, unsigned int a_mode)
+{
+	for (auto layer : m_layers)
+	{
+		if (layer->visible &&
+			layer->dirty == false &&
+			layer->count[a_stream] > 0)
+		{
+			glBindVertexArray(layer->vao);
+			glDrawArrays(a_mode, layer->first[a_stream], layer->count[a_stream]);
+		}
+	}
+}
+
+void Gizmos::setTransparencyMode(TransparencyMode a_mode)
+{
+	if (sm_singleton != nullptr)
+		sm_singleton->m_transparency = a_mode;
 }
 
 // Adds 3 unit-length lines (red,green,blue) representing the 3 axis of a transform, 
@@ -198,6 +1213,14 @@ void Gizmos::addAABB(const glm::vec3& a_center,
 	const glm::vec4& a_colour, 
 	const glm::mat4* a_transform /* = nullptr */)
 {
+	if (sm_singleton != nullptr &&
+		sm_singleton->m_instancing &&
+		sm_singleton->m_recording == nullptr)
+	{
+		addInstance(meshKey(eBoxMesh, 0), true, instanceTransform(a_center, a_rvExtents, a_transform), a_colour);
+		return;
+	}
+
 	glm::vec3 vVerts[8];
 	glm::vec3 vX(a_rvExtents.x, 0, 0);
 	glm::vec3 vY(0, a_rvExtents.y, 0);
@@ -243,6 +1266,16 @@ void Gizmos::addAABBFilled(const glm::vec3& a_center,
 	const glm::vec4& a_fillColour, 
 	const glm::mat4* a_transform /* = nullptr */)
 {
+	if (sm_singleton != nullptr &&
+		sm_singleton->m_instancing &&
+		sm_singleton->m_recording == nullptr)
+	{
+		glm::mat4 transform = instanceTransform(a_center, a_rvExtents, a_transform);
+		addInstance(meshKey(eBoxMesh, 0), false, transform, a_fillColour);
+		addInstance(meshKey(eBoxMesh, 0), true, transform, glm::vec4(1,1,1,1));
+		return;
+	}
+
 	glm::vec3 vVerts[8];
 	glm::vec3 vX(a_rvExtents.x, 0, 0);
 	glm::vec3 vY(0, a_rvExtents.y, 0);
@@ -312,6 +1345,17 @@ void Gizmos::addAABBFilled(const glm::vec3& a_center,
 void Gizmos::addCylinderFilled(const glm::vec3& a_center, float a_radius, float a_fHalfLength,
 	unsigned int a_segments, const glm::vec4& a_fillColour, const glm::mat4* a_transform /* = nullptr */)
 {
+	if (sm_singleton != nullptr &&
+		sm_singleton->m_instancing &&
+		sm_singleton->m_recording == nullptr &&
+		a_segments > 0 && a_segments < 0x4000)
+	{
+		glm::mat4 transform = instanceTransform(a_center, glm::vec3(a_radius, a_fHalfLength, a_radius), a_transform);
+		addInstance(meshKey(eCylinderMesh, a_segments), false, transform, a_fillColour);
+		addInstance(meshKey(eCylinderMesh, a_segments), true, transform, glm::vec4(1,1,1,1));
+		return;
+	}
+
 	glm::vec4 white(1,1,1,1);
 
 	float segmentSize = (2 * glm::pi<float>()) / a_segments;
@@ -354,6 +1398,24 @@ void Gizmos::addRing(const glm::vec3& a_center, float a_innerRadius, float a_out
 	glm::vec4 vSolid = a_fillColour;
 	vSolid.w = 1;
 
+	if (sm_singleton != nullptr &&
+		sm_singleton->m_instancing &&
+		sm_singleton->m_recording == nullptr &&
+		a_innerRadius > 0 && a_outerRadius > 0 &&
+		a_segments > 0 && a_segments < 0x4000)
+	{
+		// the ring's y column gives its inner vertices a w of outer / inner radius, and moves
+		// them by as much again of the center, so that after the divide they sit on the inner radius
+		float k = a_outerRadius / a_innerRadius - 1;
+		glm::mat4 transform = instanceTransform(a_center, glm::vec3(a_outerRadius), a_transform);
+		transform[1] = glm::vec4(a_center * k, k);
+		if (a_fillColour.w != 0)
+			addInstance(meshKey(eRingMesh, a_segments), false, transform, a_fillColour);
+		else
+			addInstance(meshKey(eRingMesh, a_segments), true, transform, vSolid);
+		return;
+	}
+
 	float fSegmentSize = (2 * glm::pi<float>()) / a_segments;
 
 	for ( unsigned int i = 0 ; i < a_segments ; ++i )
@@ -382,8 +1444,8 @@ void Gizmos::addRing(const glm::vec3& a_center, float a_innerRadius, float a_out
 		else
 		{
 			// line
-			addLine(a_center + v1inner + a_center, a_center + v2inner + a_center, vSolid, vSolid);
-			addLine(a_center + v1outer + a_center, a_center + v2outer + a_center, vSolid, vSolid);
+			addLine(a_center + v1inner, a_center + v2inner, vSolid, vSolid);
+			addLine(a_center + v1outer, a_center + v2outer, vSolid, vSolid);
 		}
 	}
 }
@@ -394,6 +1456,19 @@ void Gizmos::addDisk(const glm::vec3& a_center, float a_radius,
 	glm::vec4 vSolid = a_fillColour;
 	vSolid.w = 1;
 
+	if (sm_singleton != nullptr &&
+		sm_singleton->m_instancing &&
+		sm_singleton->m_recording == nullptr &&
+		a_segments > 0 && a_segments < 0x4000)
+	{
+		glm::mat4 transform = instanceTransform(a_center, glm::vec3(a_radius), a_transform);
+		if (a_fillColour.w != 0)
+			addInstance(meshKey(eDiskMesh, a_segments), false, transform, a_fillColour);
+		else
+			addInstance(meshKey(eDiskMesh, a_segments), true, transform, vSolid);
+		return;
+	}
+
 	float fSegmentSize = (2 * glm::pi<float>()) / a_segments;
 
 	for ( unsigned int i = 0 ; i < a_segments ; ++i )
@@ -427,6 +1502,8 @@ void Gizmos::addArc(const glm::vec3& a_center, float a_rotation,
 	glm::vec4 vSolid = a_fillColour;
 	vSolid.w = 1;
 
+	// arcs stay tessellated, as their half angle changes the direction of every vertex which no
+	// instance transform can do, and a unit mesh per angle would grow the mesh cache without bound
 	float fSegmentSize = (2 * a_arcHalfAngle) / a_segments;
 
 	for ( unsigned int i = 0 ; i < a_segments ; ++i )
@@ -476,6 +1553,7 @@ void Gizmos::addArcRing(const glm::vec3& a_center, float a_rotation,
 	glm::vec4 vSolid = a_fillColour;
 	vSolid.w = 1;
 
+	// tessellated for the same reason as addArc()
 	float fSegmentSize = (2 * a_arcHalfAngle) / a_segments;
 
 	for ( unsigned int i = 0 ; i < a_segments ; ++i )
@@ -534,6 +1612,19 @@ void Gizmos::addSphere(const glm::vec3& a_center, float a_radius, int a_rows, in
 								const glm::mat4* a_transform /*= nullptr*/, float a_longMin /*= 0.f*/, float a_longMax /*= 360*/, 
 								float a_latMin /*= -90*/, float a_latMax /*= 90*/)
 {
+	// only whole spheres have a unit mesh
+	if (sm_singleton != nullptr &&
+		sm_singleton->m_instancing &&
+		sm_singleton->m_recording == nullptr &&
+		a_longMin == 0 && a_longMax == 360 && a_latMin == -90 && a_latMax == 90 &&
+		a_rows > 0 && a_rows < 0x4000 && a_columns > 0 && a_columns < 0x4000)
+	{
+		glm::mat4 transform = instanceTransform(a_center, glm::vec3(a_radius), a_transform);
+		addInstance(meshKey(eSphereMesh, a_rows, a_columns), false, transform, a_fillColour);
+		addInstance(meshKey(eSphereMesh, a_rows, a_columns), true, transform, glm::vec4(1,1,1,1));
+		return;
+	}
+
 	float inverseRadius = 1/a_radius;
 	//Invert these first as the multiply is slightly quicker
 	float invColumns = 1.0f/float(a_columns);
@@ -628,50 +1719,76 @@ void Gizmos::addLine(const glm::vec3& a_rv0,  const glm::vec3& a_rv1, const glm:
 
 void Gizmos::addLine(const glm::vec3& a_rv0, const glm::vec3& a_rv1, const glm::vec4& a_colour0, const glm::vec4& a_colour1)
 {
-	if (sm_singleton != nullptr &&
-		sm_singleton->m_lineCount < sm_singleton->m_maxLines)
-	{
-		sm_singleton->m_lines[ sm_singleton->m_lineCount ].v0.position = glm::vec4(a_rv0,1);
-		sm_singleton->m_lines[ sm_singleton->m_lineCount ].v0.colour = a_colour0;
-		sm_singleton->m_lines[ sm_singleton->m_lineCount ].v1.position = glm::vec4(a_rv1,1);
-		sm_singleton->m_lines[ sm_singleton->m_lineCount ].v1.colour = a_colour1;
+	unsigned int colour0 = packColour(a_colour0);
+	unsigned int colour1 = packColour(a_colour1);
 
-		sm_singleton->m_lineCount++;
+	Reservation reservation(eLines, 2);
+	GizmoVertex* vertices = reservation.vertices;
+	if (vertices != nullptr)
+	{
+		vertices[0].position = a_rv0;
+		vertices[0].colour = colour0;
+		vertices[1].position = a_rv1;
+		vertices[1].colour = colour1;
 	}
 }
 
 void Gizmos::addTri(const glm::vec3& a_rv0, const glm::vec3& a_rv1, const glm::vec3& a_rv2, const glm::vec4& a_colour)
 {
-	if (sm_singleton != nullptr)
+	unsigned int colour = packColour(a_colour);
+
+	Reservation reservation(a_colour.w == 1 ? eTris : eTransparentTris, 3);
+	GizmoVertex* vertices = reservation.vertices;
+	if (vertices != nullptr)
 	{
-		if (a_colour.w == 1)
-		{
-			if (sm_singleton->m_triCount < sm_singleton->m_maxTris)
-			{
-				sm_singleton->m_tris[ sm_singleton->m_triCount ].v0.position = glm::vec4(a_rv0,1);
-				sm_singleton->m_tris[ sm_singleton->m_triCount ].v1.position = glm::vec4(a_rv1,1);
-				sm_singleton->m_tris[ sm_singleton->m_triCount ].v2.position = glm::vec4(a_rv2,1);
-				sm_singleton->m_tris[ sm_singleton->m_triCount ].v0.colour = a_colour;
-				sm_singleton->m_tris[ sm_singleton->m_triCount ].v1.colour = a_colour;
-				sm_singleton->m_tris[ sm_singleton->m_triCount ].v2.colour = a_colour;
-
-				sm_singleton->m_triCount++;
-			}
-		}
-		else
-		{
-			if (sm_singleton->m_transparentTriCount < sm_singleton->m_maxTris)
-			{
-				sm_singleton->m_transparentTris[ sm_singleton->m_transparentTriCount ].v0.position = glm::vec4(a_rv0,1);
-				sm_singleton->m_transparentTris[ sm_singleton->m_transparentTriCount ].v1.position = glm::vec4(a_rv1,1);
-				sm_singleton->m_transparentTris[ sm_singleton->m_transparentTriCount ].v2.position = glm::vec4(a_rv2,1);
-				sm_singleton->m_transparentTris[ sm_singleton->m_transparentTriCount ].v0.colour = a_colour;
-				sm_singleton->m_transparentTris[ sm_singleton->m_transparentTriCount ].v1.colour = a_colour;
-				sm_singleton->m_transparentTris[ sm_singleton->m_transparentTriCount ].v2.colour = a_colour;
-
-				sm_singleton->m_transparentTriCount++;
-			}
-		}
+		vertices[0].position = a_rv0;
+		vertices[0].colour = colour;
+		vertices[1].position = a_rv1;
+		vertices[1].colour = colour;
+		vertices[2].position = a_rv2;
+		vertices[2].colour = colour;
+	}
+}
+
+void Gizmos::addLines(const glm::vec3* a_starts, const glm::vec3* a_ends, unsigned int a_count, const glm::vec4& a_colour)
+{
+	unsigned int colour = packColour(a_colour);
+
+	// reserve in block-sized chunks so threads other than the GL thread can take them
+	while (a_count > 0)
+	{
+		unsigned int count = a_count < sc_blockVertices / 2 ? a_count : sc_blockVertices / 2;
+
+		Reservation reservation(eLines, count * 2);
+		if (reservation.vertices == nullptr)
+			return;
+
+		copyPositions(reservation.vertices, 2, a_starts, count, colour);
+		copyPositions(reservation.vertices + 1, 2, a_ends, count, colour);
+
+		a_starts += count;
+		a_ends += count;
+		a_count -= count;
+	}
+}
+
+void Gizmos::addTris(const glm::vec3* a_vertices, unsigned int a_count, const glm::vec4& a_colour)
+{
+	unsigned int colour = packColour(a_colour);
+	unsigned int stream = a_colour.w == 1 ? eTris : eTransparentTris;
+
+	while (a_count > 0)
+	{
+		unsigned int count = a_count < sc_blockVertices / 3 ? a_count : sc_blockVertices / 3;
+
+		Reservation reservation(stream, count * 3);
+		if (reservation.vertices == nullptr)
+			return;
+
+		copyPositions(reservation.vertices, 1, a_vertices, count * 3, colour);
+
+		a_vertices += count * 3;
+		a_count -= count;
 	}
 }
 
@@ -757,146 +1874,173 @@ void Gizmos::add2DLine(const glm::vec2& a_rv0,  const glm::vec2& a_rv1, const gl
 
 void Gizmos::add2DLine(const glm::vec2& a_rv0, const glm::vec2& a_rv1, const glm::vec4& a_colour0, const glm::vec4& a_colour1)
 {
-	if (sm_singleton != nullptr &&
-		sm_singleton->m_2DlineCount < sm_singleton->m_max2DLines)
-	{
-		sm_singleton->m_2Dlines[ sm_singleton->m_2DlineCount ].v0.position = glm::vec4(a_rv0,1,1);
-		sm_singleton->m_2Dlines[ sm_singleton->m_2DlineCount ].v0.colour = a_colour0;
-		sm_singleton->m_2Dlines[ sm_singleton->m_2DlineCount ].v1.position = glm::vec4(a_rv1,1,1);
-		sm_singleton->m_2Dlines[ sm_singleton->m_2DlineCount ].v1.colour = a_colour1;
+	unsigned int colour0 = packColour(a_colour0);
+	unsigned int colour1 = packColour(a_colour1);
 
-		sm_singleton->m_2DlineCount++;
+	Reservation reservation(e2DLines, 2);
+	GizmoVertex* vertices = reservation.vertices;
+	if (vertices != nullptr)
+	{
+		vertices[0].position = glm::vec3(a_rv0,1);
+		vertices[0].colour = colour0;
+		vertices[1].position = glm::vec3(a_rv1,1);
+		vertices[1].colour = colour1;
 	}
 }
 
 void Gizmos::add2DTri(const glm::vec2& a_rv0, const glm::vec2& a_rv1, const glm::vec2& a_rv2, const glm::vec4& a_colour)
 {
-	if (sm_singleton != nullptr)
-	{
-		if (sm_singleton->m_2DtriCount < sm_singleton->m_max2DTris)
-		{
-			sm_singleton->m_2Dtris[ sm_singleton->m_2DtriCount ].v0.position = glm::vec4(a_rv0,1,1);
-			sm_singleton->m_2Dtris[ sm_singleton->m_2DtriCount ].v1.position = glm::vec4(a_rv1,1,1);
-			sm_singleton->m_2Dtris[ sm_singleton->m_2DtriCount ].v2.position = glm::vec4(a_rv2,1,1);
-			sm_singleton->m_2Dtris[ sm_singleton->m_2DtriCount ].v0.colour = a_colour;
-			sm_singleton->m_2Dtris[ sm_singleton->m_2DtriCount ].v1.colour = a_colour;
-			sm_singleton->m_2Dtris[ sm_singleton->m_2DtriCount ].v2.colour = a_colour;
+	unsigned int colour = packColour(a_colour);
 
-			sm_singleton->m_2DtriCount++;
-		}
+	Reservation reservation(e2DTris, 3);
+	GizmoVertex* vertices = reservation.vertices;
+	if (vertices != nullptr)
+	{
+		vertices[0].position = glm::vec3(a_rv0,1);
+		vertices[0].colour = colour;
+		vertices[1].position = glm::vec3(a_rv1,1);
+		vertices[1].colour = colour;
+		vertices[2].position = glm::vec3(a_rv2,1);
+		vertices[2].colour = colour;
 	}
 }
 
 void Gizmos::draw(const glm::mat4& a_projectionView)
 {
-	if ( sm_singleton != nullptr && (sm_singleton->m_lineCount > 0 || sm_singleton->m_triCount > 0 || sm_singleton->m_transparentTriCount > 0))
+	if (sm_singleton == nullptr)
+		return;
+
+	sm_singleton->mergeThreadBuffers(eLines);
+	sm_singleton->mergeThreadBuffers(eTris);
+	// sorted transparent tris stay in the thread buffers until sortTransparentTris() gathers them
+	if (sm_singleton->m_transparency != eSortedTransparency)
+		sm_singleton->mergeThreadBuffers(eTransparentTris);
+
+	if (sm_singleton->m_transparency == eSortedTransparency ||
+		sm_singleton->m_transparentTris.empty() == false)
+		sm_singleton->sortTransparentTris(a_projectionView);
+	bool sortedTris = sm_singleton->m_sortedTris.empty() == false;
+
+	if (sm_singleton->m_instancing)
+		sm_singleton->prepareInstances();
+
+	sm_singleton->uploadLayers();
+	bool layerLines = sm_singleton->layersHave(eLines);
+	bool layerTris = sm_singleton->layersHave(eTris);
+	bool layerTransparentTris = sm_singleton->layersHave(eTransparentTris);
+
+	// transparent runs sort last
+	std::vector<InstanceRun>& runs = sm_singleton->m_instanceRuns;
+	bool transparentInstances = runs.empty() == false && (runs.back().key >> 40) != 0;
+
+	GizmoStream* streams = sm_singleton->m_streams;
+	if (streams[eLines].count > 0 || streams[eTris].count > 0 || streams[eTransparentTris].count > 0 ||
+		sortedTris || runs.empty() == false ||
+		layerLines || layerTris || layerTransparentTris)
 	{
-		glUseProgram(sm_singleton->m_shader);
-		
-		unsigned int projectionViewUniform = glGetUniformLocation(sm_singleton->m_shader,"ProjectionView");
-		glUniformMatrix4fv(projectionViewUniform, 1, false, glm::value_ptr(a_projectionView));
-
-		if (sm_singleton->m_lineCount > 0)
+		if (runs.empty() == false)
 		{
-			glBindBuffer(GL_ARRAY_BUFFER, sm_singleton->m_lineVBO);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, sm_singleton->m_lineCount * sizeof(GizmoLine), sm_singleton->m_lines);
-
-			glBindVertexArray(sm_singleton->m_lineVAO);
-			glDrawArrays(GL_LINES, 0, sm_singleton->m_lineCount * 2);
+			glUseProgram(sm_singleton->m_instanceShader);
+			glUniformMatrix4fv(sm_singleton->m_instanceProjectionViewUniform, 1, false, glm::value_ptr(a_projectionView));
 		}
 
-		if (sm_singleton->m_triCount > 0)
-		{
-			glBindBuffer(GL_ARRAY_BUFFER, sm_singleton->m_triVBO);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, sm_singleton->m_triCount * sizeof(GizmoTri), sm_singleton->m_tris);
+		glUseProgram(sm_singleton->m_shader);
+		glUniformMatrix4fv(sm_singleton->m_projectionViewUniform, 1, false, glm::value_ptr(a_projectionView));
 
-			glBindVertexArray(sm_singleton->m_triVAO);
-			glDrawArrays(GL_TRIANGLES, 0, sm_singleton->m_triCount * 3);
-		}
+		if (streams[eLines].count > 0)
+			sm_singleton->drawStream(streams[eLines], GL_LINES);
+
+		if (streams[eTris].count > 0)
+			sm_singleton->drawStream(streams[eTris], GL_TRIANGLES);
 
-		if (sm_singleton->m_transparentTriCount > 0)
+		sm_singleton->drawLayers(eLines, GL_LINES);
+		sm_singleton->drawLayers(eTris, GL_TRIANGLES);
+		sm_singleton->drawInstances(false);
+
+		if (streams[eTransparentTris].count > 0 || sortedTris || transparentInstances || layerTransparentTris)
 		{
-			// not ideal to store these, but Gizmos must work stand-alone
-			GLboolean blendEnabled = glIsEnabled(GL_BLEND);
-			GLboolean depthMask = GL_TRUE;
-			glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMask);
-			int src, dst;
-			glGetIntegerv(GL_BLEND_SRC, &src);
-			glGetIntegerv(GL_BLEND_DST, &dst);
+			// Gizmos must work stand-alone, so put back whatever state it changes
+			bool blendEnabled = GLState::isEnabled(GL_BLEND);
+			bool depthMask = GLState::getDepthMask();
+			unsigned int src, dst;
+			GLState::getBlendFunc(src, dst);
 
 			// setup blend states
-			if (blendEnabled == GL_FALSE)
-				glEnable(GL_BLEND);
-			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-			glDepthMask(GL_FALSE);
+			GLState::enable(GL_BLEND);
+			GLState::blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			GLState::depthMask(false);
+
+			// layers first, as they're usually the larger, further away overlays
+			sm_singleton->drawLayers(eTransparentTris, GL_TRIANGLES);
 
-			glBindBuffer(GL_ARRAY_BUFFER, sm_singleton->m_transparentTriVBO);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, sm_singleton->m_transparentTriCount * sizeof(GizmoTri), sm_singleton->m_transparentTris);
+			if (streams[eTransparentTris].count > 0)
+				sm_singleton->drawStream(streams[eTransparentTris], GL_TRIANGLES);
 
-			glBindVertexArray(sm_singleton->m_transparentTriVAO);
-			glDrawArrays(GL_TRIANGLES, 0, sm_singleton->m_transparentTriCount * 3);
+			if (sortedTris)
+			{
+				glBindVertexArray(sm_singleton->m_sortedVAO);
+				glDrawArrays(GL_TRIANGLES, 0, (GLsizei)sm_singleton->m_sortedTris.size());
+			}
+
+			sm_singleton->drawInstances(true);
 
 			// reset state
-			glDepthMask(depthMask);
-			glBlendFunc(src, dst);
-			if (blendEnabled == GL_FALSE)
-				glDisable(GL_BLEND);
+			GLState::depthMask(depthMask);
+			GLState::blendFunc(src, dst);
+			GLState::setEnabled(GL_BLEND, blendEnabled);
 		}
 
+		glBindVertexArray(0);
 		glUseProgram(0);
 	}
 }
 
 void Gizmos::draw2D(const glm::mat4& a_projection)
 {
-	if ( sm_singleton != nullptr && (sm_singleton->m_2DlineCount > 0 || sm_singleton->m_2DtriCount > 0))
-	{
-		glUseProgram(sm_singleton->m_shader);
-		
-		unsigned int projectionViewUniform = glGetUniformLocation(sm_singleton->m_shader,"ProjectionView");
-		glUniformMatrix4fv(projectionViewUniform, 1, false, glm::value_ptr(a_projection));
-
-		if (sm_singleton->m_2DlineCount > 0)
-		{
-			glBindBuffer(GL_ARRAY_BUFFER, sm_singleton->m_2DlineVBO);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, sm_singleton->m_2DlineCount * sizeof(GizmoLine), sm_singleton->m_2Dlines);
-
-			glBindVertexArray(sm_singleton->m_2DlineVAO);
-			glDrawArrays(GL_LINES, 0, sm_singleton->m_2DlineCount * 2);
-		}
-
-		if (sm_singleton->m_2DtriCount > 0)
-		{
-			GLboolean blendEnabled = glIsEnabled(GL_BLEND);
+	if (sm_singleton == nullptr)
+		return;
 
-			GLboolean depthMask = GL_TRUE;
-			glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMask);
+	sm_singleton->mergeThreadBuffers(e2DLines);
+	sm_singleton->mergeThreadBuffers(e2DTris);
 
-			int src, dst;
-			glGetIntegerv(GL_BLEND_SRC, &src);
-			glGetIntegerv(GL_BLEND_DST, &dst);
+	sm_singleton->uploadLayers();
+	bool layerLines = sm_singleton->layersHave(e2DLines);
+	bool layerTris = sm_singleton->layersHave(e2DTris);
 
-			if (blendEnabled == GL_FALSE)
-				glEnable(GL_BLEND);
+	GizmoStream* streams = sm_singleton->m_streams;
+	if (streams[e2DLines].count > 0 || streams[e2DTris].count > 0 ||
+		layerLines || layerTris)
+	{
+		glUseProgram(sm_singleton->m_shader);
+		glUniformMatrix4fv(sm_singleton->m_projectionViewUniform, 1, false, glm::value_ptr(a_projection));
 
-			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		if (streams[e2DLines].count > 0)
+			sm_singleton->drawStream(streams[e2DLines], GL_LINES);
 
-			glDepthMask(GL_FALSE);
+		sm_singleton->drawLayers(e2DLines, GL_LINES);
 
-			glBindBuffer(GL_ARRAY_BUFFER, sm_singleton->m_2DtriVBO);
-			glBufferSubData(GL_ARRAY_BUFFER, 0, sm_singleton->m_2DtriCount * sizeof(GizmoTri), sm_singleton->m_2Dtris);
+		if (streams[e2DTris].count > 0 || layerTris)
+		{
+			bool blendEnabled = GLState::isEnabled(GL_BLEND);
+			bool depthMask = GLState::getDepthMask();
+			unsigned int src, dst;
+			GLState::getBlendFunc(src, dst);
 
-			glBindVertexArray(sm_singleton->m_2DtriVAO);
-			glDrawArrays(GL_TRIANGLES, 0, sm_singleton->m_2DtriCount * 3);
+			GLState::enable(GL_BLEND);
+			GLState::blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			GLState::depthMask(false);
 
-			glDepthMask(depthMask);
+			sm_singleton->drawLayers(e2DTris, GL_TRIANGLES);
 
-			glBlendFunc(src, dst);
+			if (streams[e2DTris].count > 0)
+				sm_singleton->drawStream(streams[e2DTris], GL_TRIANGLES);
 
-			if (blendEnabled == GL_FALSE)
-				glDisable(GL_BLEND);
+			GLState::depthMask(depthMask);
+			GLState::blendFunc(src, dst);
+			GLState::setEnabled(GL_BLEND, blendEnabled);
 		}
 
+		glBindVertexArray(0);
 		glUseProgram(0);
 	}
 }
@@ -924,19 +2068,24 @@ void Gizmos::addGrid(const glm::vec3& a_center, int a_increments, float a_size,
 	Gizmos::addTri(corners[2], corners[1], corners[0], a_fillColor);
 	Gizmos::addTri(corners[2], corners[3], corners[0], a_fillColor);
 	Gizmos::addTri(corners[0], corners[3], corners[2], a_fillColor);
+	// axis and border lines are batched separately from the rest
+	std::vector<glm::vec3> starts[2];
+	std::vector<glm::vec3> ends[2];
 	for (int i = 0; i <= a_increments; ++i)
 	{
-		glm::vec4 colour = (i == 0 || i == halfIncrements || i == a_increments) ? a_axisColor : a_colour;
+		int batch = (i == 0 || i == halfIncrements || i == a_increments) ? 1 : 0;
 		glm::vec3 l1Start = glm::vec3((-halfIncrements + i)*a_size, halfIncrements*a_size, 0);
 		glm::vec3 l1End = glm::vec3((-halfIncrements + i)*a_size, -halfIncrements*a_size, 0);
 		glm::vec3 l2Start = glm::vec3(halfIncrements*a_size, (-halfIncrements + i)*a_size, 0);
 		glm::vec3 l2End = glm::vec3(-halfIncrements*a_size, (-halfIncrements + i)*a_size, 0);
 
-		l1Start = (*a_transform * glm::vec4(l1Start, 0)).xyz + a_center;
-		l1End = (*a_transform * glm::vec4(l1End, 0)).xyz + a_center;
-		l2Start = (*a_transform * glm::vec4(l2Start, 0)).xyz + a_center;
-		l2End = (*a_transform * glm::vec4(l2End, 0)).xyz + a_center;
-		Gizmos::addLine(l1Start, l1End, colour);
-		Gizmos::addLine(l2Start, l2End, colour);
+		starts[batch].push_back((*a_transform * glm::vec4(l1Start, 0)).xyz + a_center);
+		ends[batch].push_back((*a_transform * glm::vec4(l1End, 0)).xyz + a_center);
+		starts[batch].push_back((*a_transform * glm::vec4(l2Start, 0)).xyz + a_center);
+		ends[batch].push_back((*a_transform * glm::vec4(l2End, 0)).xyz + a_center);
 	}
+	if (starts[0].empty() == false)
+		Gizmos::addLines(starts[0].data(), ends[0].data(), (unsigned int)starts[0].size(), a_colour);
+	if (starts[1].empty() == false)
+		Gizmos::addLines(starts[1].data(), ends[1].data(), (unsigned int)starts[1].size(), a_axisColor);
 }
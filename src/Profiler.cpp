@@ -0,0 +1,352 @@
+#include "Profiler.h"
+#include "Gizmos.h"
+#include <GL/glew.h>
+#include <chrono>
+#include <stdio.h>
+
+#if defined(_MSC_VER)
+#define PROFILER_THREAD_LOCAL __declspec(thread)
+#else
+#define PROFILER_THREAD_LOCAL __thread
+#endif
+
+Profiler* Profiler::sm_singleton = nullptr;
+unsigned int Profiler::sm_generation = 0;
+
+// each thread caches its state, the generation catches a destroyed and re-created profiler
+static PROFILER_THREAD_LOCAL void* st_threadState = nullptr;
+static PROFILER_THREAD_LOCAL unsigned int st_threadGeneration = 0;
+
+static const std::chrono::high_resolution_clock::time_point sc_epoch = std::chrono::high_resolution_clock::now();
+
+Profiler::Profiler(unsigned int a_historyFrames, bool a_gpuTiming)
+	: m_frame(0),
+	m_history(a_historyFrames > 0 ? a_historyFrames : 1),
+	m_gpuTiming(a_gpuTiming && (GLEW_VERSION_3_3 || GLEW_ARB_timer_query)),
+	m_gpuDepth(0)
+{
+	for (auto& record : m_history)
+	{
+		record.frame = 0xffffffff;
+		record.start = record.end = 0;
+	}
+}
+
+Profiler::~Profiler()
+{
+	for (auto thread : m_threads)
+		delete thread;
+
+	for (auto& queries : m_gpuQueries)
+		for (auto& query : queries)
+			m_freeQueries.push_back(query.query);
+	if (m_freeQueries.empty() == false)
+		glDeleteQueries((GLsizei)m_freeQueries.size(), m_freeQueries.data());
+}
+
+void Profiler::create(unsigned int a_historyFrames /* = 128 */, bool a_gpuTiming /* = true */)
+{
+	if (sm_singleton == nullptr)
+	{
+		++sm_generation;
+		sm_singleton = new Profiler(a_historyFrames, a_gpuTiming);
+	}
+}
+
+void Profiler::destroy()
+{
+	delete sm_singleton;
+	sm_singleton = nullptr;
+}
+
+double Profiler::now()
+{
+	return std::chrono::duration<double,std::micro>(std::chrono::high_resolution_clock::now() - sc_epoch).count();
+}
+
+Profiler::ThreadState* Profiler::threadState()
+{
+	if (st_threadState == nullptr ||
+		st_threadGeneration != sm_generation)
+	{
+		ThreadState* state = new ThreadState();
+
+		m_threadMutex.lock();
+		state->index = (unsigned int)m_threads.size();
+		m_threads.push_back(state);
+		m_threadMutex.unlock();
+
+		st_threadState = state;
+		st_threadGeneration = sm_generation;
+	}
+
+	return (ThreadState*)st_threadState;
+}
+
+void Profiler::beginFrame()
+{
+	if (sm_singleton == nullptr)
+		return;
+
+	FrameRecord& record = sm_singleton->m_history[ sm_singleton->m_frame % sm_singleton->m_history.size() ];
+	record.frame = sm_singleton->m_frame;
+	record.start = now();
+	record.end = record.start;
+	record.zones.clear();
+	record.gpuZones.clear();
+
+	// queries in this slot were issued two frames ago and should be finished by now
+	if (sm_singleton->m_gpuTiming == true)
+		sm_singleton->readGPUQueries( sm_singleton->m_gpuQueries[ sm_singleton->m_frame % 2 ] );
+}
+
+void Profiler::endFrame()
+{
+	if (sm_singleton == nullptr)
+		return;
+
+	FrameRecord& record = sm_singleton->m_history[ sm_singleton->m_frame % sm_singleton->m_history.size() ];
+	record.end = now();
+
+	// gather zones completed on every thread
+	sm_singleton->m_threadMutex.lock();
+	for (auto thread : sm_singleton->m_threads)
+	{
+		thread->mutex.lock();
+		record.zones.insert(record.zones.end(), thread->completed.begin(), thread->completed.end());
+		thread->completed.clear();
+		thread->mutex.unlock();
+	}
+	sm_singleton->m_threadMutex.unlock();
+
+	++sm_singleton->m_frame;
+}
+
+void Profiler::pushZone(const char* a_name)
+{
+	if (sm_singleton == nullptr)
+		return;
+
+	ThreadState* state = sm_singleton->threadState();
+
+	Zone zone;
+	zone.name = a_name;
+	zone.thread = state->index;
+	zone.depth = (unsigned int)state->stack.size();
+	zone.start = now();
+	zone.end = zone.start;
+	state->stack.push_back(zone);
+}
+
+void Profiler::popZone()
+{
+	if (sm_singleton == nullptr)
+		return;
+
+	ThreadState* state = sm_singleton->threadState();
+	if (state->stack.empty())
+		return;
+
+	Zone zone = state->stack.back();
+	state->stack.pop_back();
+	zone.end = now();
+
+	state->mutex.lock();
+	state->completed.push_back(zone);
+	state->mutex.unlock();
+}
+
+void Profiler::beginGPUZone(const char* a_name)
+{
+	if (sm_singleton == nullptr ||
+		sm_singleton->m_gpuTiming == false)
+		return;
+
+	if (sm_singleton->m_gpuDepth++ > 0)
+		return;
+
+	GPUQuery query;
+	query.name = a_name;
+	query.frame = sm_singleton->m_frame;
+	query.start = now();
+
+	if (sm_singleton->m_freeQueries.empty())
+	{
+		glGenQueries(1, &query.query);
+	}
+	else
+	{
+		query.query = sm_singleton->m_freeQueries.back();
+		sm_singleton->m_freeQueries.pop_back();
+	}
+
+	glBeginQuery(GL_TIME_ELAPSED, query.query);
+	sm_singleton->m_gpuQueries[ sm_singleton->m_frame % 2 ].push_back(query);
+}
+
+void Profiler::endGPUZone()
+{
+	if (sm_singleton == nullptr ||
+		sm_singleton->m_gpuTiming == false ||
+		sm_singleton->m_gpuDepth == 0)
+		return;
+
+	if (--sm_singleton->m_gpuDepth == 0)
+		glEndQuery(GL_TIME_ELAPSED);
+}
+
+void Profiler::readGPUQueries(std::vector<GPUQuery>& a_queries)
+{
+	for (auto& query : a_queries)
+	{
+		// never wait, a result that isn't ready yet is simply dropped
+		int available = GL_FALSE;
+		glGetQueryObjectiv(query.query, GL_QUERY_RESULT_AVAILABLE, &available);
+
+		FrameRecord& record = m_history[ query.frame % m_history.size() ];
+		if (available == GL_TRUE &&
+			record.frame == query.frame)
+		{
+			GLuint64 nanoseconds = 0;
+			glGetQueryObjectui64v(query.query, GL_QUERY_RESULT, &nanoseconds);
+
+			Zone zone;
+			zone.name = query.name;
+			zone.thread = 0;
+			zone.depth = 0;
+			zone.start = query.start;
+			zone.end = query.start + nanoseconds / 1000.0;
+			record.gpuZones.push_back(zone);
+		}
+
+		m_freeQueries.push_back(query.query);
+	}
+	a_queries.clear();
+}
+
+void Profiler::addGizmos(const glm::vec2& a_position, const glm::vec2& a_size, float a_maxMilliseconds /* = 33.3f */)
+{
+	if (sm_singleton == nullptr)
+		return;
+
+	static const glm::vec4 sc_colours[] = {
+		glm::vec4(0.9f,0.3f,0.3f,0.8f),
+		glm::vec4(0.3f,0.9f,0.3f,0.8f),
+		glm::vec4(0.3f,0.5f,0.9f,0.8f),
+		glm::vec4(0.9f,0.9f,0.3f,0.8f),
+		glm::vec4(0.9f,0.3f,0.9f,0.8f),
+		glm::vec4(0.3f,0.9f,0.9f,0.8f),
+	};
+	const unsigned int colourCount = sizeof(sc_colours) / sizeof(sc_colours[0]);
+
+	unsigned int historySize = (unsigned int)sm_singleton->m_history.size();
+	float barWidth = a_size.x / historySize;
+	float scale = a_size.y / (a_maxMilliseconds * 1000.0f);
+
+	// background and 60hz budget line
+	Gizmos::add2DAABBFilled(a_position + a_size * 0.5f, a_size * 0.5f, glm::vec4(0,0,0,0.5f));
+	float budget = a_position.y + (1000000.0f / 60.0f) * scale;
+	Gizmos::add2DLine(glm::vec2(a_position.x, budget), glm::vec2(a_position.x + a_size.x, budget), glm::vec4(1,1,1,0.5f));
+
+	// oldest frame on the left, skipping the frame currently being recorded
+	for (unsigned int i = 1; i < historySize; ++i)
+	{
+		const FrameRecord& record = sm_singleton->m_history[ (sm_singleton->m_frame + i) % historySize ];
+		if (record.frame == 0xffffffff)
+			continue;
+
+		float x = a_position.x + (i - 1) * barWidth;
+		float y = a_position.y;
+
+		for (auto& zone : record.zones)
+		{
+			if (zone.thread != 0 ||
+				zone.depth != 0)
+				continue;
+
+			// colour by name so that zones keep their colour between frames
+			unsigned int hash = 0;
+			for (const char* c = zone.name; *c != 0; ++c)
+				hash = hash * 31 + *c;
+
+			float height = (float)(zone.end - zone.start) * scale;
+			Gizmos::add2DAABBFilled(glm::vec2(x + barWidth * 0.5f, y + height * 0.5f),
+									glm::vec2(barWidth * 0.5f, height * 0.5f),
+									sc_colours[ hash % colourCount ]);
+			y += height;
+		}
+
+		if (record.gpuZones.empty() == false)
+		{
+			double gpuTime = 0;
+			for (auto& zone : record.gpuZones)
+				gpuTime += zone.end - zone.start;
+
+			float height = a_position.y + (float)gpuTime * scale;
+			Gizmos::add2DLine(glm::vec2(x, height), glm::vec2(x + barWidth, height), glm::vec4(1,1,1,1));
+		}
+	}
+}
+
+// writes a string as a JSON string literal
+static void writeJSONString(FILE* a_file, const char* a_string)
+{
+	fputc('"', a_file);
+	for (const char* c = a_string; *c != 0; ++c)
+	{
+		if (*c == '"' || *c == '\\')
+			fputc('\\', a_file);
+		if ((unsigned char)*c >= 0x20)
+			fputc(*c, a_file);
+	}
+	fputc('"', a_file);
+}
+
+bool Profiler::exportChromeTrace(const char* a_filename)
+{
+	if (sm_singleton == nullptr)
+		return false;
+
+	FILE* file = fopen(a_filename, "wb");
+	if (file == nullptr)
+	{
+		printf("Error: Unable to open file '%s' for writing!\n", a_filename);
+		return false;
+	}
+
+	// CPU zones are process 0 with a track per thread, GPU zones are process 1
+	fprintf(file, "{\"traceEvents\":[\n");
+	fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"tid\":0,\"args\":{\"name\":\"CPU\"}},\n");
+	fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"GPU\"}}");
+
+	unsigned int historySize = (unsigned int)sm_singleton->m_history.size();
+	for (unsigned int i = 1; i < historySize; ++i)
+	{
+		const FrameRecord& record = sm_singleton->m_history[ (sm_singleton->m_frame + i) % historySize ];
+		if (record.frame == 0xffffffff)
+			continue;
+
+		fprintf(file, ",\n{\"name\":\"Frame %u\",\"cat\":\"frame\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,\"tid\":0}",
+				record.frame, record.start, record.end - record.start);
+
+		for (auto& zone : record.zones)
+		{
+			fprintf(file, ",\n{\"name\":");
+			writeJSONString(file, zone.name);
+			fprintf(file, ",\"cat\":\"cpu\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,\"tid\":%u}",
+					zone.start, zone.end - zone.start, zone.thread);
+		}
+
+		for (auto& zone : record.gpuZones)
+		{
+			fprintf(file, ",\n{\"name\":");
+			writeJSONString(file, zone.name);
+			fprintf(file, ",\"cat\":\"gpu\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":0}",
+					zone.start, zone.end - zone.start);
+		}
+	}
+
+	fprintf(file, "\n]}\n");
+	fclose(file);
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,658 @@
+#include "ShaderProgram.h"
+#include "FileView.h"
+#include <GL/glew.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <stdio.h>
+#include <sys/stat.h>
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+// programs being watched for changes, shared with the watcher thread
+static std::mutex					s_watchMutex;
+static std::vector<ShaderProgram*>	s_watched;
+static std::thread					s_watchThread;
+static std::atomic<bool>			s_watchRunning(false);
+
+// how long a file must be left alone after changing before it is read, editors often save in several steps
+static const double sc_settleTime = 0.1;
+
+static const unsigned int sc_stageTypes[5] = { GL_VERTEX_SHADER, GL_TESS_CONTROL_SHADER, GL_TESS_EVALUATION_SHADER, GL_GEOMETRY_SHADER, GL_FRAGMENT_SHADER };
+
+static double now()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static long long fileTime(const char* a_path)
+{
+	struct stat info;
+	if (stat(a_path, &info) != 0)
+		return 0;
+	return (long long)info.st_mtime;
+}
+
+static void printInfoLog(unsigned int a_handle, bool a_isProgram)
+{
+	int infoLogLength = 0;
+	if (a_isProgram)
+		glGetProgramiv(a_handle, GL_INFO_LOG_LENGTH, &infoLogLength);
+	else
+		glGetShaderiv(a_handle, GL_INFO_LOG_LENGTH, &infoLogLength);
+
+	char* infoLog = new char[infoLogLength + 1];
+	infoLog[0] = 0;
+	if (a_isProgram)
+		glGetProgramInfoLog(a_handle, infoLogLength + 1, 0, infoLog);
+	else
+		glGetShaderInfoLog(a_handle, infoLogLength + 1, 0, infoLog);
+
+	printf("%s",infoLog);
+	printf("\n");
+	delete[] infoLog;
+}
+
+ShaderProgram::ShaderProgram()
+	: m_handle(0),
+	m_hotReload(false),
+	m_changeTime(0),
+	m_sourcesReady(false),
+	m_pendingHandle(0),
+	m_pendingFrames(0)
+{
+	for (auto& shader : m_pendingShaders)
+		shader = 0;
+}
+
+ShaderProgram::~ShaderProgram()
+{
+	unload();
+}
+
+bool ShaderProgram::load(const ProgramDesc& a_desc, bool a_hotReload /* = false */)
+{
+	unload();
+
+	const char* stages[5] = { a_desc.vertexShader, a_desc.controlShader, a_desc.evaluationShader, a_desc.geometryShader, a_desc.fragmentShader };
+	for (unsigned int stage = 0; stage < 5; ++stage)
+		m_stages[stage] = stages[stage] != nullptr ? stages[stage] : "";
+	for (unsigned int i = 0; i < a_desc.inputAttributeCount; ++i)
+		m_inputs.push_back(a_desc.inputAttributes[i]);
+	for (unsigned int i = 0; i < a_desc.outputAttributeCount; ++i)
+		m_outputs.push_back(a_desc.outputAttributes[i]);
+
+	ProgramDesc desc = a_desc;
+	bool success = Utility::buildPrograms(1, &desc);
+	m_handle = desc.handle;
+	reflect();
+
+	// a program that failed to build is still watched, so that fixing the source loads it
+	if (a_hotReload)
+		watch(this);
+
+	return success;
+}
+
+void ShaderProgram::unload()
+{
+	if (m_hotReload)
+		unwatch(this);
+
+	if (m_pendingHandle != 0)
+	{
+		glDeleteProgram(m_pendingHandle);
+		m_pendingHandle = 0;
+	}
+	for (auto& shader : m_pendingShaders)
+	{
+		if (shader != 0)
+			glDeleteShader(shader);
+		shader = 0;
+	}
+
+	if (m_handle != 0)
+		glDeleteProgram(m_handle);
+	m_handle = 0;
+
+	m_uniforms.clear();
+	m_uniformTable.clear();
+	m_blockTable.clear();
+	m_blockBindings.clear();
+	m_inputs.clear();
+	m_outputs.clear();
+}
+
+void ShaderProgram::bind() const
+{
+	glUseProgram(m_handle);
+}
+
+unsigned int ShaderProgram::hashName(const char* a_name)
+{
+	// 32-bit FNV-1a, with 0 kept free to mark empty table slots
+	unsigned int hash = 2166136261u;
+	for (const char* c = a_name; *c != 0; ++c)
+	{
+		hash ^= (unsigned char)*c;
+		hash *= 16777619u;
+	}
+	return hash != 0 ? hash : 1;
+}
+
+int ShaderProgram::getUniform(unsigned int a_hash) const
+{
+	return find(m_uniformTable, a_hash);
+}
+
+int ShaderProgram::getUniformBlock(const char* a_name) const
+{
+	return find(m_blockTable, hashName(a_name));
+}
+
+void ShaderProgram::setUniformBlockBinding(const char* a_name, unsigned int a_binding)
+{
+	bool found = false;
+	for (auto& binding : m_blockBindings)
+	{
+		if (binding.first == a_name)
+		{
+			binding.second = a_binding;
+			found = true;
+		}
+	}
+	if (found == false)
+		m_blockBindings.push_back(std::make_pair(std::string(a_name), a_binding));
+
+	int index = getUniformBlock(a_name);
+	if (index >= 0)
+		glUniformBlockBinding(m_handle, index, a_binding);
+}
+
+bool ShaderProgram::insert(std::vector<TableEntry>& a_table, unsigned int a_hash, int a_location)
+{
+	unsigned int mask = (unsigned int)a_table.size() - 1;
+	unsigned int slot = a_hash & mask;
+	while (a_table[slot].hash != 0)
+	{
+		if (a_table[slot].hash == a_hash)
+			return false;
+		slot = (slot + 1) & mask;
+	}
+	a_table[slot].hash = a_hash;
+	a_table[slot].location = a_location;
+	return true;
+}
+
+int ShaderProgram::find(const std::vector<TableEntry>& a_table, unsigned int a_hash)
+{
+	if (a_table.empty())
+		return -1;
+
+	unsigned int mask = (unsigned int)a_table.size() - 1;
+	unsigned int slot = a_hash & mask;
+	while (a_table[slot].hash != 0)
+	{
+		if (a_table[slot].hash == a_hash)
+			return a_table[slot].location;
+		slot = (slot + 1) & mask;
+	}
+	return -1;
+}
+
+// tables are a power of two at least twice the entry count, so there is always an empty slot
+static unsigned int tableSize(unsigned int a_count)
+{
+	unsigned int size = 4;
+	while (size < a_count * 2)
+		size *= 2;
+	return size;
+}
+
+void ShaderProgram::reflect()
+{
+	m_uniforms.clear();
+	m_uniformTable.clear();
+	m_blockTable.clear();
+
+	if (m_handle == 0)
+		return;
+
+	// uniforms, including every element of arrays
+	std::vector< std::pair<std::string, int> > names;
+
+	int count = 0, maxLength = 0;
+	glGetProgramiv(m_handle, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(m_handle, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+	std::vector<char> name(maxLength + 1);
+
+	for (int i = 0; i < count; ++i)
+	{
+		int size = 0;
+		GLenum type = 0;
+		glGetActiveUniform(m_handle, i, (GLsizei)name.size(), nullptr, &size, &type, name.data());
+
+		// members of uniform blocks have no location
+		int location = glGetUniformLocation(m_handle, name.data());
+		if (location < 0)
+			continue;
+
+		// arrays are reported by their first element, i.e. "colours[0]"
+		std::string base = name.data();
+		size_t length = base.size();
+		if (length > 3 &&
+			base.compare(length - 3, 3, "[0]") == 0)
+		{
+			base.resize(length - 3);
+			names.push_back(std::make_pair(base, location));
+
+			char element[16];
+			for (int e = 0; e < size; ++e)
+			{
+				sprintf(element, "[%d]", e);
+				std::string elementName = base + element;
+				int elementLocation = e == 0 ? location : glGetUniformLocation(m_handle, elementName.c_str());
+				if (elementLocation < 0)
+					continue;
+
+				Uniform uniform = { elementName, type, elementLocation };
+				m_uniforms.push_back(uniform);
+				names.push_back(std::make_pair(elementName, elementLocation));
+			}
+		}
+		else
+		{
+			Uniform uniform = { base, type, location };
+			m_uniforms.push_back(uniform);
+			names.push_back(std::make_pair(base, location));
+		}
+	}
+
+	TableEntry empty = { 0, -1 };
+	m_uniformTable.assign(tableSize((unsigned int)names.size()), empty);
+	for (auto& entry : names)
+	{
+		// names are unique, so a hash that's already in the table belongs to a different name
+		unsigned int hash = hashName(entry.first.c_str());
+		if (insert(m_uniformTable, hash, entry.second) == false)
+		{
+			for (auto& other : names)
+			{
+				if (hashName(other.first.c_str()) == hash)
+				{
+					printf("Error: Uniforms '%s' and '%s' have the same hash, '%s' can't be found by name!\n",
+						   other.first.c_str(), entry.first.c_str(), entry.first.c_str());
+					break;
+				}
+			}
+		}
+	}
+
+	// uniform blocks
+	count = 0;
+	maxLength = 0;
+	glGetProgramiv(m_handle, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+	glGetProgramiv(m_handle, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLength);
+	name.resize(maxLength + 1);
+
+	m_blockTable.assign(tableSize(count), empty);
+	std::vector<std::string> blockNames(count);
+	for (int i = 0; i < count; ++i)
+	{
+		glGetActiveUniformBlockName(m_handle, i, (GLsizei)name.size(), nullptr, name.data());
+		blockNames[i] = name.data();
+
+		unsigned int hash = hashName(name.data());
+		if (insert(m_blockTable, hash, i) == false)
+		{
+			for (int j = 0; j < i; ++j)
+			{
+				if (hashName(blockNames[j].c_str()) == hash)
+				{
+					printf("Error: Uniform blocks '%s' and '%s' have the same hash, '%s' can't be found by name!\n",
+						   blockNames[j].c_str(), name.data(), name.data());
+					break;
+				}
+			}
+		}
+	}
+
+	for (auto& binding : m_blockBindings)
+	{
+		int index = getUniformBlock(binding.first.c_str());
+		if (index >= 0)
+			glUniformBlockBinding(m_handle, index, binding.second);
+	}
+}
+
+void ShaderProgram::beginReload()
+{
+	// issue the compiles and link without asking for their results, so the frame isn't stalled
+	m_pendingHandle = glCreateProgram();
+	m_pendingFrames = 0;
+
+	for (unsigned int stage = 0; stage < 5; ++stage)
+	{
+		if (m_stages[stage].empty())
+			continue;
+
+		const char* source = m_sources[stage].c_str();
+		m_pendingShaders[stage] = glCreateShader(sc_stageTypes[stage]);
+		glShaderSource(m_pendingShaders[stage], 1, &source, 0);
+		glCompileShader(m_pendingShaders[stage]);
+		glAttachShader(m_pendingHandle, m_pendingShaders[stage]);
+		m_sources[stage].clear();
+	}
+
+	for (unsigned int i = 0; i < m_inputs.size(); ++i)
+		glBindAttribLocation(m_pendingHandle, i, m_inputs[i].c_str());
+	for (unsigned int i = 0; i < m_outputs.size(); ++i)
+		glBindFragDataLocation(m_pendingHandle, i, m_outputs[i].c_str());
+
+	glLinkProgram(m_pendingHandle);
+	m_sourcesReady = false;
+}
+
+bool ShaderProgram::finishReload()
+{
+	// without parallel compile support asking straight away would stall, so give the driver a frame
+	if (GLEW_KHR_parallel_shader_compile)
+	{
+		int complete = GL_FALSE;
+		glGetProgramiv(m_pendingHandle, GL_COMPLETION_STATUS_KHR, &complete);
+		if (complete == GL_FALSE)
+			return false;
+	}
+	else if (m_pendingFrames++ == 0)
+	{
+		return false;
+	}
+
+	int linked = GL_FALSE;
+	glGetProgramiv(m_pendingHandle, GL_LINK_STATUS, &linked);
+	if (linked == GL_FALSE)
+	{
+		// keep using the old program
+		printf("Error: Failed to reload shader program '%s'!\n", m_stages[0].c_str());
+		for (unsigned int stage = 0; stage < 5; ++stage)
+		{
+			int compiled = GL_TRUE;
+			if (m_pendingShaders[stage] != 0)
+				glGetShaderiv(m_pendingShaders[stage], GL_COMPILE_STATUS, &compiled);
+			if (compiled == GL_FALSE)
+				printInfoLog(m_pendingShaders[stage], false);
+		}
+		printInfoLog(m_pendingHandle, true);
+		glDeleteProgram(m_pendingHandle);
+	}
+	else
+	{
+		// carry uniform values over to the new program
+		int current = 0;
+		glGetIntegerv(GL_CURRENT_PROGRAM, &current);
+		glUseProgram(m_pendingHandle);
+
+		float f[16];
+		int i[4];
+		for (auto& uniform : m_uniforms)
+		{
+			int location = glGetUniformLocation(m_pendingHandle, uniform.name.c_str());
+			if (location < 0)
+				continue;
+
+			switch (uniform.type)
+			{
+			case GL_FLOAT:		glGetUniformfv(m_handle, uniform.location, f);	glUniform1fv(location, 1, f);	break;
+			case GL_FLOAT_VEC2:	glGetUniformfv(m_handle, uniform.location, f);	glUniform2fv(location, 1, f);	break;
+			case GL_FLOAT_VEC3:	glGetUniformfv(m_handle, uniform.location, f);	glUniform3fv(location, 1, f);	break;
+			case GL_FLOAT_VEC4:	glGetUniformfv(m_handle, uniform.location, f);	glUniform4fv(location, 1, f);	break;
+			case GL_FLOAT_MAT3:	glGetUniformfv(m_handle, uniform.location, f);	glUniformMatrix3fv(location, 1, GL_FALSE, f);	break;
+			case GL_FLOAT_MAT4:	glGetUniformfv(m_handle, uniform.location, f);	glUniformMatrix4fv(location, 1, GL_FALSE, f);	break;
+			case GL_INT_VEC2:
+			case GL_BOOL_VEC2:	glGetUniformiv(m_handle, uniform.location, i);	glUniform2iv(location, 1, i);	break;
+			case GL_INT_VEC3:
+			case GL_BOOL_VEC3:	glGetUniformiv(m_handle, uniform.location, i);	glUniform3iv(location, 1, i);	break;
+			case GL_INT_VEC4:
+			case GL_BOOL_VEC4:	glGetUniformiv(m_handle, uniform.location, i);	glUniform4iv(location, 1, i);	break;
+			case GL_INT:
+			case GL_BOOL:
+			case GL_SAMPLER_1D:
+			case GL_SAMPLER_2D:
+			case GL_SAMPLER_3D:
+			case GL_SAMPLER_CUBE:
+			case GL_SAMPLER_2D_SHADOW:
+			case GL_SAMPLER_2D_ARRAY:
+			case GL_SAMPLER_BUFFER:
+			case GL_SAMPLER_2D_MULTISAMPLE:
+								glGetUniformiv(m_handle, uniform.location, i);	glUniform1iv(location, 1, i);	break;
+			default:	break;
+			};
+		}
+
+		glUseProgram(current == (int)m_handle ? m_pendingHandle : current);
+
+		if (m_handle != 0)
+			glDeleteProgram(m_handle);
+		m_handle = m_pendingHandle;
+		reflect();
+
+		printf("Reloaded shader program '%s'\n", m_stages[0].c_str());
+	}
+
+	for (auto& shader : m_pendingShaders)
+	{
+		if (shader != 0)
+			glDeleteShader(shader);
+		shader = 0;
+	}
+	m_pendingHandle = 0;
+
+	return true;
+}
+
+void ShaderProgram::updateHotReload()
+{
+	// programs are only added and removed on this thread, so this check doesn't need the lock
+	if (s_watched.empty())
+		return;
+
+	std::lock_guard<std::mutex> lock(s_watchMutex);
+	for (auto program : s_watched)
+	{
+		if (program->m_pendingHandle != 0)
+			program->finishReload();
+		else if (program->m_sourcesReady)
+			program->beginReload();
+	}
+}
+
+void ShaderProgram::watch(ShaderProgram* a_program)
+{
+	std::lock_guard<std::mutex> lock(s_watchMutex);
+
+	a_program->m_hotReload = true;
+	a_program->m_files.clear();
+	for (auto& stage : a_program->m_stages)
+	{
+		if (stage.empty())
+			continue;
+
+		WatchedFile file;
+		file.path = stage;
+		size_t slash = stage.find_last_of("/\\");
+		file.directory = slash != std::string::npos ? stage.substr(0, slash) : ".";
+		file.name = slash != std::string::npos ? stage.substr(slash + 1) : stage;
+		file.modified = fileTime(stage.c_str());
+		a_program->m_files.push_back(file);
+	}
+
+	s_watched.push_back(a_program);
+
+	if (s_watchRunning == false)
+	{
+		s_watchRunning = true;
+		s_watchThread = std::thread(watchThread);
+	}
+}
+
+void ShaderProgram::unwatch(ShaderProgram* a_program)
+{
+	bool stop = false;
+
+	s_watchMutex.lock();
+	for (auto iter = s_watched.begin(); iter != s_watched.end(); ++iter)
+	{
+		if (*iter == a_program)
+		{
+			s_watched.erase(iter);
+			break;
+		}
+	}
+	a_program->m_hotReload = false;
+	a_program->m_files.clear();
+	a_program->m_changeTime = 0;
+	a_program->m_sourcesReady = false;
+
+	if (s_watched.empty() &&
+		s_watchRunning == true)
+	{
+		s_watchRunning = false;
+		stop = true;
+	}
+	s_watchMutex.unlock();
+
+	if (stop)
+		s_watchThread.join();
+}
+
+void ShaderProgram::watchThread()
+{
+#if defined(__linux__)
+	int notify = inotify_init1(IN_NONBLOCK);
+	std::vector< std::pair<int, std::string> > watches;
+#endif
+
+	while (s_watchRunning)
+	{
+		bool polled = false;
+
+#if defined(__linux__)
+		if (notify >= 0)
+		{
+			polled = true;
+
+			// watch the directories rather than the files, as many editors save by replacing the file
+			s_watchMutex.lock();
+			for (auto program : s_watched)
+			{
+				for (auto& file : program->m_files)
+				{
+					bool found = false;
+					for (auto& watch : watches)
+						found = found || watch.second == file.directory;
+
+					if (found == false)
+					{
+						int descriptor = inotify_add_watch(notify, file.directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+						if (descriptor >= 0)
+							watches.push_back(std::make_pair(descriptor, file.directory));
+					}
+				}
+			}
+			s_watchMutex.unlock();
+
+			pollfd descriptor = { notify, POLLIN, 0 };
+			if (poll(&descriptor, 1, 100) > 0)
+			{
+				char buffer[4096] __attribute__((aligned(__alignof__(inotify_event))));
+				ssize_t length = 0;
+				while ((length = read(notify, buffer, sizeof(buffer))) > 0)
+				{
+					s_watchMutex.lock();
+					for (char* c = buffer; c < buffer + length; )
+					{
+						const inotify_event* event = (const inotify_event*)c;
+						c += sizeof(inotify_event) + event->len;
+						if (event->len == 0)
+							continue;
+
+						for (auto& watch : watches)
+						{
+							if (watch.first != event->wd)
+								continue;
+
+							for (auto program : s_watched)
+								for (auto& file : program->m_files)
+									if (file.directory == watch.second &&
+										file.name == event->name)
+										program->m_changeTime = now();
+						}
+					}
+					s_watchMutex.unlock();
+				}
+			}
+		}
+#endif
+
+		// elsewhere just check modification times a few times a second
+		if (polled == false)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(250));
+
+			s_watchMutex.lock();
+			for (auto program : s_watched)
+			{
+				for (auto& file : program->m_files)
+				{
+					long long modified = fileTime(file.path.c_str());
+					if (modified != file.modified)
+					{
+						file.modified = modified;
+						program->m_changeTime = now();
+					}
+				}
+			}
+			s_watchMutex.unlock();
+		}
+
+		// read the sources of programs whose files have settled, ready for the GL thread to rebuild
+		s_watchMutex.lock();
+		double time = now();
+		for (auto program : s_watched)
+		{
+			if (program->m_changeTime == 0 ||
+				time - program->m_changeTime < sc_settleTime)
+				continue;
+
+			bool success = true;
+			for (unsigned int stage = 0; stage < 5; ++stage)
+			{
+				if (program->m_stages[stage].empty())
+					continue;
+
+				FileView file(program->m_stages[stage].c_str());
+				if (file.isOpen() == false)
+				{
+					success = false;
+					break;
+				}
+				program->m_sources[stage].assign(file.begin(), file.end());
+			}
+
+			// a file that couldn't be read may still be being written, so try again later
+			program->m_changeTime = success ? 0 : time;
+			program->m_sourcesReady = success;
+		}
+		s_watchMutex.unlock();
+	}
+
+#if defined(__linux__)
+	if (notify >= 0)
+		close(notify);
+#endif
+}
@@ -0,0 +1,136 @@
+#include "TaskGraph.h"
+
+TaskGraph::TaskGraph(unsigned int a_workerCount /* = 0 */)
+	: m_unfinished(0),
+	m_quit(false)
+{
+	if (a_workerCount == 0)
+	{
+		unsigned int cores = std::thread::hardware_concurrency();
+		a_workerCount = cores > 1 ? cores - 1 : 1;
+	}
+
+	for (unsigned int i = 0; i < a_workerCount; ++i)
+		m_workers.push_back( new std::thread( &TaskGraph::workerThread, this ) );
+}
+
+TaskGraph::~TaskGraph()
+{
+	wait();
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_quit = true;
+	}
+	m_signal.notify_all();
+
+	for (auto worker : m_workers)
+	{
+		worker->join();
+		delete worker;
+	}
+}
+
+TaskGraph::Task TaskGraph::add(const std::function<void()>& a_work)
+{
+	return add(a_work, nullptr, 0);
+}
+
+TaskGraph::Task TaskGraph::add(const std::function<void()>& a_work, Task a_dependency)
+{
+	return add(a_work, &a_dependency, 1);
+}
+
+TaskGraph::Task TaskGraph::add(const std::function<void()>& a_work, const Task* a_dependencies, unsigned int a_dependencyCount)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	Task task = (Task)m_nodes.size();
+	m_nodes.push_back(Node());
+
+	Node& node = m_nodes.back();
+	node.work = a_work;
+	node.waitingOn = 0;
+	node.finished = false;
+
+	// dependencies that have already finished don't hold the task back
+	for (unsigned int i = 0; i < a_dependencyCount; ++i)
+	{
+		Node& dependency = m_nodes[ a_dependencies[i] ];
+		if (dependency.finished == false)
+		{
+			dependency.dependents.push_back(task);
+			++node.waitingOn;
+		}
+	}
+
+	++m_unfinished;
+	if (node.waitingOn == 0)
+	{
+		m_ready.push_back(task);
+		lock.unlock();
+		m_signal.notify_one();
+	}
+
+	return task;
+}
+
+bool TaskGraph::runReadyTask(std::unique_lock<std::mutex>& a_lock)
+{
+	if (m_ready.empty())
+		return false;
+
+	Task task = m_ready.back();
+	m_ready.pop_back();
+
+	std::function<void()> work;
+	work.swap(m_nodes[task].work);
+
+	a_lock.unlock();
+	work();
+	a_lock.lock();
+
+	// release the dependents, then wake everyone if that was the last task so that wait() returns
+	Node& node = m_nodes[task];
+	node.finished = true;
+	for (auto dependent : node.dependents)
+	{
+		if (--m_nodes[dependent].waitingOn == 0)
+		{
+			m_ready.push_back(dependent);
+			m_signal.notify_one();
+		}
+	}
+	node.dependents.clear();
+
+	if (--m_unfinished == 0)
+		m_signal.notify_all();
+
+	return true;
+}
+
+void TaskGraph::workerThread()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (true)
+	{
+		if (runReadyTask(lock))
+			continue;
+		if (m_quit)
+			break;
+		m_signal.wait(lock);
+	}
+}
+
+void TaskGraph::wait()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (m_unfinished > 0)
+	{
+		if (runReadyTask(lock) == false)
+			m_signal.wait(lock);
+	}
+
+	m_nodes.clear();
+	m_ready.clear();
+}
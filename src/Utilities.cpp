@@ -1,9 +1,21 @@
 #include <GL/glew.h>
 #include <glfw/glfw3.h>
 #include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
 #include <glm/ext.hpp>
 
+#if defined(_WIN32)
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
 #include "Utilities.h"
+#include "FileView.h"
 
 double Utility::sm_prevTime = 0;
 float Utility::sm_deltaTime = 0;
@@ -25,6 +37,13 @@ float Utility::tickTimer()
 	return sm_deltaTime;
 }
 
+float Utility::stepTimer(float a_deltaTime)
+{
+	sm_deltaTime = a_deltaTime;
+	sm_totalTime += sm_deltaTime;
+	return sm_deltaTime;
+}
+
 // builds a simple 2 triangle quad with a position, colour and texture coordinates
 void Utility::build3DPlane(float a_size, unsigned int& a_vao, unsigned int& a_vbo, unsigned int& a_ibo, const glm::vec4& a_colour /* = glm::vec4(1,1,1,1) */ )
 {
@@ -106,13 +125,16 @@ unsigned int Utility::loadShader(const char* a_filename, unsigned int a_type)
 {
 	int success = GL_FALSE;
 
-	unsigned char* source = fileToBuffer(a_filename);
+	FileView file(a_filename);
+	if (file.isOpen() == false)
+		return 0;
+
+	const char* source = (const char*)file.data();
+	int length = (int)file.size();
 	unsigned int handle = glCreateShader(a_type);
 
-	glShaderSource(handle, 1, (const char**)&source, 0);
+	glShaderSource(handle, 1, &source, &length);
 	glCompileShader(handle);
-	
-	delete[] source;
 
 	glGetShaderiv(handle, GL_COMPILE_STATUS, &success);
 	if (success == GL_FALSE)
@@ -162,10 +184,10 @@ unsigned int Utility::createProgram(unsigned int a_vertexShader, unsigned int a_
 	if (success == GL_FALSE)
 	{
 		int infoLogLength = 0;		
-		glGetShaderiv(handle, GL_INFO_LOG_LENGTH, &infoLogLength);
+		glGetProgramiv(handle, GL_INFO_LOG_LENGTH, &infoLogLength);
 		char* infoLog = new char[infoLogLength];
 
-		glGetShaderInfoLog(handle, infoLogLength, 0, infoLog);
+		glGetProgramInfoLog(handle, infoLogLength, 0, infoLog);
 		printf("Error: Failed to link shader program!\n");
 		printf("%s",infoLog);
 		printf("\n");
@@ -176,33 +198,340 @@ unsigned int Utility::createProgram(unsigned int a_vertexShader, unsigned int a_
 	return handle;
 }
 
-unsigned char* Utility::fileToBuffer(const char* a_filename)
+// 64-bit FNV-1a hash, used to key cached program binaries
+static unsigned long long hashBytes(const void* a_data, size_t a_size, unsigned long long a_hash = 14695981039346656037ULL)
 {
-	// open file for text reading
-	FILE* pFile = fopen(a_filename,"rb");
-	if (pFile == nullptr)
+	const unsigned char* bytes = (const unsigned char*)a_data;
+	for (size_t i = 0; i < a_size; ++i)
 	{
-		printf("Error: Unable to open file '%s' for reading!\n",a_filename);
-		return nullptr;
+		a_hash ^= bytes[i];
+		a_hash *= 1099511628211ULL;
+	}
+	return a_hash;
+}
+
+static unsigned long long hashString(const char* a_string, unsigned long long a_hash)
+{
+	// include the terminator so that adjacent strings can't run together
+	return hashBytes(a_string, strlen(a_string) + 1, a_hash);
+}
+
+// prints the info log of a failed shader or program
+static void printInfoLog(unsigned int a_handle, bool a_isProgram, const char* a_message, const char* a_name)
+{
+	int infoLogLength = 0;
+	if (a_isProgram)
+		glGetProgramiv(a_handle, GL_INFO_LOG_LENGTH, &infoLogLength);
+	else
+		glGetShaderiv(a_handle, GL_INFO_LOG_LENGTH, &infoLogLength);
+
+	char* infoLog = new char[infoLogLength + 1];
+	infoLog[0] = 0;
+	if (a_isProgram)
+		glGetProgramInfoLog(a_handle, infoLogLength + 1, 0, infoLog);
+	else
+		glGetShaderInfoLog(a_handle, infoLogLength + 1, 0, infoLog);
+
+	printf("Error: %s '%s'!\n", a_message, a_name);
+	printf("%s",infoLog);
+	printf("\n");
+	delete[] infoLog;
+}
+
+bool Utility::buildPrograms(unsigned int a_count, ProgramDesc* a_programs, const char* a_cacheFolder /* = nullptr */)
+{
+	static const unsigned int sc_stageTypes[5] = { GL_VERTEX_SHADER, GL_TESS_CONTROL_SHADER, GL_TESS_EVALUATION_SHADER, GL_GEOMETRY_SHADER, GL_FRAGMENT_SHADER };
+	static const unsigned int sc_cacheMagic = 0x42505341;	// "ASPB"
+
+	struct Build
+	{
+		const char*			stageFiles[5];
+		FileView			sources[5];
+		unsigned int		shaders[5];
+		std::string			cachePath;
+		bool				fromCache;
+		bool				missingStage;
+	};
+
+	std::unique_ptr<Build[]> builds(new Build[a_count]);
+	bool success = true;
+
+	// binaries are only valid for the driver that created them
+	bool useCache = a_cacheFolder != nullptr &&
+		(GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary);
+	unsigned long long driverHash = 14695981039346656037ULL;
+	if (useCache)
+	{
+		int formatCount = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+		useCache = formatCount > 0;
+	}
+	if (useCache)
+	{
+		// create the cache folder the first time it's used, it's fine if it already exists
+#if defined(_WIN32)
+		_mkdir(a_cacheFolder);
+#else
+		mkdir(a_cacheFolder, 0755);
+#endif
+
+		driverHash = hashString((const char*)glGetString(GL_VENDOR), driverHash);
+		driverHash = hashString((const char*)glGetString(GL_RENDERER), driverHash);
+		driverHash = hashString((const char*)glGetString(GL_VERSION), driverHash);
+	}
+
+	// let the driver use as many compiler threads as it likes
+	bool parallelCompile = GLEW_KHR_parallel_shader_compile != 0;
+	if (parallelCompile)
+		glMaxShaderCompilerThreadsKHR(0xffffffff);
+
+	// waits until the driver has finished every cached or linked program, so that
+	// querying their status doesn't stall on each one in turn
+	auto waitForPrograms = [&](bool a_fromCache)
+	{
+		if (parallelCompile == false)
+			return;
+
+		// programs before the first pending one are known to be complete
+		unsigned int pending = 0;
+		while (pending < a_count)
+		{
+			if (builds[pending].fromCache != a_fromCache ||
+				builds[pending].missingStage)
+			{
+				++pending;
+				continue;
+			}
+
+			int complete = GL_FALSE;
+			glGetProgramiv(a_programs[pending].handle, GL_COMPLETION_STATUS_KHR, &complete);
+			if (complete == GL_FALSE)
+				std::this_thread::yield();
+			else
+				++pending;
+		}
+	};
+
+	// read sources and try to load cached binaries
+	for (unsigned int i = 0; i < a_count; ++i)
+	{
+		ProgramDesc& desc = a_programs[i];
+		Build& build = builds[i];
+
+		build.stageFiles[0] = desc.vertexShader;
+		build.stageFiles[1] = desc.controlShader;
+		build.stageFiles[2] = desc.evaluationShader;
+		build.stageFiles[3] = desc.geometryShader;
+		build.stageFiles[4] = desc.fragmentShader;
+		build.fromCache = false;
+		build.missingStage = false;
+
+		unsigned long long hash = driverHash;
+		for (unsigned int stage = 0; stage < 5; ++stage)
+		{
+			build.shaders[stage] = 0;
+			if (build.stageFiles[stage] == nullptr)
+				continue;
+
+			if (build.sources[stage].open(build.stageFiles[stage]) == false)
+			{
+				build.missingStage = true;
+				break;
+			}
+
+			unsigned long long size = build.sources[stage].size();
+			hash = hashBytes(&stage, sizeof(stage), hash);
+			hash = hashBytes(&size, sizeof(size), hash);
+			hash = hashBytes(build.sources[stage].data(), build.sources[stage].size(), hash);
+		}
+		for (unsigned int j = 0; j < desc.inputAttributeCount; ++j)
+			hash = hashString(desc.inputAttributes[j], hash);
+		for (unsigned int j = 0; j < desc.outputAttributeCount; ++j)
+			hash = hashString(desc.outputAttributes[j], hash);
+
+		// a program missing one of its stages is never built
+		if (build.missingStage)
+		{
+			desc.handle = 0;
+			success = false;
+			continue;
+		}
+
+		desc.handle = glCreateProgram();
+
+		if (useCache == false)
+			continue;
+
+		char filename[32];
+		sprintf(filename, "/%016llx.bin", hash);
+		build.cachePath = std::string(a_cacheFolder) + filename;
+
+		FILE* file = fopen(build.cachePath.c_str(), "rb");
+		if (file != nullptr)
+		{
+			unsigned int header[3] = {};	// magic, binary format, length
+			if (fread(header, sizeof(unsigned int), 3, file) == 3 &&
+				header[0] == sc_cacheMagic)
+			{
+				std::vector<char> binary(header[2]);
+				if (fread(binary.data(), 1, header[2], file) == header[2])
+				{
+					glProgramBinary(desc.handle, header[1], binary.data(), header[2]);
+					build.fromCache = true;
+				}
+			}
+			fclose(file);
+		}
+	}
+
+	// the driver may still reject a binary, in which case build from source instead
+	waitForPrograms(true);
+	for (unsigned int i = 0; i < a_count; ++i)
+	{
+		ProgramDesc& desc = a_programs[i];
+		Build& build = builds[i];
+		if (build.fromCache == false)
+			continue;
+
+		int linked = GL_FALSE;
+		glGetProgramiv(desc.handle, GL_LINK_STATUS, &linked);
+		if (linked == GL_FALSE)
+		{
+			build.fromCache = false;
+			glDeleteProgram(desc.handle);
+			desc.handle = glCreateProgram();
+		}
+	}
+
+	// issue every compile
+	for (unsigned int i = 0; i < a_count; ++i)
+	{
+		Build& build = builds[i];
+		if (build.fromCache ||
+			build.missingStage)
+			continue;
+
+		for (unsigned int stage = 0; stage < 5; ++stage)
+		{
+			if (build.sources[stage].isOpen() == false)
+				continue;
+
+			const char* source = (const char*)build.sources[stage].data();
+			int length = (int)build.sources[stage].size();
+			build.shaders[stage] = glCreateShader(sc_stageTypes[stage]);
+			glShaderSource(build.shaders[stage], 1, &source, &length);
+			glCompileShader(build.shaders[stage]);
+		}
+	}
+
+	// issue every link, without waiting on the compiles
+	for (unsigned int i = 0; i < a_count; ++i)
+	{
+		ProgramDesc& desc = a_programs[i];
+		Build& build = builds[i];
+		if (build.fromCache ||
+			build.missingStage)
+			continue;
+
+		for (unsigned int stage = 0; stage < 5; ++stage)
+			if (build.shaders[stage] != 0)
+				glAttachShader(desc.handle, build.shaders[stage]);
+
+		for (unsigned int j = 0; j < desc.inputAttributeCount; ++j)
+			glBindAttribLocation(desc.handle, j, desc.inputAttributes[j]);
+		for (unsigned int j = 0; j < desc.outputAttributeCount; ++j)
+			glBindFragDataLocation(desc.handle, j, desc.outputAttributes[j]);
+
+		if (useCache)
+			glProgramParameteri(desc.handle, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
+		glLinkProgram(desc.handle);
+	}
+
+	// now gather results, logging errors and caching binaries
+	waitForPrograms(false);
+	for (unsigned int i = 0; i < a_count; ++i)
+	{
+		ProgramDesc& desc = a_programs[i];
+		Build& build = builds[i];
+		if (build.fromCache ||
+			build.missingStage)
+			continue;
+
+		int linked = GL_FALSE;
+		glGetProgramiv(desc.handle, GL_LINK_STATUS, &linked);
+		if (linked == GL_FALSE)
+		{
+			for (unsigned int stage = 0; stage < 5; ++stage)
+			{
+				int compiled = GL_TRUE;
+				if (build.shaders[stage] != 0)
+					glGetShaderiv(build.shaders[stage], GL_COMPILE_STATUS, &compiled);
+				if (compiled == GL_FALSE)
+					printInfoLog(build.shaders[stage], false, "Failed to compile shader", build.stageFiles[stage]);
+			}
+			printInfoLog(desc.handle, true, "Failed to link shader program", desc.vertexShader != nullptr ? desc.vertexShader : "");
+
+			glDeleteProgram(desc.handle);
+			desc.handle = 0;
+			success = false;
+		}
+		else if (useCache)
+		{
+			int length = 0;
+			glGetProgramiv(desc.handle, GL_PROGRAM_BINARY_LENGTH, &length);
+
+			std::vector<char> binary(length);
+			unsigned int header[3] = { sc_cacheMagic, 0, 0 };
+			GLsizei written = 0;
+			glGetProgramBinary(desc.handle, length, &written, (GLenum*)&header[1], binary.data());
+			header[2] = (unsigned int)written;
+
+			FILE* file = written > 0 ? fopen(build.cachePath.c_str(), "wb") : nullptr;
+			if (file != nullptr)
+			{
+				fwrite(header, sizeof(unsigned int), 3, file);
+				fwrite(binary.data(), 1, written, file);
+				fclose(file);
+			}
+			else if (written > 0)
+			{
+				printf("Warning: Unable to cache shader program binary '%s'\n", build.cachePath.c_str());
+			}
+		}
+
+		// shaders are no longer needed once linked
+		for (unsigned int stage = 0; stage < 5; ++stage)
+		{
+			if (build.shaders[stage] == 0)
+				continue;
+			if (desc.handle != 0)
+				glDetachShader(desc.handle, build.shaders[stage]);
+			glDeleteShader(build.shaders[stage]);
+		}
 	}
 
-	// get number of bytes in file
-	fseek(pFile, 0, SEEK_END);
-	unsigned int uiLength = (unsigned int)ftell(pFile);
-	fseek(pFile, 0, SEEK_SET);
+	return success;
+}
 
-	// allocate buffer and read file contents
-	unsigned char* acBuffer = new unsigned char[uiLength + 1];
-	memset(acBuffer,0,uiLength + 1);
-	fread(acBuffer, sizeof(unsigned char), uiLength, pFile);
+unsigned char* Utility::fileToBuffer(const char* a_filename)
+{
+	FileView file(a_filename);
+	if (file.isOpen() == false)
+		return nullptr;
 
-	fclose(pFile);
+	// copy into a null-terminated buffer
+	unsigned char* acBuffer = new unsigned char[file.size() + 1];
+	memcpy(acBuffer, file.data(), file.size());
+	acBuffer[file.size()] = 0;
 	return acBuffer;
 }
 
 void Utility::freeMovement(glm::mat4& a_transform, float a_deltaTime, float a_speed, const glm::vec3& a_up /* = glm::vec3(0,1,0) */)
 {
 	GLFWwindow* window = glfwGetCurrentContext();
+	if (window == nullptr)
+		return;
 
 	float frameSpeed = glfwGetKey(window,GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS ? a_deltaTime * a_speed * 2 : a_deltaTime * a_speed;	
 